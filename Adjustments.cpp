@@ -0,0 +1,230 @@
+// Adjustments.cpp
+#include "Adjustments.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int kGrid = AdjustmentLut::kGrid;
+
+// Monotone cubic through (0, 0), the three curve points and (255, 255),
+// with Fritsch-Carlson tangents so the curve never overshoots.
+float CurveValue(const Adjustment &a, float x) {
+    const float px[5] = { 0.0f, 64.0f, 128.0f, 192.0f, 255.0f };
+    const float py[5] = { 0.0f, a.shadows, a.midtones, a.highlights, 255.0f };
+    float d[4], m[5];
+    for (int i = 0; i < 4; ++i) d[i] = (py[i + 1] - py[i]) / (px[i + 1] - px[i]);
+    m[0] = d[0];
+    m[4] = d[3];
+    for (int i = 1; i < 4; ++i) m[i] = (d[i - 1] * d[i] <= 0.0f) ? 0.0f : (d[i - 1] + d[i]) * 0.5f;
+    for (int i = 0; i < 4; ++i) {
+        if (d[i] == 0.0f) {
+            m[i] = m[i + 1] = 0.0f;
+            continue;
+        }
+        float u = m[i] / d[i], v = m[i + 1] / d[i];
+        float s = u * u + v * v;
+        if (s > 9.0f) {
+            float t = 3.0f / sqrtf(s);
+            m[i] = t * u * d[i];
+            m[i + 1] = t * v * d[i];
+        }
+    }
+
+    int i = 0;
+    while (i < 3 && x >= px[i + 1]) ++i;
+    float h = px[i + 1] - px[i];
+    float t = (x - px[i]) / h, t2 = t * t, t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * py[i] + (t3 - 2 * t2 + t) * h * m[i] +
+           (-2 * t3 + 3 * t2) * py[i + 1] + (t3 - t2) * h * m[i + 1];
+}
+
+// One channel (0..255) through a per-channel adjustment.
+float AdjustChannel(const Adjustment &a, float v) {
+    switch (a.kind) {
+        case ADJUST_BRIGHTNESS_CONTRAST: {
+            float c = std::clamp(a.contrast, -1.0f, 0.99f);
+            return (v + a.brightness * 255.0f - 127.5f) * (1.0f + c) / (1.0f - c) + 127.5f;
+        }
+        case ADJUST_LEVELS: {
+            float t = std::clamp((v - a.inBlack) / std::max(1.0f, a.inWhite - a.inBlack), 0.0f, 1.0f);
+            t = powf(t, 1.0f / std::max(0.01f, a.gamma));
+            return a.outBlack + t * (a.outWhite - a.outBlack);
+        }
+        case ADJUST_CURVES: return CurveValue(a, v);
+        case ADJUST_INVERT: return 255.0f - v;
+        default: return v;
+    }
+}
+
+float HueToChannel(float p, float q, float t) {
+    if (t < 0.0f) t += 1.0f;
+    if (t > 1.0f) t -= 1.0f;
+    if (t < 1.0f / 6.0f) return p + (q - p) * 6.0f * t;
+    if (t < 0.5f) return q;
+    if (t < 2.0f / 3.0f) return p + (q - p) * (2.0f / 3.0f - t) * 6.0f;
+    return p;
+}
+
+// Hue rotation, saturation and lightness in HSL space; rgb in 0..1.
+void AdjustHsl(const Adjustment &a, float rgb[3]) {
+    float hi = std::max({ rgb[0], rgb[1], rgb[2] });
+    float lo = std::min({ rgb[0], rgb[1], rgb[2] });
+    float l = (hi + lo) * 0.5f;
+    float h = 0.0f, s = 0.0f;
+    if (hi > lo) {
+        float d = hi - lo;
+        s = (l > 0.5f) ? d / (2.0f - hi - lo) : d / (hi + lo);
+        if (hi == rgb[0]) h = (rgb[1] - rgb[2]) / d + (rgb[1] < rgb[2] ? 6.0f : 0.0f);
+        else if (hi == rgb[1]) h = (rgb[2] - rgb[0]) / d + 2.0f;
+        else h = (rgb[0] - rgb[1]) / d + 4.0f;
+        h /= 6.0f;
+    }
+
+    h = fmodf(h + a.hue / 360.0f + 1.0f, 1.0f);
+    s = std::clamp(s * (1.0f + a.saturation), 0.0f, 1.0f);
+    l = (a.lightness > 0.0f) ? l + (1.0f - l) * a.lightness : l * (1.0f + a.lightness);
+
+    if (s == 0.0f) {
+        rgb[0] = rgb[1] = rgb[2] = l;
+        return;
+    }
+    float q = (l < 0.5f) ? l * (1.0f + s) : l + s - l * s;
+    float p = 2.0f * l - q;
+    rgb[0] = HueToChannel(p, q, h + 1.0f / 3.0f);
+    rgb[1] = HueToChannel(p, q, h);
+    rgb[2] = HueToChannel(p, q, h - 1.0f / 3.0f);
+}
+
+// One channel through the per-channel adjustments [first, end), rounded.
+uint8_t ChannelThrough(const std::vector<Adjustment> &stack, size_t first, size_t end, int v) {
+    float f = (float)v;
+    for (size_t i = first; i < end; ++i) f = std::clamp(AdjustChannel(stack[i], f), 0.0f, 255.0f);
+    return (uint8_t)(f + 0.5f);
+}
+
+// One 3-D table entry: the grid colour through adjustments [first, end).
+void EvaluateGridPoint(const std::vector<Adjustment> &stack, size_t first, size_t end, float rgb[3]) {
+    for (size_t i = first; i < end; ++i) {
+        const Adjustment &a = stack[i];
+        if (a.kind == ADJUST_HUE_SATURATION) {
+            float unit[3] = { rgb[0] / 255.0f, rgb[1] / 255.0f, rgb[2] / 255.0f };
+            AdjustHsl(a, unit);
+            for (int c = 0; c < 3; ++c) rgb[c] = std::clamp(unit[c] * 255.0f, 0.0f, 255.0f);
+        } else {
+            for (int c = 0; c < 3; ++c) rgb[c] = std::clamp(AdjustChannel(a, rgb[c]), 0.0f, 255.0f);
+        }
+    }
+}
+
+} // namespace
+
+const char *AdjustmentName(AdjustmentKind kind) {
+    switch (kind) {
+        case ADJUST_LEVELS: return "Levels";
+        case ADJUST_CURVES: return "Curves";
+        case ADJUST_HUE_SATURATION: return "Hue/Saturation";
+        case ADJUST_INVERT: return "Invert";
+        default: return "Brightness/Contrast";
+    }
+}
+
+AdjustmentLut CompileAdjustments(const std::vector<Adjustment> &stack) {
+    AdjustmentLut lut;
+
+    // per-channel steps before the first one that mixes channels and after
+    // the last; the grid only holds what lies between
+    size_t split = 0;
+    while (split < stack.size() && stack[split].kind != ADJUST_HUE_SATURATION) ++split;
+    size_t tail = stack.size();
+    while (tail > split && stack[tail - 1].kind != ADJUST_HUE_SATURATION) --tail;
+    for (int v = 0; v < 256; ++v) {
+        lut.curve[v] = ChannelThrough(stack, 0, split, v);
+        lut.post[v] = ChannelThrough(stack, tail, stack.size(), v);
+    }
+    if (split == stack.size()) return lut;
+
+    lut.grid.resize((size_t)kGrid * kGrid * kGrid * 4);
+    float *out = lut.grid.data();
+    const float step = 255.0f / (kGrid - 1);
+    for (int b = 0; b < kGrid; ++b)
+        for (int g = 0; g < kGrid; ++g)
+            for (int r = 0; r < kGrid; ++r, out += 4) {
+                float rgb[3] = { r * step, g * step, b * step };
+                EvaluateGridPoint(stack, split, tail, rgb);
+                out[0] = rgb[0];
+                out[1] = rgb[1];
+                out[2] = rgb[2];
+                out[3] = 0.0f;
+            }
+    return lut;
+}
+
+void ApplyAdjustmentLut(const AdjustmentLut &lut, uint8_t *rgba, int count) {
+    const uint8_t *curve = lut.curve, *post = lut.post;
+    if (lut.grid.empty()) {
+        for (int i = 0; i < count; ++i, rgba += 4) {
+            rgba[0] = curve[rgba[0]];
+            rgba[1] = curve[rgba[1]];
+            rgba[2] = curve[rgba[2]];
+        }
+        return;
+    }
+
+    const float toGrid = (kGrid - 1) / 255.0f;
+    const int dg = kGrid * 4, db = kGrid * kGrid * 4;
+    const float *grid = lut.grid.data();
+    for (int i = 0; i < count; ++i, rgba += 4) {
+        float pos[3];
+        int cell[3];
+        for (int c = 0; c < 3; ++c) {
+            pos[c] = curve[rgba[c]] * toGrid;
+            cell[c] = std::min((int)pos[c], kGrid - 2);
+            pos[c] -= (float)cell[c];
+        }
+        const float *p = grid + ((size_t)(cell[2] * kGrid + cell[1]) * kGrid + cell[0]) * 4;
+
+#if defined(__SSE2__)
+        // trilinear: along red, then green, then blue, all channels at once
+        auto lerp = [](__m128 a, __m128 b, __m128 t) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)); };
+        const __m128 tr = _mm_set1_ps(pos[0]), tg = _mm_set1_ps(pos[1]), tb = _mm_set1_ps(pos[2]);
+        __m128 c00 = lerp(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), tr);
+        __m128 c10 = lerp(_mm_loadu_ps(p + dg), _mm_loadu_ps(p + dg + 4), tr);
+        __m128 c01 = lerp(_mm_loadu_ps(p + db), _mm_loadu_ps(p + db + 4), tr);
+        __m128 c11 = lerp(_mm_loadu_ps(p + db + dg), _mm_loadu_ps(p + db + dg + 4), tr);
+        __m128 v = lerp(lerp(c00, c10, tg), lerp(c01, c11, tg), tb);
+        __m128i n = _mm_cvtps_epi32(v);
+        n = _mm_packus_epi16(_mm_packs_epi32(n, n), n);
+        uint32_t px = (uint32_t)_mm_cvtsi128_si32(n);
+        rgba[0] = post[(uint8_t)px];
+        rgba[1] = post[(uint8_t)(px >> 8)];
+        rgba[2] = post[(uint8_t)(px >> 16)];
+#else
+        for (int c = 0; c < 3; ++c) {
+            auto at = [&](int o) { return p[o + c]; };
+            auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+            float c00 = lerp(at(0), at(4), pos[0]);
+            float c10 = lerp(at(dg), at(dg + 4), pos[0]);
+            float c01 = lerp(at(db), at(db + 4), pos[0]);
+            float c11 = lerp(at(db + dg), at(db + dg + 4), pos[0]);
+            float v = lerp(lerp(c00, c10, pos[1]), lerp(c01, c11, pos[1]), pos[2]);
+            rgba[c] = post[(uint8_t)std::clamp(v + 0.5f, 0.0f, 255.0f)];
+        }
+#endif
+    }
+}
+
+std::shared_ptr<const BackgroundSnapshot> AdjustBackground(const BackgroundSnapshot &src, const AdjustmentLut &lut,
+                                                           const SelectionMask *within) {
+    return BuildBackgroundWithin(src, within, [&](const BackgroundTileEdit &t) {
+        for (int y = 0; y < t.height; ++y) {
+            uint8_t *row = t.rgba + (size_t)y * t.width * 4;
+            src.ReadRow(t.y0 + y, t.x0, t.width, row);
+            ApplyAdjustmentLut(lut, row, t.width);
+        }
+    });
+}
@@ -0,0 +1,65 @@
+// Adjustments.hpp
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Document.hpp"
+#include "Selection.hpp"
+
+// Colour adjustments for the background image.
+//
+// A stack of adjustments is compiled once into lookup tables: the leading
+// run of per-channel adjustments (brightness/contrast, levels, curves,
+// invert) becomes one 256-entry curve, the steps from the first to the last
+// hue/saturation are sampled into a 3-D table that pixels are trilinearly
+// interpolated in, four channels per SSE register, and the trailing
+// per-channel run becomes a second curve, so sharp curves after the table
+// stay exact. Applying the tables is a single parallel pass over the image
+// however deep the stack.
+// Colour is adjusted straight (not premultiplied); alpha is left as is.
+
+enum AdjustmentKind {
+    ADJUST_BRIGHTNESS_CONTRAST = 0,
+    ADJUST_LEVELS,
+    ADJUST_CURVES,
+    ADJUST_HUE_SATURATION,
+    ADJUST_INVERT,
+    ADJUST_COUNT
+};
+
+struct Adjustment {
+    AdjustmentKind kind = ADJUST_BRIGHTNESS_CONTRAST;
+    float brightness = 0.0f;    // -1..1
+    float contrast = 0.0f;      // -1..1
+    float inBlack = 0.0f;       // levels, 0..255
+    float inWhite = 255.0f;
+    float gamma = 1.0f;
+    float outBlack = 0.0f;
+    float outWhite = 255.0f;
+    float shadows = 64.0f;      // curves: outputs for inputs 64, 128 and 192
+    float midtones = 128.0f;
+    float highlights = 192.0f;
+    float hue = 0.0f;           // degrees
+    float saturation = 0.0f;    // -1..1
+    float lightness = 0.0f;     // -1..1
+};
+
+const char *AdjustmentName(AdjustmentKind kind);
+
+struct AdjustmentLut {
+    static const int kGrid = 33;        // 3-D table points per axis
+
+    uint8_t curve[256];                 // applied to each channel first
+    std::vector<float> grid;            // kGrid^3 RGB_ entries (0..255); empty if not needed
+    uint8_t post[256];                  // applied to each channel after the grid
+};
+
+AdjustmentLut CompileAdjustments(const std::vector<Adjustment> &stack);
+
+// Adjusts `count` straight-alpha RGBA pixels in place.
+void ApplyAdjustmentLut(const AdjustmentLut &lut, uint8_t *rgba, int count);
+
+// `src` with the tables applied, tile by tile in parallel; only to the
+// selected pixels when there is a selection. Any thread.
+std::shared_ptr<const BackgroundSnapshot> AdjustBackground(const BackgroundSnapshot &src, const AdjustmentLut &lut,
+                                                           const SelectionMask *within = nullptr);
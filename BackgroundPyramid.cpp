@@ -0,0 +1,322 @@
+// BackgroundPyramid.cpp
+#include "BackgroundPyramid.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using Tile = BackgroundSnapshot::Tile;
+const int kTile = BackgroundSnapshot::kTileSize;
+
+uint64_t TileKey(int level, int tx, int ty) {
+    return ((uint64_t)level << 48) | ((uint64_t)ty << 24) | (uint64_t)tx;
+}
+
+// Empty levels for a `w` x `h` image, halving until one tile holds the level.
+std::vector<PyramidLevel> LevelShapes(int w, int h) {
+    std::vector<PyramidLevel> levels;
+    for (;;) {
+        PyramidLevel l;
+        l.width = w;
+        l.height = h;
+        l.tilesX = (w + kTile - 1) / kTile;
+        l.tilesY = (h + kTile - 1) / kTile;
+        l.tiles.resize((size_t)l.tilesX * l.tilesY);
+        levels.push_back(std::move(l));
+        if (w <= kTile && h <= kTile) break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    return levels;
+}
+
+bool SameImage(const BackgroundSnapshot *a, const BackgroundSnapshot *b) {
+    return a && b && a->imageId == b->imageId && a->width == b->width && a->height == b->height;
+}
+
+// Tile (tx, ty) of `parent` as the 2x2 box filter of its four children.
+// Colour is weighted by alpha so erased pixels do not darken the edges.
+std::shared_ptr<const Tile> DownsampleTile(const PyramidLevel &child, const PyramidLevel &parent, int tx, int ty) {
+    int pw = std::min(kTile, parent.width - tx * kTile);
+    int ph = std::min(kTile, parent.height - ty * kTile);
+    auto tile = std::make_shared<Tile>();
+    tile->rgba.resize((size_t)pw * ph * 4);
+
+    for (int qy = 0; qy < 2; ++qy) {
+        for (int qx = 0; qx < 2; ++qx) {
+            int ctx = tx * 2 + qx, cty = ty * 2 + qy;
+            if (ctx >= child.tilesX || cty >= child.tilesY) continue;
+            const uint8_t *src = child.tiles[(size_t)cty * child.tilesX + ctx]->rgba.data();
+            int cw = std::min(kTile, child.width - ctx * kTile);
+            int ch = std::min(kTile, child.height - cty * kTile);
+
+            // each child fills one quadrant of the parent tile
+            int px0 = qx * kTile / 2, py0 = qy * kTile / 2;
+            int cols = std::min(pw - px0, (cw + 1) / 2);
+            int rows = std::min(ph - py0, (ch + 1) / 2);
+            for (int y = 0; y < rows; ++y) {
+                const uint8_t *r0 = src + (size_t)(y * 2) * cw * 4;
+                const uint8_t *r1 = src + (size_t)std::min(y * 2 + 1, ch - 1) * cw * 4;
+                uint8_t *dst = tile->rgba.data() + ((size_t)(py0 + y) * pw + px0) * 4;
+                for (int x = 0; x < cols; ++x, dst += 4) {
+                    int x0 = x * 2 * 4, x1 = std::min(x * 2 + 1, cw - 1) * 4;
+                    const uint8_t *p[4] = { r0 + x0, r0 + x1, r1 + x0, r1 + x1 };
+                    unsigned a = p[0][3] + p[1][3] + p[2][3] + p[3][3];
+                    for (int c = 0; c < 3; ++c) {
+                        if (a == 0) {
+                            dst[c] = (uint8_t)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                        } else {
+                            unsigned sum = p[0][c] * p[0][3] + p[1][c] * p[1][3] + p[2][c] * p[2][3] + p[3][c] * p[3][3];
+                            dst[c] = (uint8_t)((sum + a / 2) / a);
+                        }
+                    }
+                    dst[3] = (uint8_t)((a + 2) / 4);
+                }
+            }
+        }
+    }
+    return tile;
+}
+
+} // namespace
+
+std::shared_ptr<const BackgroundLevels> BuildBackgroundLevels(const std::shared_ptr<const BackgroundSnapshot> &src,
+                                                              const BackgroundLevels *prev) {
+    auto out = std::make_shared<BackgroundLevels>();
+    out->source = src;
+    out->levels = LevelShapes(src->width, src->height);
+    out->levels[0].tiles = src->tiles;
+    out->complete = true;
+
+    bool reuse = prev && prev->complete && SameImage(prev->source.get(), src.get());
+    std::vector<uint8_t> changed(src->tiles.size(), 1);
+    if (reuse)
+        for (size_t t = 0; t < changed.size(); ++t) changed[t] = prev->levels[0].tiles[t] != src->tiles[t];
+
+    for (size_t l = 1; l < out->levels.size(); ++l) {
+        const PyramidLevel &child = out->levels[l - 1];
+        PyramidLevel &level = out->levels[l];
+
+        std::vector<uint8_t> parentChanged(level.tiles.size(), 0);
+        for (int cy = 0; cy < child.tilesY; ++cy)
+            for (int cx = 0; cx < child.tilesX; ++cx)
+                if (changed[(size_t)cy * child.tilesX + cx]) parentChanged[(size_t)(cy / 2) * level.tilesX + cx / 2] = 1;
+
+        std::vector<int> todo;
+        for (size_t t = 0; t < level.tiles.size(); ++t) {
+            if (reuse && !parentChanged[t]) level.tiles[t] = prev->levels[l].tiles[t];
+            else todo.push_back((int)t);
+        }
+        ParallelFor("pyramid level", (int)todo.size(), 4, [&](int i0, int i1) {
+            for (int i = i0; i < i1; ++i) {
+                int t = todo[i];
+                level.tiles[t] = DownsampleTile(child, level, t % level.tilesX, t / level.tilesX);
+            }
+        });
+        changed.swap(parentChanged);
+    }
+    return out;
+}
+
+void BackgroundPyramid::SetSource(std::shared_ptr<const BackgroundSnapshot> bg) {
+    if (bg == current->source) return;
+
+    auto next = std::make_shared<BackgroundLevels>();
+    next->source = bg;
+    next->complete = true;
+    if (bg) {
+        next->levels = LevelShapes(bg->width, bg->height);
+        next->levels[0].tiles = bg->tiles;
+        // an edit of the same image keeps the old coarse levels on screen
+        // until the rebuild lands; a different image starts without them
+        if (SameImage(current->source.get(), bg.get()))
+            for (size_t l = 1; l < next->levels.size(); ++l) next->levels[l].tiles = current->levels[l].tiles;
+        next->complete = next->levels.size() == 1;
+    }
+    if (built && !SameImage(built->source.get(), bg.get())) built.reset();
+    current = std::move(next);
+    ++generation;
+
+    if (!current->complete && !buildJob) StartBuild();
+}
+
+void BackgroundPyramid::StartBuild() {
+    auto src = current->source;
+    auto prev = built;
+    auto result = std::make_shared<std::shared_ptr<const BackgroundLevels>>();
+    buildResult = result;
+    buildJob = RunJob("background pyramid", [src, prev, result] { *result = BuildBackgroundLevels(src, prev.get()); });
+}
+
+void BackgroundPyramid::AdoptBuild() {
+    std::shared_ptr<const BackgroundLevels> result = std::move(*buildResult);
+    buildJob.reset();
+    buildResult.reset();
+
+    if (SameImage(result->source.get(), current->source.get())) built = result;
+    if (result->source == current->source) {
+        current = result;
+        ++generation;
+    } else if (!current->complete) {
+        StartBuild();  // the source moved on while this one was building
+    }
+}
+
+std::shared_ptr<const BackgroundLevels> BackgroundPyramid::CompleteLevels() {
+    while (!current->complete) {
+        if (!buildJob) StartBuild();
+        WaitJob(buildJob);
+        AdoptBuild();
+    }
+    return current;
+}
+
+BackgroundPyramid::GpuTile *BackgroundPyramid::Resident(uint64_t key, uint64_t imageId) {
+    auto it = gpu.find(key);
+    if (it == gpu.end() || it->second.imageId != imageId) return nullptr;
+    return &it->second;
+}
+
+BackgroundPyramid::GpuTile *BackgroundPyramid::Upload(const Request &r) {
+    GpuTile &g = gpu[r.key];
+    if (g.texture.id != 0 && g.texture.width == r.width && g.texture.height == r.height) {
+        UpdateTexture(g.texture, r.tile->rgba.data());
+    } else {
+        if (g.texture.id != 0) UnloadTexture(g.texture);
+        Image img = { (void *)r.tile->rgba.data(), r.width, r.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+        g.texture = LoadTextureFromImage(img);
+    }
+    g.source = r.tile;
+    g.imageId = r.imageId;
+    g.lastUsed = tick;
+    ++generation;
+    return &g;
+}
+
+// Covers tile (tx, ty) of `level` with part of the nearest coarser resident tile.
+bool BackgroundPyramid::DrawFallback(const BackgroundLevels &levels, int level, int tx, int ty) {
+    uint64_t imageId = levels.source->imageId;
+    for (int p = level + 1; p < (int)levels.levels.size(); ++p) {
+        int shift = p - level;
+        int ptx = tx >> shift, pty = ty >> shift;
+        GpuTile *g = Resident(TileKey(p, ptx, pty), imageId);
+        if (!g) continue;
+
+        float cell = (float)(kTile >> shift);  // parent texels per child tile
+        Rectangle src = { (tx - (ptx << shift)) * cell, (ty - (pty << shift)) * cell, cell, cell };
+        src.width = std::min(src.width, g->texture.width - src.x);
+        src.height = std::min(src.height, g->texture.height - src.y);
+        if (src.width <= 0 || src.height <= 0) return false;
+
+        float scale = (float)(1 << p);
+        Rectangle dst = { (ptx * kTile + src.x) * scale, (pty * kTile + src.y) * scale, src.width * scale, src.height * scale };
+        DrawTexturePro(g->texture, src, dst, { 0, 0 }, 0.0f, WHITE);
+        g->lastUsed = tick;
+        return true;
+    }
+    return false;
+}
+
+void BackgroundPyramid::Draw(const BackgroundLevels &levels, Rectangle view, float zoom, bool sync) {
+    if (!levels.source) return;
+    ++tick;
+    uint64_t imageId = levels.source->imageId;
+    int top = (int)levels.levels.size() - 1;
+
+    // the coarsest level backs every fallback, so keep it resident
+    if (const auto &tile = levels.levels[top].tiles[0]) {
+        GpuTile *g = Resident(TileKey(top, 0, 0), imageId);
+        if (g) g->lastUsed = tick;
+        if (!g || g->source != tile) {
+            Request r = { TileKey(top, 0, 0), imageId, tile, levels.levels[top].width, levels.levels[top].height };
+            if (sync) Upload(r);
+            else requests.push_back(r);
+        }
+    }
+
+    // finest level whose texels are still at least a screen pixel
+    int level = 0;
+    if (zoom < 1.0f) level = std::min(top, (int)floorf(log2f(1.0f / zoom)));
+    const PyramidLevel &lv = levels.levels[level];
+    float scale = (float)(1 << level);
+    float span = kTile * scale;  // document pixels per tile
+
+    int tx0 = std::max(0, (int)floorf(view.x / span));
+    int ty0 = std::max(0, (int)floorf(view.y / span));
+    int tx1 = std::min(lv.tilesX - 1, (int)floorf((view.x + view.width) / span));
+    int ty1 = std::min(lv.tilesY - 1, (int)floorf((view.y + view.height) / span));
+
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            uint64_t key = TileKey(level, tx, ty);
+            const auto &tile = lv.tiles[(size_t)ty * lv.tilesX + tx];
+            GpuTile *g = Resident(key, imageId);
+            if (tile && (!g || g->source != tile)) {
+                Request r = { key, imageId, tile, std::min(kTile, lv.width - tx * kTile), std::min(kTile, lv.height - ty * kTile) };
+                if (sync) g = Upload(r);
+                else requests.push_back(r);  // an outdated copy is drawn meanwhile
+            }
+
+            if (g) {
+                g->lastUsed = tick;
+                Rectangle src = { 0, 0, (float)g->texture.width, (float)g->texture.height };
+                Rectangle dst = { tx * span, ty * span, g->texture.width * scale, g->texture.height * scale };
+                DrawTexturePro(g->texture, src, dst, { 0, 0 }, 0.0f, WHITE);
+            } else {
+                DrawFallback(levels, level, tx, ty);
+            }
+        }
+    }
+}
+
+void BackgroundPyramid::Update() {
+    if (buildJob && IsJobDone(buildJob)) AdoptBuild();
+
+    // coarse tiles first: they are the fallbacks for everything below them
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](const Request &a, const Request &b) { return (a.key >> 48) > (b.key >> 48); });
+    int uploads = 0;
+    for (const Request &r : requests) {
+        if (uploads >= kUploadsPerFrame) break;
+        GpuTile *g = Resident(r.key, r.imageId);
+        if (g && g->source == r.tile) continue;
+        Upload(r);
+        ++uploads;
+    }
+    requests.clear();
+
+    Evict(lastUpdateTick);
+    lastUpdateTick = tick;
+}
+
+void BackgroundPyramid::Trim() {
+    Evict(tick - 1);
+}
+
+// Unloads least recently used tiles until the cache is back to its budget,
+// but never one used after tick `keepAfter`.
+void BackgroundPyramid::Evict(uint64_t keepAfter) {
+    if ((int)gpu.size() <= kMaxResidentTiles) return;
+
+    std::vector<std::pair<uint64_t, uint64_t>> byAge;  // (lastUsed, key)
+    byAge.reserve(gpu.size());
+    for (const auto &e : gpu) byAge.push_back({ e.second.lastUsed, e.first });
+    std::sort(byAge.begin(), byAge.end());
+    for (const auto &e : byAge) {
+        if ((int)gpu.size() <= kMaxResidentTiles || e.first > keepAfter) break;
+        auto it = gpu.find(e.second);
+        UnloadTexture(it->second.texture);
+        gpu.erase(it);
+    }
+}
+
+void BackgroundPyramid::Release() {
+    if (buildJob) WaitJob(buildJob);
+    buildJob.reset();
+    buildResult.reset();
+    for (auto &e : gpu) UnloadTexture(e.second.texture);
+    gpu.clear();
+    requests.clear();
+    current = std::make_shared<BackgroundLevels>();
+    built.reset();
+}
@@ -0,0 +1,106 @@
+// BackgroundPyramid.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Document.hpp"
+#include "JobSystem.hpp"
+
+// Virtual-textured drawing of the background image.
+//
+// The snapshot's tiles are level 0 of a mip pyramid; each further level
+// halves the resolution, down to a single tile. Levels are built on the job
+// pool whenever a new background is published, rebuilding only the parents
+// of tiles that changed. On the GPU only the tiles the view needs are
+// resident, in a fixed-size LRU cache filled a few uploads per frame; until a
+// tile arrives, the nearest coarser resident tile stands in for it.
+
+struct PyramidLevel {
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<std::shared_ptr<const BackgroundSnapshot::Tile>> tiles;  // row-major, null until built
+};
+
+// One immutable pyramid. Level 0 shares the source snapshot's tiles.
+struct BackgroundLevels {
+    std::shared_ptr<const BackgroundSnapshot> source;
+    std::vector<PyramidLevel> levels;
+    bool complete = false;  // every level is built for `source`
+};
+
+// Any thread. The full pyramid for `src`. Parents whose children all match
+// `prev` (may be null or incomplete) are shared with it, so after a brush
+// stroke only the few tiles above it are rebuilt.
+std::shared_ptr<const BackgroundLevels> BuildBackgroundLevels(const std::shared_ptr<const BackgroundSnapshot> &src,
+                                                              const BackgroundLevels *prev);
+
+class BackgroundPyramid {
+public:
+    static const int kMaxResidentTiles = 512;  // 128 MB of 256 px RGBA tiles
+    static const int kUploadsPerFrame = 16;
+
+    // Main thread, once per frame with the published background (may be null).
+    void SetSource(std::shared_ptr<const BackgroundSnapshot> bg);
+
+    // Latest levels for the current source; coarse levels may still show the
+    // previous content or be missing while a build runs.
+    std::shared_ptr<const BackgroundLevels> Levels() const { return current; }
+    // Blocks until every level of the current source is built.
+    std::shared_ptr<const BackgroundLevels> CompleteLevels();
+
+    // Draws the part of the background inside `view` (document space) for a
+    // view showing `zoom` screen pixels per document pixel, inside BeginMode2D.
+    // With `sync` every needed tile is uploaded now (offscreen rendering);
+    // otherwise missing tiles are queued for Update().
+    void Draw(const BackgroundLevels &levels, Rectangle view, float zoom, bool sync);
+
+    // Once per frame: adopts finished builds, uploads queued tiles and trims
+    // the cache back to its budget, keeping everything drawn since the last call.
+    void Update();
+    // Trims the cache between offscreen passes, keeping only the tiles of the
+    // last Draw. The batch using the evicted textures must have been flushed.
+    void Trim();
+    // Unloads every texture and waits for a running build (before CloseWindow).
+    void Release();
+
+    size_t ResidentTiles() const { return gpu.size(); }
+    // Changes whenever a Draw of the current levels could look different
+    // (tiles uploaded, levels rebuilt), so cached renders know to redraw.
+    uint64_t Generation() const { return generation; }
+
+private:
+    struct GpuTile {
+        Texture2D texture = {};
+        std::shared_ptr<const BackgroundSnapshot::Tile> source;  // pixels it was uploaded from
+        uint64_t imageId = 0;
+        uint64_t lastUsed = 0;  // tick of the last Draw that used it
+    };
+    struct Request {
+        uint64_t key;
+        uint64_t imageId;
+        std::shared_ptr<const BackgroundSnapshot::Tile> tile;
+        int width, height;
+    };
+
+    void StartBuild();
+    void AdoptBuild();
+    GpuTile *Upload(const Request &r);
+    GpuTile *Resident(uint64_t key, uint64_t imageId);
+    bool DrawFallback(const BackgroundLevels &levels, int level, int tx, int ty);
+    void Evict(uint64_t keepAfter);
+
+    std::shared_ptr<const BackgroundLevels> current = std::make_shared<BackgroundLevels>();
+    std::shared_ptr<const BackgroundLevels> built;   // last complete pyramid, reused by the next build
+    JobRef buildJob;
+    std::shared_ptr<std::shared_ptr<const BackgroundLevels>> buildResult;
+
+    std::unordered_map<uint64_t, GpuTile> gpu;
+    std::vector<Request> requests;
+    uint64_t tick = 0;            // bumped by every Draw
+    uint64_t lastUpdateTick = 0;
+    uint64_t generation = 0;
+};
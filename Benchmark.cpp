@@ -0,0 +1,373 @@
+// Benchmark.cpp
+#include "Benchmark.hpp"
+#include "PngEncoder.hpp"
+#include "ImageOps.hpp"
+#include "Palette.hpp"
+#include "FloodFill.hpp"
+#include "CanvasTransform.hpp"
+#include "Filters.hpp"
+#include "Adjustments.hpp"
+#include "JobSystem.hpp"
+#include <raylib-cpp.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const char *kBenchFile = "bench_tmp.png";
+
+static double NowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// A stroke-heavy drawing on white, similar to what the app produces.
+static Image GenBenchmarkDocument(int w, int h) {
+    Image img = GenImageColor(w, h, WHITE);
+    SetRandomSeed(1234);
+    for (int i = 0; i < 400; ++i) {
+        Color c = ColorFromHSV((float)GetRandomValue(0, 359), 0.8f, (float)GetRandomValue(20, 100) / 100.0f);
+        Vector2 a = { (float)GetRandomValue(0, w - 1), (float)GetRandomValue(0, h - 1) };
+        Vector2 b = { (float)GetRandomValue(0, w - 1), (float)GetRandomValue(0, h - 1) };
+        ImageDrawLineEx(&img, a, b, GetRandomValue(2, 24), c);
+        if (i % 8 == 0) ImageDrawCircle(&img, (int)a.x, (int)a.y, GetRandomValue(10, w / 16), c);
+    }
+    return img;
+}
+
+static void PrintRow(const char *name, double ms, double baseMs) {
+    int bytes = GetFileLength(kBenchFile);
+    printf("  %-28s %9.1f ms  %6.2fx  %10d bytes\n", name, ms, baseMs / ms, bytes);
+}
+
+static void BenchPng(int w, int h) {
+    Image img = GenBenchmarkDocument(w, h);
+    int hw = JobWorkerCount();
+    printf("PNG encode, %dx%d RGBA, %d pool workers\n", w, h, hw);
+
+    double t0 = NowMs();
+    ExportImage(img, kBenchFile);
+    double baseMs = NowMs() - t0;
+    PrintRow("raylib ExportImage", baseMs, baseMs);
+
+    PngFormat fmt;
+    fmt.width = w;
+    fmt.height = h;
+    fmt.colorType = PNG_RGBA;
+    const unsigned char *px = (const unsigned char *)img.data;
+    PngRowSource rows = [&](int y, int count, uint8_t *dst) {
+        memcpy(dst, px + (size_t)y * w * 4, (size_t)count * w * 4);
+    };
+
+    for (int level : { 1, 6, 9 }) {
+        for (int threads : { 1, hw }) {
+            if (threads == hw && hw == 1) continue;
+            PngEncodeOptions opts;
+            opts.level = level;
+            opts.threads = threads;
+            t0 = NowMs();
+            EncodePng(kBenchFile, fmt, rows, opts);
+            double ms = NowMs() - t0;
+            PrintRow(TextFormat("EncodePng level %d, %d thr", level, threads), ms, baseMs);
+        }
+    }
+
+    UnloadImage(img);
+    remove(kBenchFile);
+}
+
+// The export path before the fused pipeline: float flatten, separate flip.
+static void LegacyFlattenToWhite(Image &img) {
+    Color *px = (Color *)img.data;
+    int count = img.width * img.height;
+    for (int i = 0; i < count; i++) {
+        float a = px[i].a / 255.0f;
+        px[i].r = (unsigned char)(px[i].r * a + 255 * (1.0f - a));
+        px[i].g = (unsigned char)(px[i].g * a + 255 * (1.0f - a));
+        px[i].b = (unsigned char)(px[i].b * a + 255 * (1.0f - a));
+        px[i].a = 255;
+    }
+}
+
+static void BenchExport(int w, int h) {
+    // stands in for the GPU readback: bottom-up, with erased (transparent) areas
+    Image readback = GenBenchmarkDocument(w, h);
+    Color *px = (Color *)readback.data;
+    for (int y = h / 3; y < h / 2; ++y)
+        for (int x = 0; x < w; ++x) px[(size_t)y * w + x].a = (unsigned char)(x & 255);
+
+    double mb = 1.0 / (1024.0 * 1024.0);
+    double rgba = (double)w * h * 4;
+    printf("Export pipeline, %dx%d (%.1f MP)\n", w, h, w * (double)h / 1e6);
+
+    Image img = ImageCopy(readback);
+    double t0 = NowMs();
+    LegacyFlattenToWhite(img);
+    double tFlatten = NowMs() - t0;
+    t0 = NowMs();
+    ImageFlipVertical(&img);
+    double tFlip = NowMs() - t0;
+    t0 = NowMs();
+    ExportImage(img, kBenchFile);
+    double tEncode = NowMs() - t0;
+    UnloadImage(img);
+    double legacyMs = tFlatten + tFlip + tEncode;
+    printf("  legacy: flatten %.1f ms, flip %.1f ms, ExportImage %.1f ms\n", tFlatten, tFlip, tEncode);
+    PrintRow("legacy total", legacyMs, legacyMs);
+    // flip copy + stb's whole-image filter buffer, on top of the readback
+    printf("  legacy extra buffers: ~%.1f MB\n", (rgba + (double)h * (w * 4 + 1)) * mb);
+
+    PngFormat fmt;
+    fmt.width = w;
+    fmt.height = h;
+    fmt.colorType = PNG_RGB;
+    const uint8_t *src = (const uint8_t *)readback.data;
+    PngRowSource rows = [&](int y, int count, uint8_t *dst) {
+        for (int i = 0; i < count; ++i)
+            CompositeOverWhiteToRGB(src + (size_t)(h - 1 - y - i) * w * 4, dst + (size_t)i * w * 3, w);
+    };
+    PngEncodeOptions opts;
+    t0 = NowMs();
+    EncodePng(kBenchFile, fmt, rows, opts);
+    PrintRow("fused (EncodePng RGB)", NowMs() - t0, legacyMs);
+
+    // in-flight bands: raw + filtered + compressed, about 1 MB of rows each
+    int threads = JobWorkerCount();
+    double band = std::max(16, (1 << 20) / (w * 3 + 1)) * (double)(w * 3 + 1);
+    printf("  fused extra buffers: ~%.1f MB (%d bands in flight)\n", 2 * threads * band * 2.5 * mb, 2 * threads);
+
+    UnloadImage(readback);
+    remove(kBenchFile);
+}
+
+static void BenchPalette(int w, int h) {
+    Image img = GenBenchmarkDocument(w, h);
+    const uint8_t *px = (const uint8_t *)img.data;
+    printf("Indexed PNG, %dx%d stroke document\n", w, h);
+
+    PngFormat rgb;
+    rgb.width = w;
+    rgb.height = h;
+    rgb.colorType = PNG_RGB;
+    PngEncodeOptions opts;
+
+    double t0 = NowMs();
+    EncodePng(kBenchFile, rgb, [&](int y, int count, uint8_t *dst) {
+        for (int i = 0; i < count; ++i)
+            CompositeOverWhiteToRGB(px + (size_t)(y + i) * w * 4, dst + (size_t)i * w * 3, w);
+    }, opts);
+    double baseMs = NowMs() - t0;
+    PrintRow("RGB", baseMs, baseMs);
+
+    for (PaletteMode mode : { PALETTE_EXACT, PALETTE_QUANTIZE }) {
+        PaletteOptions po;
+        po.mode = mode;
+        PaletteMap map;
+        t0 = NowMs();
+        if (!BuildPalette(px, w, h, po, map)) {
+            printf("  %-28s more than 256 colours\n", "exact");
+            continue;
+        }
+        double tBuild = NowMs() - t0;
+
+        PngFormat fmt = rgb;
+        fmt.colorType = PNG_INDEXED;
+        fmt.bitDepth = map.bitDepth;
+        fmt.palette = map.palette;
+        int rb = PngRowBytes(fmt);
+        EncodePng(kBenchFile, fmt, [&](int y, int count, uint8_t *dst) {
+            for (int i = 0; i < count; ++i) map.MapRow(px + (size_t)(y + i) * w * 4, w, y + i, dst + (size_t)i * rb);
+        }, opts);
+        double ms = NowMs() - t0;
+        PrintRow(TextFormat("%s, %d colours, %d-bit", map.exact ? "exact" : "quantized",
+                            (int)map.palette.size() / 3, map.bitDepth), ms, baseMs);
+        printf("  %-28s %9.1f ms building the palette\n", "", tBuild);
+    }
+
+    UnloadImage(img);
+    remove(kBenchFile);
+}
+
+static void BenchFill(int w, int h) {
+    Image img = GenBenchmarkDocument(w, h);
+    const uint8_t *px = (const uint8_t *)img.data;
+    printf("Bucket fill, %dx%d stroke document\n", w, h);
+
+    // seed on the first white pixel, which is part of the large white area
+    int seed = 0;
+    while (seed < w * h - 1 && memcmp(px + (size_t)seed * 4, "\xff\xff\xff\xff", 4) != 0) ++seed;
+
+    for (int tolerance : { 0, 64 }) {
+        for (bool expand : { false, true }) {
+            FloodFillRegion region;
+            double t0 = NowMs();
+            FloodFill(px, w, h, (ptrdiff_t)w * 4, seed % w, seed / w, tolerance, expand, region);
+            double ms = NowMs() - t0;
+            printf("  tolerance %3d%-15s %9.1f ms  %10zu px\n", tolerance, expand ? ", expanded" : "", ms, region.count);
+        }
+    }
+
+    UnloadImage(img);
+}
+
+// The app's own bucket click (main.cpp), timed in a hidden window.
+extern int FillCanvasAt(const Vector2 &docPos, Color color, int tolerance, bool expandEdges);
+extern Image RenderCanvasImage(int canvasW, int canvasH);
+extern void OpenBenchmarkDocument(const Image &img);
+extern void CloseBenchmarkDocument();
+
+static void BenchFillClick(int w, int h) {
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(64, 64, "ratart bench");
+    Image img = GenBenchmarkDocument(w, h);
+    // a small closed box, for a click that stays local
+    const int bx = w / 4, by = h / 4, bs = 64;
+    ImageDrawRectangleLines(&img, { (float)bx, (float)by, (float)bs, (float)bs }, 3, BLACK);
+    ImageDrawRectangle(&img, bx + 3, by + 3, bs - 6, bs - 6, WHITE);
+    OpenBenchmarkDocument(img);
+    printf("Bucket click (render + region + fill), %dx%d document\n", w, h);
+
+    int seed = 0;
+    const uint8_t *px = (const uint8_t *)img.data;
+    while (seed < w * h - 1 && memcmp(px + (size_t)seed * 4, "\xff\xff\xff\xff", 4) != 0) ++seed;
+    struct Click { const char *name; Vector2 pos; } clicks[] = {
+        { "inside a small box", { bx + bs * 0.5f, by + bs * 0.5f } },
+        { "large white area", { (float)(seed % w), (float)(seed / w) } },
+    };
+    const int kRuns = 5;
+    for (const Click &c : clicks) {
+        // the old path: the whole canvas read back, then the region found
+        double t0 = NowMs();
+        for (int i = 0; i < kRuns; ++i) {
+            Image canvas = RenderCanvasImage(w, h);
+            FloodFillRegion region;
+            const uint8_t *top = (const uint8_t *)canvas.data + (size_t)(h - 1) * w * 4;
+            FloodFill(top, w, h, -(ptrdiff_t)w * 4, (int)c.pos.x, (int)c.pos.y, 0, true, region);
+            UnloadImage(canvas);
+        }
+        double baseMs = (NowMs() - t0) / kRuns;
+
+        // the click as the tool makes it, fill included; colours alternate
+        // so every click finds the same region
+        int blocks = 0;
+        t0 = NowMs();
+        for (int i = 0; i < kRuns; ++i) blocks = FillCanvasAt(c.pos, (i % 2) ? WHITE : SKYBLUE, 0, true);
+        double ms = (NowMs() - t0) / kRuns;
+        printf("  %-20s full readback %8.1f ms   click %8.1f ms  %6.2fx  (%d blocks rendered)\n",
+               c.name, baseMs, ms, baseMs / ms, blocks);
+    }
+
+    CloseBenchmarkDocument();
+    UnloadImage(img);
+    CloseWindow();
+}
+
+static void BenchOrient(int w, int h) {
+    Image img = GenBenchmarkDocument(w, h);
+    printf("Canvas rotate/flip, %dx%d (%.1f MP)\n", w, h, w * (double)h / 1e6);
+
+    // per-pixel rotation, column by column: every write misses the cache
+    const uint32_t *src = (const uint32_t *)img.data;
+    std::vector<uint32_t> naive((size_t)w * h);
+    double t0 = NowMs();
+    for (int x = 0; x < w; ++x)
+        for (int y = 0; y < h; ++y) naive[(size_t)x * h + (h - 1 - y)] = src[(size_t)y * w + x];
+    double baseMs = NowMs() - t0;
+    printf("  %-28s %9.1f ms\n", "naive rotate 90", baseMs);
+
+    auto bg = TileBackground(img);
+    UnloadImage(img);
+    const char *names[] = { "rotate 90 CW", "rotate 180", "rotate 90 CCW", "flip horizontal", "flip vertical" };
+    for (int op = 0; op < 5; ++op) {
+        t0 = NowMs();
+        auto out = OrientBackground(*bg, (CanvasOrientation)op);
+        double ms = NowMs() - t0;
+        printf("  %-28s %9.1f ms  %6.2fx\n", names[op], ms, baseMs / ms);
+    }
+}
+
+// Blur time should not grow with the radius.
+static void BenchFilter(int w, int h) {
+    Image img = GenBenchmarkDocument(w, h);
+    printf("Background filters, %dx%d (%.1f MP)\n", w, h, w * (double)h / 1e6);
+    auto bg = TileBackground(img);
+    UnloadImage(img);
+
+    for (int kind = 0; kind < FILTER_COUNT; ++kind) {
+        for (float radius : { 2.0f, 32.0f }) {
+            FilterParams params;
+            params.kind = (FilterKind)kind;
+            params.radius = radius;
+            double t0 = NowMs();
+            auto out = FilterBackground(*bg, params);
+            double ms = NowMs() - t0;
+            printf("  %-18s radius %-6.0f %9.1f ms\n", FilterName(params.kind), radius, ms);
+            if (params.kind == FILTER_FIND_EDGES) break;
+        }
+    }
+}
+
+// A stack of five adjustments, one pass per step against the compiled stack.
+static void BenchAdjust(int w, int h) {
+    Image img = GenBenchmarkDocument(w, h);
+    printf("Colour adjustments, %dx%d (%.1f MP)\n", w, h, w * (double)h / 1e6);
+    auto bg = TileBackground(img);
+    UnloadImage(img);
+
+    std::vector<Adjustment> stack(5);
+    stack[0].kind = ADJUST_BRIGHTNESS_CONTRAST;
+    stack[0].contrast = 0.2f;
+    stack[1].kind = ADJUST_LEVELS;
+    stack[1].gamma = 1.3f;
+    stack[2].kind = ADJUST_CURVES;
+    stack[2].midtones = 150.0f;
+    stack[3].kind = ADJUST_HUE_SATURATION;
+    stack[3].hue = 30.0f;
+    stack[4].kind = ADJUST_INVERT;
+
+    double t0 = NowMs();
+    auto out = bg;
+    for (const auto &a : stack) out = AdjustBackground(*out, CompileAdjustments({ a }));
+    double baseMs = NowMs() - t0;
+    printf("  %-28s %9.1f ms\n", "one pass per step", baseMs);
+
+    t0 = NowMs();
+    out = AdjustBackground(*bg, CompileAdjustments(stack));
+    double ms = NowMs() - t0;
+    printf("  %-28s %9.1f ms  %6.2fx\n", "compiled stack", ms, baseMs / ms);
+}
+
+int RunBenchmarks(int argc, char **argv) {
+    const char *suite = (argc > 2) ? argv[2] : "all";
+    int w = (argc > 3) ? atoi(argv[3]) : 4096;
+    int h = (argc > 4) ? atoi(argv[4]) : 4096;
+    if (w <= 0 || h <= 0) {
+        printf("usage: ratart --bench [png|export|palette|fill|fill-click|orient|filter|adjust|all] [width height]\n");
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    bool all = strcmp(suite, "all") == 0;
+    bool ran = false;
+    if (all || strcmp(suite, "png") == 0) { BenchPng(w, h); ran = true; }
+    if (all || strcmp(suite, "export") == 0) { BenchExport(w, h); ran = true; }
+    if (all || strcmp(suite, "palette") == 0) { BenchPalette(w, h); ran = true; }
+    if (all || strcmp(suite, "fill") == 0) { BenchFill(w, h); ran = true; }
+    if (all || strcmp(suite, "fill-click") == 0) { BenchFillClick(w, h); ran = true; }
+    if (all || strcmp(suite, "orient") == 0) { BenchOrient(w, h); ran = true; }
+    if (all || strcmp(suite, "filter") == 0) { BenchFilter(w, h); ran = true; }
+    if (all || strcmp(suite, "adjust") == 0) { BenchAdjust(w, h); ran = true; }
+
+    if (!ran) {
+        printf("unknown benchmark suite '%s'\n", suite);
+        return 1;
+    }
+
+    printf("Job timings\n");
+    for (const auto &t : GetJobTimings())
+        printf("  %-28s %6llu runs %9.1f ms total %8.2f ms max\n", t.name.c_str(), t.runs, t.totalMs, t.maxMs);
+    JobsShutdown();
+    return 0;
+}
@@ -0,0 +1,6 @@
+// Benchmark.hpp
+#pragma once
+
+// Command-line benchmarks: `ratart --bench <suite> [width height]`.
+// Run without a window; results are printed to stdout.
+int RunBenchmarks(int argc, char **argv);
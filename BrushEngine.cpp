@@ -0,0 +1,285 @@
+// BrushEngine.cpp
+#include "BrushEngine.hpp"
+#include "LayerCompositor.hpp"
+#include "rlgl.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kTipSide = 256;
+const float kMinDabStep = 0.5f;  // document pixels
+
+uint32_t Hash(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u);
+    h ^= h >> 16; h *= 0x85EBCA6Bu;
+    h ^= h >> 13; h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// [0, 1)
+float Unit(uint32_t h) {
+    return (float)(h >> 8) * (1.0f / 16777216.0f);
+}
+
+void AddDab(const CanvasStroke &stroke, BrushDabCursor &cursor, Vector2 p, std::vector<BrushDab> &out) {
+    const StrokeBrush &brush = *stroke.brush;
+    uint32_t i = cursor.count++;
+    BrushDab d = { p, Unit(Hash(brush.seed, i * 3)) * 2.0f * PI };
+    if (brush.jitter > 0.0f) {
+        // uniform over a disc around the line
+        float r = sqrtf(Unit(Hash(brush.seed, i * 3 + 1))) * brush.jitter * stroke.size;
+        float a = Unit(Hash(brush.seed, i * 3 + 2)) * 2.0f * PI;
+        d.pos.x += cosf(a) * r;
+        d.pos.y += sinf(a) * r;
+    }
+    out.push_back(d);
+}
+
+float Smoothstep(float e0, float e1, float x) {
+    float t = std::clamp((x - e0) / (e1 - e0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// Bilinear value noise over a lattice of `cell` texels.
+float ValueNoise(float x, float y, float cell) {
+    float fx = x / cell, fy = y / cell;
+    int ix = (int)floorf(fx), iy = (int)floorf(fy);
+    float tx = Smoothstep(0.0f, 1.0f, fx - ix), ty = Smoothstep(0.0f, 1.0f, fy - iy);
+    auto at = [](int cx, int cy) { return Unit(Hash((uint32_t)cx * 7919u, (uint32_t)cy)); };
+    float top = at(ix, iy) + (at(ix + 1, iy) - at(ix, iy)) * tx;
+    float bottom = at(ix, iy + 1) + (at(ix + 1, iy + 1) - at(ix, iy + 1)) * tx;
+    return top + (bottom - top) * ty;
+}
+
+// White with the tip's shape in alpha, so the dab colour comes from the tint.
+Image TipImage(BrushTip tip) {
+    Image img = GenImageColor(kTipSide, kTipSide, WHITE);
+    Color *px = (Color *)img.data;
+    const float half = kTipSide * 0.5f;
+    for (int y = 0; y < kTipSide; ++y) {
+        for (int x = 0; x < kTipSide; ++x) {
+            float a = BrushTipAlpha(tip, (x + 0.5f) / half - 1.0f, (y + 0.5f) / half - 1.0f, half);
+            px[y * kTipSide + x].a = (unsigned char)(a * 255.0f + 0.5f);
+        }
+    }
+    return img;
+}
+
+// Raster scale for a `w` x `h` document area seen at `zoom`: the zoom
+// rounded up to a power of two, so zooming in re-stamps a stroke a few
+// times rather than every frame, within the scale and side limits.
+float RasterScale(float w, float h, float zoom) {
+    float want = zoom <= 1.0f ? 1.0f : std::min(BrushRenderer::kMaxRasterScale, exp2f(ceilf(log2f(zoom))));
+    return std::min(want, (float)BrushRenderer::kMaxRasterSide / std::max(w, h));
+}
+
+} // namespace
+
+void PlaceBrushDabs(const CanvasStroke &stroke, BrushDabCursor &cursor, std::vector<BrushDab> &out) {
+    const std::vector<Vector2> &pts = stroke.points;
+    if (pts.empty() || !stroke.brush) return;
+    const float step = std::max(kMinDabStep, stroke.brush->spacing * stroke.size);
+
+    if (cursor.count == 0) {
+        cursor.segment = 0;
+        AddDab(stroke, cursor, pts[0], out);
+        cursor.carry = step;
+    }
+    for (; cursor.segment + 1 < pts.size(); ++cursor.segment) {
+        Vector2 a = pts[cursor.segment], b = pts[cursor.segment + 1];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len = sqrtf(dx * dx + dy * dy);
+        float t = cursor.carry;
+        for (; t <= len; t += step) AddDab(stroke, cursor, { a.x + dx * (t / len), a.y + dy * (t / len) }, out);
+        cursor.carry = t - len;
+    }
+}
+
+float BrushTipAlpha(BrushTip tip, float u, float v, float radius) {
+    const float half = kTipSide * 0.5f;
+    float r = sqrtf(u * u + v * v);
+    switch (tip) {
+        case BRUSH_TIP_HARD: {
+            // anti-aliased over a texel and a half, or a pixel when larger
+            float edge = std::max(1.5f / half, 1.0f / std::max(radius, 1.0f));
+            return std::clamp((1.0f - r) / edge, 0.0f, 1.0f);
+        }
+        case BRUSH_TIP_GRAIN: {
+            // the noise is fixed to the texels of the tip texture
+            int x = std::clamp((int)floorf((u + 1.0f) * half), 0, kTipSide - 1);
+            int y = std::clamp((int)floorf((v + 1.0f) * half), 0, kTipSide - 1);
+            float edge = std::clamp((1.0f - r) * 6.0f, 0.0f, 1.0f);
+            float n = 0.6f * ValueNoise((float)x, (float)y, 12.0f) + 0.4f * Unit(Hash((uint32_t)x, (uint32_t)y));
+            return edge * Smoothstep(0.35f, 0.65f, n);
+        }
+        default:
+            return (r < 1.0f) ? (1.0f - r * r) * (1.0f - r * r) : 0.0f;
+    }
+}
+
+const char *BrushTipName(BrushTip tip) {
+    switch (tip) {
+        case BRUSH_TIP_HARD: return "Hard";
+        case BRUSH_TIP_GRAIN: return "Grain";
+        default: return "Soft";
+    }
+}
+
+const Texture2D &BrushRenderer::Tip(BrushTip tip) {
+    Texture2D &t = tips[tip];
+    if (t.id == 0) {
+        Image img = TipImage(tip);
+        t = LoadTextureFromImage(img);
+        UnloadImage(img);
+        // small dabs sample the mipmaps instead of aliasing
+        GenTextureMipmaps(&t);
+        SetTextureFilter(t, TEXTURE_FILTER_TRILINEAR);
+        SetTextureWrap(t, TEXTURE_WRAP_CLAMP);
+    }
+    return t;
+}
+
+void BrushRenderer::DrawDabs(const CanvasStroke &stroke, const BrushDab *dabs, size_t count, float alpha) {
+    if (count == 0) return;
+    const Texture2D &tip = Tip(stroke.brush->tip);
+    const float h = stroke.size * 0.5f;
+    const Color c = stroke.color;
+    const unsigned char a = (unsigned char)(c.a * std::clamp(alpha, 0.0f, 1.0f) + 0.5f);
+
+    // one quad per dab in a single batch; rlgl only splits it when its
+    // vertex buffer is full
+    rlSetTexture(tip.id);
+    rlBegin(RL_QUADS);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+    rlColor4ub(c.r, c.g, c.b, a);
+    for (size_t i = 0; i < count; ++i) {
+        const BrushDab &d = dabs[i];
+        float ux = cosf(d.angle) * h, uy = sinf(d.angle) * h;  // tip x axis; y axis is (-uy, ux)
+        rlTexCoord2f(0.0f, 0.0f); rlVertex2f(d.pos.x - ux + uy, d.pos.y - uy - ux);
+        rlTexCoord2f(0.0f, 1.0f); rlVertex2f(d.pos.x - ux - uy, d.pos.y - uy + ux);
+        rlTexCoord2f(1.0f, 1.0f); rlVertex2f(d.pos.x + ux - uy, d.pos.y + uy + ux);
+        rlTexCoord2f(1.0f, 0.0f); rlVertex2f(d.pos.x + ux + uy, d.pos.y + uy - ux);
+    }
+    rlEnd();
+    rlSetTexture(0);
+}
+
+void BrushRenderer::RenderStroke(const CanvasStroke &stroke, const Camera2D &cam, RenderTexture2D &target) {
+    dabs.clear();
+    BrushDabCursor cursor;
+    PlaceBrushDabs(stroke, cursor, dabs);
+
+    BeginTextureMode(target);
+    ClearBackground(BLANK);
+    BeginMode2D(cam);
+    BeginLayerContent();
+    DrawDabs(stroke, dabs.data(), dabs.size(), stroke.brush->flow);
+    EndLayerContent();
+    EndMode2D();
+    EndTextureMode();
+}
+
+void BrushRenderer::Unload(Raster &r) {
+    if (r.target.texture.id == 0) return;
+    bytes -= (size_t)r.target.texture.width * r.target.texture.height * 4;
+    UnloadRenderTexture(r.target);
+    r.target = {};
+}
+
+void BrushRenderer::Rasterize(const CanvasStroke &stroke, bool growing, float zoom) {
+    Raster &r = rasters[stroke.id];
+    r.lastUsed = tick;
+
+    const Rectangle &b = stroke.bounds;
+    bool fits = r.target.texture.id != 0 &&
+                b.x >= r.rect.x && b.y >= r.rect.y &&
+                b.x + b.width <= r.rect.x + r.rect.width && b.y + b.height <= r.rect.y + r.rect.height;
+    // a raster is kept when zooming out; zooming in past it stamps it again
+    bool sharp = fits && r.scale >= RasterScale(r.rect.width, r.rect.height, zoom) * 0.999f;
+    if (sharp && r.points == stroke.points.size()) return;
+    if (!sharp) {
+        // a stroke being drawn gets room to grow, so its raster is rarely
+        // replaced; a replaced raster is stamped again from the first dab
+        Unload(r);
+        float pad = growing ? std::max(256.0f, stroke.size * 4.0f) : 1.0f;
+        float x0 = floorf(b.x - pad), y0 = floorf(b.y - pad);
+        float w = ceilf(b.x + b.width + pad) - x0, h = ceilf(b.y + b.height + pad) - y0;
+        r.scale = RasterScale(w, h, zoom);
+        int tw = std::max(1, (int)ceilf(w * r.scale)), th = std::max(1, (int)ceilf(h * r.scale));
+        r.rect = { x0, y0, tw / r.scale, th / r.scale };
+        r.target = LoadRenderTexture(tw, th);
+        SetTextureFilter(r.target.texture, TEXTURE_FILTER_BILINEAR);
+        bytes += (size_t)tw * th * 4;
+        r.cursor = BrushDabCursor();
+    }
+
+    dabs.clear();
+    PlaceBrushDabs(stroke, r.cursor, dabs);
+    r.points = stroke.points.size();
+
+    Camera2D cam = {};
+    cam.target = { r.rect.x, r.rect.y };
+    cam.zoom = r.scale;
+    BeginTextureMode(r.target);
+    if (!sharp) ClearBackground(BLANK);
+    BeginMode2D(cam);
+    BeginLayerContent();
+    DrawDabs(stroke, dabs.data(), dabs.size(), stroke.brush->flow);
+    EndLayerContent();
+    EndMode2D();
+    EndTextureMode();
+}
+
+// Unloads least recently used rasters until the cache is back to its
+// budget, keeping everything used this frame.
+void BrushRenderer::Trim() {
+    if (bytes <= kRasterBudget) return;
+    std::vector<std::pair<uint64_t, uint64_t>> byAge;  // (lastUsed, stroke id)
+    byAge.reserve(rasters.size());
+    for (const auto &e : rasters) byAge.push_back({ e.second.lastUsed, e.first });
+    std::sort(byAge.begin(), byAge.end());
+    for (const auto &e : byAge) {
+        if (bytes <= kRasterBudget || e.first == tick) break;
+        auto it = rasters.find(e.second);
+        Unload(it->second);
+        rasters.erase(it);
+    }
+}
+
+void BrushRenderer::Update(const std::vector<const CanvasStroke *> &strokes, float zoom, const CanvasStroke *inProgress) {
+    ++tick;
+    for (const CanvasStroke *stroke : strokes) {
+        if (!stroke->brush || stroke->erased || stroke->points.empty()) continue;
+        Rasterize(*stroke, stroke == inProgress, zoom);
+    }
+    Trim();
+}
+
+void BrushRenderer::Draw(const CanvasStroke &stroke) {
+    auto it = rasters.find(stroke.id);
+    if (it == rasters.end() || it->second.target.texture.id == 0 || it->second.points != stroke.points.size()) {
+        // not rastered (yet): stamped straight onto the layer
+        dabs.clear();
+        BrushDabCursor cursor;
+        PlaceBrushDabs(stroke, cursor, dabs);
+        DrawDabs(stroke, dabs.data(), dabs.size(), stroke.brush->flow * stroke.brush->opacity);
+        return;
+    }
+    Raster &r = it->second;
+    r.lastUsed = tick;
+    EndLayerContent();
+    CompositeLayer(r.target, r.rect, stroke.brush->opacity, LAYER_BLEND_NORMAL);
+    BeginLayerContent();
+}
+
+void BrushRenderer::Release() {
+    for (auto &e : rasters) Unload(e.second);
+    rasters.clear();
+    bytes = 0;
+    for (Texture2D &t : tips) {
+        if (t.id != 0) UnloadTexture(t);
+        t = {};
+    }
+}
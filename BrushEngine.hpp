@@ -0,0 +1,99 @@
+// BrushEngine.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Document.hpp"
+
+// Brush strokes stamped from dabs.
+//
+// A brush stroke is drawn as round dabs of a tip texture (soft, hard or
+// grainy) placed along its points every `spacing` times its size, each
+// pushed off the line by a seeded random jitter and drawn at the stroke's
+// flow. All the dabs of a stroke go out as textured quads of one rlgl batch,
+// so a stroke of thousands of dabs is one draw call (a few for very long
+// ones, where the batch buffer fills up) instead of one per DrawTexture.
+//
+// Dabs pile up inside their stroke only: the stroke is rendered alone into
+// a texture and that texture is blended onto the layer at the stroke's
+// opacity. The view keeps these rasters per stroke, in an LRU cache with a
+// memory budget; they are stamped at the view's zoom rounded up to a power
+// of two (document resolution at most zoomed out, a few times it zoomed in)
+// and stamped again once the zoom passes them. The stroke being drawn adds
+// just its new dabs every frame, and a committed stroke costs one textured
+// quad however many dabs it has. Offscreen rendering stamps the dabs again at the
+// output's scale, so exports stay sharp.
+
+struct BrushDab {
+    Vector2 pos;   // document coordinates
+    float angle;   // tip rotation, radians
+};
+
+// Where dab placement stopped, so growing strokes only place their new dabs.
+struct BrushDabCursor {
+    size_t segment = 0;   // index of the first point of the current segment
+    float carry = 0.0f;   // distance along that segment to the next dab
+    uint32_t count = 0;   // dabs placed so far
+};
+
+// Appends the dabs of `stroke` (which must have a brush) past `cursor` to
+// `out` and moves the cursor on. Any thread.
+void PlaceBrushDabs(const CanvasStroke &stroke, BrushDabCursor &cursor, std::vector<BrushDab> &out);
+
+const char *BrushTipName(BrushTip tip);
+
+// Coverage of the tip at (u, v) in [-1, 1] across the dab, for a dab of
+// `radius` pixels; what the tip textures hold, for painting dabs on the CPU.
+float BrushTipAlpha(BrushTip tip, float u, float v, float radius);
+
+// Main thread only (GPU resources).
+class BrushRenderer {
+public:
+    static const int kMaxRasterSide = 4096;                      // larger strokes are rastered scaled down
+    static constexpr float kMaxRasterScale = 4.0f;               // raster pixels per document pixel at most
+    static const size_t kRasterBudget = (size_t)128 << 20;      // bytes of raster pixels kept
+
+    // Once per frame, before the layers are redrawn: rasters those of
+    // `strokes` (the brush strokes the redraw will draw) that are new, grew
+    // or are coarser than `zoom` (screen pixels per document pixel) needs,
+    // and trims the cache. `inProgress` (may be null) is the stroke being
+    // drawn; its raster gets room to grow.
+    void Update(const std::vector<const CanvasStroke *> &strokes, float zoom, const CanvasStroke *inProgress);
+
+    // Draws a brush stroke inside BeginMode2D and BeginLayerContent: its
+    // raster when it is up to date, otherwise its dabs directly at
+    // flow * opacity.
+    void Draw(const CanvasStroke &stroke);
+
+    // Renders the stroke alone through `cam` into `target`, cleared first;
+    // the result is premultiplied, to be blended at the stroke's opacity.
+    void RenderStroke(const CanvasStroke &stroke, const Camera2D &cam, RenderTexture2D &target);
+
+    // Draws `count` dabs of `stroke` as one batch, with each dab at `alpha`
+    // times the stroke colour's alpha. Inside BeginMode2D.
+    void DrawDabs(const CanvasStroke &stroke, const BrushDab *dabs, size_t count, float alpha);
+
+    void Release();
+
+private:
+    struct Raster {
+        RenderTexture2D target{};
+        Rectangle rect{};        // document area the target covers
+        float scale = 1.0f;      // target pixels per document pixel
+        BrushDabCursor cursor;   // dabs stamped so far
+        size_t points = 0;       // stroke points they cover
+        uint64_t lastUsed = 0;
+    };
+
+    Texture2D tips[BRUSH_TIP_COUNT] = {};
+    std::unordered_map<uint64_t, Raster> rasters;  // by stroke id
+    size_t bytes = 0;
+    uint64_t tick = 0;
+    std::vector<BrushDab> dabs;  // scratch
+
+    const Texture2D &Tip(BrushTip tip);
+    void Rasterize(const CanvasStroke &stroke, bool growing, float zoom);
+    void Unload(Raster &r);
+    void Trim();
+};
@@ -0,0 +1,62 @@
+// CanvasTransform.cpp
+#include "CanvasTransform.hpp"
+#include "ImageOps.hpp"
+#include <vector>
+
+bool SwapsCanvasSides(CanvasOrientation op) {
+    return op == CANVAS_ROTATE_CW || op == CANVAS_ROTATE_CCW;
+}
+
+Vector2 OrientPoint(CanvasOrientation op, Vector2 p, int width, int height) {
+    float w = (float)width, h = (float)height;
+    switch (op) {
+        case CANVAS_ROTATE_CW: return { h - p.y, p.x };
+        case CANVAS_ROTATE_180: return { w - p.x, h - p.y };
+        case CANVAS_ROTATE_CCW: return { p.y, w - p.x };
+        case CANVAS_FLIP_HORIZONTAL: return { w - p.x, p.y };
+        case CANVAS_FLIP_VERTICAL: return { p.x, h - p.y };
+    }
+    return p;
+}
+
+std::shared_ptr<const BackgroundSnapshot> OrientBackground(const BackgroundSnapshot &src, CanvasOrientation op) {
+    const int W = src.width, H = src.height;
+    const bool swap = SwapsCanvasSides(op);
+
+    return BuildBackground(swap ? H : W, swap ? W : H, [&](const BackgroundTileEdit &t) {
+        const size_t stride = (size_t)t.width * 4;
+
+        if (!swap) {
+            bool mirrorX = op != CANVAS_FLIP_VERTICAL;
+            bool mirrorY = op != CANVAS_FLIP_HORIZONTAL;
+            int sx = mirrorX ? W - t.x0 - t.width : t.x0;
+            for (int y = 0; y < t.height; ++y) {
+                int sy = mirrorY ? H - 1 - (t.y0 + y) : t.y0 + y;
+                uint8_t *row = t.rgba + y * stride;
+                src.ReadRow(sy, sx, t.width, row);
+                if (mirrorX) ReverseRGBA(row, t.width);
+            }
+            return;
+        }
+
+        // The source block behind this tile is t.height wide and t.width
+        // tall. Its rows go in so that a plain transpose finishes the turn:
+        // clockwise stores them bottom-up, counter-clockwise mirrors each.
+        thread_local std::vector<uint8_t> block;
+        const int bw = t.height, bh = t.width;
+        const size_t bstride = (size_t)bw * 4;
+        block.resize(bstride * bh);
+        if (op == CANVAS_ROTATE_CW) {
+            int sy0 = H - t.x0 - bh;
+            for (int r = 0; r < bh; ++r) src.ReadRow(sy0 + r, t.y0, bw, block.data() + (bh - 1 - r) * bstride);
+        } else {
+            int sx0 = W - t.y0 - bw;
+            for (int r = 0; r < bh; ++r) {
+                uint8_t *row = block.data() + r * bstride;
+                src.ReadRow(t.x0 + r, sx0, bw, row);
+                ReverseRGBA(row, bw);
+            }
+        }
+        TransposeRGBA(block.data(), bstride, t.rgba, stride, bw, bh);
+    });
+}
@@ -0,0 +1,28 @@
+// CanvasTransform.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <memory>
+#include "Document.hpp"
+
+// Rotating and mirroring the whole canvas.
+//
+// Each tile of the new background is written once, straight from the
+// source: flips read mirrored rows into place and reverse them there;
+// rotations gather the source block behind the tile and transpose it in
+// cache-sized pieces. Tiles run in parallel on the job pool.
+
+enum CanvasOrientation {
+    CANVAS_ROTATE_CW = 0,    // 90 degrees clockwise
+    CANVAS_ROTATE_180,
+    CANVAS_ROTATE_CCW,       // 90 degrees counter-clockwise (270 clockwise)
+    CANVAS_FLIP_HORIZONTAL,
+    CANVAS_FLIP_VERTICAL
+};
+
+bool SwapsCanvasSides(CanvasOrientation op);
+
+// Where document point `p` of a `width` x `height` canvas ends up.
+Vector2 OrientPoint(CanvasOrientation op, Vector2 p, int width, int height);
+
+// `src` rotated or mirrored. Any thread.
+std::shared_ptr<const BackgroundSnapshot> OrientBackground(const BackgroundSnapshot &src, CanvasOrientation op);
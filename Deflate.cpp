@@ -0,0 +1,575 @@
+// Deflate.cpp
+#include "Deflate.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int kWindowSize = 32768;
+const int kWindowMask = kWindowSize - 1;
+const int kMinMatch = 3;
+const int kMaxMatch = 258;
+const int kHashBits = 15;
+const int kMaxBlockTokens = 16384;
+const int kMaxStored = 65535;
+
+const uint16_t kLengthBase[29] = {
+    3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258
+};
+const uint8_t kLengthExtra[29] = {
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+const uint16_t kDistBase[30] = {
+    1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,
+    1025,1537,2049,3073,4097,6145,8193,12289,16385,24577
+};
+const uint8_t kDistExtra[30] = {
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+const uint8_t kCodeLengthOrder[19] = {
+    16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15
+};
+
+// Search effort per level, roughly following zlib's table.
+struct LevelParams { int chain; int nice; bool lazy; };
+const LevelParams kLevels[10] = {
+    {    0,   0, false },
+    {    4,  16, false },
+    {    8,  32, false },
+    {   16,  64, false },
+    {   32, 128, true  },
+    {   48, 128, true  },
+    {  128, 258, true  },
+    {  256, 258, true  },
+    { 1024, 258, true  },
+    { 4096, 258, true  },
+};
+
+struct CodeTables {
+    uint8_t lengthCode[kMaxMatch + 1];  // match length -> index into kLengthBase
+    uint8_t distLow[256];               // (dist-1) < 256
+    uint8_t distHigh[256];              // (dist-1) >> 7
+    uint32_t crc[256];
+
+    CodeTables() {
+        for (int code = 0; code < 29; ++code) {
+            int count = 1 << kLengthExtra[code];
+            for (int i = 0; i < count && kLengthBase[code] + i <= kMaxMatch; ++i)
+                lengthCode[kLengthBase[code] + i] = (uint8_t)code;
+        }
+        lengthCode[kMaxMatch] = 28;
+
+        for (int code = 0; code < 30; ++code) {
+            int count = 1 << kDistExtra[code];
+            for (int i = 0; i < count; ++i) {
+                int d = kDistBase[code] - 1 + i;
+                if (d < 256) distLow[d] = (uint8_t)code;
+                if ((d >> 7) < 256) distHigh[d >> 7] = (uint8_t)code;
+            }
+        }
+
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc[n] = c;
+        }
+    }
+
+    int DistCode(int dist) const {
+        int d = dist - 1;
+        return (d < 256) ? distLow[d] : distHigh[d >> 7];
+    }
+};
+
+const CodeTables &Tables() {
+    static const CodeTables tables;
+    return tables;
+}
+
+struct BitWriter {
+    std::vector<uint8_t> &out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    void Put(uint32_t value, int n) {
+        bits |= (uint64_t)value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back((uint8_t)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void Align() {
+        if (count > 0) out.push_back((uint8_t)bits);
+        bits = 0;
+        count = 0;
+    }
+};
+
+// dist == 0 means `litlen` is a literal byte, otherwise it is a match length.
+struct Token { uint16_t litlen; uint16_t dist; };
+
+// Length-limited Huffman code lengths: in-place minimum-redundancy lengths
+// (Moffat & Katajainen), then overlong codes are folded back under maxBits
+// by rebalancing the Kraft sum.
+void BuildCodeLengths(const uint32_t *freq, int n, int maxBits, uint8_t *lengths) {
+    std::memset(lengths, 0, n);
+
+    struct Sym { uint32_t freq; int sym; };
+    std::vector<Sym> syms;
+    for (int i = 0; i < n; ++i)
+        if (freq[i] > 0) syms.push_back({ freq[i], i });
+
+    if (syms.empty()) return;
+    if (syms.size() == 1) {
+        lengths[syms[0].sym] = 1;
+        return;
+    }
+
+    std::sort(syms.begin(), syms.end(), [](const Sym &a, const Sym &b) {
+        return a.freq < b.freq || (a.freq == b.freq && a.sym < b.sym);
+    });
+
+    int count = (int)syms.size();
+    std::vector<uint32_t> a(count);
+    for (int i = 0; i < count; ++i) a[i] = syms[i].freq;
+
+    // phase 1: build the tree, parent pointers overwrite frequencies
+    a[0] += a[1];
+    int root = 0, leaf = 2;
+    for (int next = 1; next < count - 1; ++next) {
+        if (leaf >= count || a[root] < a[leaf]) { a[next] = a[root]; a[root++] = next; }
+        else a[next] = a[leaf++];
+        if (leaf >= count || (root < next && a[root] < a[leaf])) { a[next] += a[root]; a[root++] = next; }
+        else a[next] += a[leaf++];
+    }
+    // phase 2: internal node depths
+    a[count - 2] = 0;
+    for (int next = count - 3; next >= 0; --next) a[next] = a[a[next]] + 1;
+    // phase 3: leaf depths
+    int avail = 1, used = 0, depth = 0;
+    root = count - 2;
+    int next = count - 1;
+    while (avail > 0) {
+        while (root >= 0 && (int)a[root] == depth) { used++; root--; }
+        while (avail > used) { a[next--] = depth; avail--; }
+        avail = 2 * used;
+        depth++;
+        used = 0;
+    }
+
+    int numCodes[33] = {};
+    for (int i = 0; i < count; ++i) numCodes[std::min((int)a[i], 32)]++;
+
+    for (int i = maxBits + 1; i <= 32; ++i) {
+        numCodes[maxBits] += numCodes[i];
+        numCodes[i] = 0;
+    }
+    uint32_t total = 0;
+    for (int i = maxBits; i > 0; --i) total += (uint32_t)numCodes[i] << (maxBits - i);
+    while (total != (1u << maxBits)) {
+        numCodes[maxBits]--;
+        for (int i = maxBits - 1; i > 0; --i) {
+            if (numCodes[i]) {
+                numCodes[i]--;
+                numCodes[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // longest codes go to the rarest symbols
+    int j = 0;
+    for (int len = maxBits; len > 0; --len)
+        for (int k = 0; k < numCodes[len]; ++k) lengths[syms[j++].sym] = (uint8_t)len;
+}
+
+// Canonical codes, bit-reversed because DEFLATE emits Huffman codes MSB first.
+void BuildCodes(const uint8_t *lengths, int n, uint16_t *codes) {
+    int blCount[16] = {};
+    for (int i = 0; i < n; ++i) blCount[lengths[i]]++;
+    blCount[0] = 0;
+
+    int nextCode[16] = {};
+    int code = 0;
+    for (int bits = 1; bits < 16; ++bits) {
+        code = (code + blCount[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int len = lengths[i];
+        if (len == 0) { codes[i] = 0; continue; }
+        uint32_t c = nextCode[len]++;
+        uint32_t r = 0;
+        for (int b = 0; b < len; ++b) { r = (r << 1) | (c & 1); c >>= 1; }
+        codes[i] = (uint16_t)r;
+    }
+}
+
+struct RleSym { uint8_t sym; uint8_t extra; };
+
+// Run-length encodes the concatenated lit/len + dist code lengths (codes 16-18).
+void RunLengthEncode(const uint8_t *lens, int n, std::vector<RleSym> &out) {
+    int i = 0;
+    while (i < n) {
+        int cur = lens[i];
+        int run = 1;
+        while (i + run < n && lens[i + run] == cur) run++;
+
+        if (cur == 0) {
+            int left = run;
+            while (left >= 11) {
+                int r = std::min(left, 138);
+                out.push_back({ 18, (uint8_t)(r - 11) });
+                left -= r;
+            }
+            if (left >= 3) {
+                out.push_back({ 17, (uint8_t)(left - 3) });
+                left = 0;
+            }
+            while (left-- > 0) out.push_back({ 0, 0 });
+        } else {
+            out.push_back({ (uint8_t)cur, 0 });
+            int left = run - 1;
+            while (left >= 3) {
+                int r = std::min(left, 6);
+                out.push_back({ 16, (uint8_t)(r - 3) });
+                left -= r;
+            }
+            while (left-- > 0) out.push_back({ (uint8_t)cur, 0 });
+        }
+        i += run;
+    }
+}
+
+void WriteStored(BitWriter &bw, const uint8_t *raw, size_t len, bool final) {
+    size_t pos = 0;
+    do {
+        size_t n = std::min(len - pos, (size_t)kMaxStored);
+        bool last = final && (pos + n == len);
+        bw.Put(last ? 1 : 0, 1);
+        bw.Put(0, 2);
+        bw.Align();
+        bw.Put((uint32_t)n, 16);
+        bw.Put((uint32_t)(~n & 0xFFFF), 16);
+        bw.out.insert(bw.out.end(), raw + pos, raw + pos + n);
+        pos += n;
+    } while (pos < len);
+}
+
+void WriteTokens(BitWriter &bw, const std::vector<Token> &tokens,
+                 const uint8_t *litLen, const uint16_t *litCode,
+                 const uint8_t *distLen, const uint16_t *distCode) {
+    const CodeTables &t = Tables();
+    for (const Token &tk : tokens) {
+        if (tk.dist == 0) {
+            bw.Put(litCode[tk.litlen], litLen[tk.litlen]);
+            continue;
+        }
+        int lc = t.lengthCode[tk.litlen];
+        bw.Put(litCode[257 + lc], litLen[257 + lc]);
+        if (kLengthExtra[lc]) bw.Put(tk.litlen - kLengthBase[lc], kLengthExtra[lc]);
+
+        int dc = t.DistCode(tk.dist);
+        bw.Put(distCode[dc], distLen[dc]);
+        if (kDistExtra[dc]) bw.Put(tk.dist - kDistBase[dc], kDistExtra[dc]);
+    }
+    bw.Put(litCode[256], litLen[256]);
+}
+
+// Emits one block as dynamic, fixed or stored, whichever is smallest.
+void WriteBlock(BitWriter &bw, const std::vector<Token> &tokens,
+                const uint8_t *raw, size_t rawLen, bool final) {
+    const CodeTables &t = Tables();
+
+    uint32_t litFreq[286] = {};
+    uint32_t distFreq[30] = {};
+    for (const Token &tk : tokens) {
+        if (tk.dist == 0) {
+            litFreq[tk.litlen]++;
+        } else {
+            litFreq[257 + t.lengthCode[tk.litlen]]++;
+            distFreq[t.DistCode(tk.dist)]++;
+        }
+    }
+    litFreq[256] = 1;
+
+    // dynamic tables
+    uint8_t litLen[286], distLen[30];
+    BuildCodeLengths(litFreq, 286, 15, litLen);
+    BuildCodeLengths(distFreq, 30, 15, distLen);
+    if (std::all_of(distLen, distLen + 30, [](uint8_t l) { return l == 0; })) {
+        distLen[0] = 1;
+        distLen[1] = 1;
+    }
+
+    int numLit = 286;
+    while (numLit > 257 && litLen[numLit - 1] == 0) numLit--;
+    int numDist = 30;
+    while (numDist > 1 && distLen[numDist - 1] == 0) numDist--;
+
+    uint8_t allLens[286 + 30];
+    std::memcpy(allLens, litLen, numLit);
+    std::memcpy(allLens + numLit, distLen, numDist);
+    std::vector<RleSym> rle;
+    RunLengthEncode(allLens, numLit + numDist, rle);
+
+    uint32_t clFreq[19] = {};
+    for (const RleSym &r : rle) clFreq[r.sym]++;
+    uint8_t clLen[19];
+    BuildCodeLengths(clFreq, 19, 7, clLen);
+    int numCl = 19;
+    while (numCl > 4 && clLen[kCodeLengthOrder[numCl - 1]] == 0) numCl--;
+
+    // bit costs of the three encodings
+    uint64_t payloadDyn = 0, payloadFixed = 0;
+    for (int i = 0; i < 286; ++i) {
+        uint32_t extra = (i >= 257) ? kLengthExtra[i - 257] : 0;
+        uint32_t fixedLen = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+        payloadDyn += (uint64_t)litFreq[i] * (litLen[i] + extra);
+        payloadFixed += (uint64_t)litFreq[i] * (fixedLen + extra);
+    }
+    for (int i = 0; i < 30; ++i) {
+        payloadDyn += (uint64_t)distFreq[i] * (distLen[i] + kDistExtra[i]);
+        payloadFixed += (uint64_t)distFreq[i] * (5 + kDistExtra[i]);
+    }
+    uint64_t headerDyn = 3 + 5 + 5 + 4 + 3 * (uint64_t)numCl;
+    for (const RleSym &r : rle)
+        headerDyn += clLen[r.sym] + (r.sym == 16 ? 2 : r.sym == 17 ? 3 : r.sym == 18 ? 7 : 0);
+
+    uint64_t costDyn = headerDyn + payloadDyn;
+    uint64_t costFixed = 3 + payloadFixed;
+    uint64_t costStored = (rawLen / kMaxStored + 1) * (3 + 7 + 32) + (uint64_t)rawLen * 8;
+
+    if (raw && costStored <= costDyn && costStored <= costFixed) {
+        WriteStored(bw, raw, rawLen, final);
+        return;
+    }
+
+    if (costFixed <= costDyn) {
+        uint8_t fLit[288], fDist[30];
+        for (int i = 0; i < 288; ++i) fLit[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+        for (int i = 0; i < 30; ++i) fDist[i] = 5;
+        uint16_t fLitCode[288], fDistCode[30];
+        BuildCodes(fLit, 288, fLitCode);
+        BuildCodes(fDist, 30, fDistCode);
+
+        bw.Put(final ? 1 : 0, 1);
+        bw.Put(1, 2);
+        WriteTokens(bw, tokens, fLit, fLitCode, fDist, fDistCode);
+        return;
+    }
+
+    uint16_t litCode[286], distCode[30], clCode[19];
+    BuildCodes(litLen, 286, litCode);
+    BuildCodes(distLen, 30, distCode);
+    BuildCodes(clLen, 19, clCode);
+
+    bw.Put(final ? 1 : 0, 1);
+    bw.Put(2, 2);
+    bw.Put(numLit - 257, 5);
+    bw.Put(numDist - 1, 5);
+    bw.Put(numCl - 4, 4);
+    for (int i = 0; i < numCl; ++i) bw.Put(clLen[kCodeLengthOrder[i]], 3);
+    for (const RleSym &r : rle) {
+        bw.Put(clCode[r.sym], clLen[r.sym]);
+        if (r.sym == 16) bw.Put(r.extra, 2);
+        else if (r.sym == 17) bw.Put(r.extra, 3);
+        else if (r.sym == 18) bw.Put(r.extra, 7);
+    }
+    WriteTokens(bw, tokens, litLen, litCode, distLen, distCode);
+}
+
+inline uint32_t Hash3(const uint8_t *p) {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// Compares 8 bytes at a time (little-endian targets only).
+inline int MatchLength(const uint8_t *a, const uint8_t *b, int maxLen) {
+    int n = 0;
+    while (n + 8 <= maxLen) {
+        uint64_t x, y;
+        std::memcpy(&x, a + n, 8);
+        std::memcpy(&y, b + n, 8);
+        uint64_t d = x ^ y;
+        if (d) return n + (__builtin_ctzll(d) >> 3);
+        n += 8;
+    }
+    while (n < maxLen && a[n] == b[n]) n++;
+    return n;
+}
+
+struct Matcher {
+    const uint8_t *data;
+    size_t total;
+    LevelParams params;
+    std::vector<int32_t> head;
+    std::vector<int32_t> prev;
+
+    Matcher(const uint8_t *d, size_t n, const LevelParams &p)
+        : data(d), total(n), params(p), head((size_t)1 << kHashBits, -1), prev(kWindowSize, -1) {}
+
+    void Insert(size_t pos) {
+        if (pos + kMinMatch > total) return;
+        uint32_t h = Hash3(data + pos);
+        prev[pos & kWindowMask] = head[h];
+        head[h] = (int32_t)pos;
+    }
+
+    // Longest match for `pos` among positions already inserted.
+    int Find(size_t pos, int &dist) const {
+        int maxLen = (int)std::min((size_t)kMaxMatch, total - pos);
+        if (maxLen < kMinMatch) return 0;
+
+        int64_t limit = (int64_t)pos - kWindowSize;
+        int32_t cand = head[Hash3(data + pos)];
+        int best = 0;
+        int chain = params.chain;
+        while (cand >= 0 && cand > limit && chain-- > 0) {
+            const uint8_t *c = data + cand;
+            if (c[best] == data[pos + best] || best == 0) {
+                int len = MatchLength(c, data + pos, maxLen);
+                if (len > best) {
+                    best = len;
+                    dist = (int)(pos - cand);
+                    if (len >= params.nice || len == maxLen) break;
+                }
+            }
+            cand = prev[cand & kWindowMask];
+        }
+        return (best >= kMinMatch) ? best : 0;
+    }
+};
+
+} // namespace
+
+void DeflateSegment(const uint8_t *data, size_t dictLen, size_t len,
+                    int level, bool final, std::vector<uint8_t> &out) {
+    level = std::clamp(level, 0, 9);
+    BitWriter bw{ out };
+    const uint8_t *seg = data + dictLen;
+
+    if (level == 0) {
+        if (len > 0 || final) WriteStored(bw, seg, len, final);
+    } else {
+        const LevelParams &lp = kLevels[level];
+        size_t total = dictLen + len;
+        Matcher m(data, total, lp);
+
+        size_t dictStart = (dictLen > (size_t)kWindowSize) ? dictLen - kWindowSize : 0;
+        for (size_t p = dictStart; p < dictLen; ++p) m.Insert(p);
+
+        std::vector<Token> tokens;
+        tokens.reserve(kMaxBlockTokens + 2);
+
+        size_t pos = dictLen;
+        size_t blockStart = dictLen;
+        bool havePending = false;
+        int pendingLen = 0, pendingDist = 0;
+
+        while (pos < total) {
+            if ((int)tokens.size() >= kMaxBlockTokens) {
+                WriteBlock(bw, tokens, data + blockStart, pos - blockStart, false);
+                tokens.clear();
+                blockStart = pos;
+            }
+
+            int dist = 0;
+            int mlen;
+            if (havePending) {
+                mlen = pendingLen;
+                dist = pendingDist;
+                havePending = false;
+            } else {
+                mlen = m.Find(pos, dist);
+                m.Insert(pos);
+            }
+
+            if (mlen && lp.lazy && mlen < lp.nice && pos + 1 < total) {
+                int dist2 = 0;
+                int mlen2 = m.Find(pos + 1, dist2);
+                m.Insert(pos + 1);
+                if (mlen2 > mlen) {
+                    tokens.push_back({ data[pos], 0 });
+                    pos++;
+                    havePending = true;
+                    pendingLen = mlen2;
+                    pendingDist = dist2;
+                    continue;
+                }
+                tokens.push_back({ (uint16_t)mlen, (uint16_t)dist });
+                for (size_t p = pos + 2; p < pos + mlen; ++p) m.Insert(p);
+                pos += mlen;
+                continue;
+            }
+
+            if (mlen) {
+                tokens.push_back({ (uint16_t)mlen, (uint16_t)dist });
+                // fast levels skip hashing inside long matches
+                if (lp.lazy || mlen <= 16)
+                    for (size_t p = pos + 1; p < pos + mlen; ++p) m.Insert(p);
+                pos += mlen;
+            } else {
+                tokens.push_back({ data[pos], 0 });
+                pos++;
+            }
+        }
+
+        if (!tokens.empty() || final)
+            WriteBlock(bw, tokens, data + blockStart, pos - blockStart, final);
+    }
+
+    if (!final) {
+        // sync flush: empty stored block, leaves the stream byte-aligned
+        bw.Put(0, 3);
+        bw.Align();
+        bw.Put(0x0000, 16);
+        bw.Put(0xFFFF, 16);
+    }
+    bw.Align();
+}
+
+uint32_t Adler32(uint32_t adler, const uint8_t *data, size_t len) {
+    const uint32_t kBase = 65521;
+    const size_t kNMax = 5552;
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (len > 0) {
+        size_t n = std::min(len, kNMax);
+        len -= n;
+        for (size_t i = 0; i < n; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += n;
+        a %= kBase;
+        b %= kBase;
+    }
+    return a | (b << 16);
+}
+
+uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t lenB) {
+    const uint32_t kBase = 65521;
+    uint32_t rem = (uint32_t)(lenB % kBase);
+    uint32_t sum1 = adlerA & 0xFFFF;
+    uint32_t sum2 = (rem * sum1) % kBase;
+    sum1 += (adlerB & 0xFFFF) + kBase - 1;
+    sum2 += (adlerA >> 16) + (adlerB >> 16) + kBase - rem;
+    if (sum1 >= kBase) sum1 -= kBase;
+    if (sum1 >= kBase) sum1 -= kBase;
+    if (sum2 >= (kBase << 1)) sum2 -= (kBase << 1);
+    if (sum2 >= kBase) sum2 -= kBase;
+    return sum1 | (sum2 << 16);
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t len) {
+    const CodeTables &t = Tables();
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) crc = t.crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
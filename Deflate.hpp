@@ -0,0 +1,24 @@
+// Deflate.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Raw DEFLATE (RFC 1951) encoder used by the PNG writer.
+//
+// Each call compresses one independent segment, so callers can deflate
+// segments on different threads and concatenate the outputs (pigz style).
+// `data` points at `dictLen` bytes of preset dictionary followed by the `len`
+// bytes to compress; matches may reach back into the dictionary. A non-final
+// segment ends with an empty stored block so the output is byte-aligned and
+// the next segment can be appended directly.
+//
+// level: 0 = stored only, 1 = fastest ... 9 = smallest.
+void DeflateSegment(const uint8_t *data, size_t dictLen, size_t len,
+                    int level, bool final, std::vector<uint8_t> &out);
+
+uint32_t Adler32(uint32_t adler, const uint8_t *data, size_t len);
+// Adler-32 of A followed by B, given adler(A), adler(B) and len(B).
+uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t lenB);
+
+uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t len);
@@ -0,0 +1,145 @@
+// Dialogs.cpp
+#include "Dialogs.hpp"
+#include "tinyfiledialogs.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct DialogRequest {
+    std::function<DialogResult()> show;
+    DialogCallback done;
+    bool report = false;  // a message box nothing waits on; still shown on exit
+};
+
+struct DialogQueue {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<DialogRequest> pending;
+    std::deque<std::pair<DialogResult, DialogCallback>> finished;
+    int outstanding = 0;    // queued + showing + finished but not yet polled
+    bool showing = false;
+    bool quit = false;
+    std::thread worker;
+};
+
+// Never freed: an abandoned dialog thread may still touch it during exit.
+static DialogQueue *g_Dialogs = new DialogQueue;
+
+static void DialogThread(DialogQueue *q) {
+    std::unique_lock<std::mutex> lock(q->mutex);
+    for (;;) {
+        q->wake.wait(lock, [q] { return q->quit || !q->pending.empty(); });
+        if (q->pending.empty()) return;  // quit, with every report shown
+
+        DialogRequest req = std::move(q->pending.front());
+        q->pending.pop_front();
+        q->showing = true;
+        lock.unlock();
+
+        // tinyfd keeps its results in static buffers, so dialogs must never
+        // overlap; running them all on this one thread guarantees that.
+        DialogResult result = req.show();
+
+        lock.lock();
+        q->showing = false;
+        q->finished.emplace_back(std::move(result), std::move(req.done));
+    }
+}
+
+static void Queue(std::function<DialogResult()> show, DialogCallback done, bool report = false) {
+    std::lock_guard<std::mutex> lock(g_Dialogs->mutex);
+    if (!g_Dialogs->worker.joinable()) g_Dialogs->worker = std::thread(DialogThread, g_Dialogs);
+    g_Dialogs->pending.push_back({ std::move(show), std::move(done), report });
+    ++g_Dialogs->outstanding;
+    g_Dialogs->wake.notify_one();
+}
+
+static DialogResult FromString(const char *s) {
+    DialogResult r;
+    r.ok = (s != nullptr);
+    r.button = r.ok ? 1 : 0;
+    if (s) r.text = s;
+    return r;
+}
+
+void MessageBoxAsync(const std::string &title, const std::string &message,
+                     const std::string &dialogType, const std::string &iconType,
+                     int defaultButton, DialogCallback done) {
+    const bool report = !done;
+    Queue([=] {
+        DialogResult r;
+        r.button = tinyfd_messageBox(title.c_str(), message.c_str(), dialogType.c_str(),
+                                     iconType.c_str(), defaultButton);
+        r.ok = (r.button != 0);
+        return r;
+    }, std::move(done), report);
+}
+
+void SaveFileDialogAsync(const std::string &title, const std::string &defaultPath,
+                         const std::vector<std::string> &patterns, const std::string &description,
+                         DialogCallback done) {
+    Queue([=] {
+        std::vector<const char *> pp;
+        for (const auto &p : patterns) pp.push_back(p.c_str());
+        return FromString(tinyfd_saveFileDialog(title.c_str(), defaultPath.c_str(), (int)pp.size(),
+                                                pp.data(), description.c_str()));
+    }, std::move(done));
+}
+
+void OpenFileDialogAsync(const std::string &title, const std::string &defaultPath,
+                         const std::vector<std::string> &patterns, const std::string &description,
+                         DialogCallback done) {
+    Queue([=] {
+        std::vector<const char *> pp;
+        for (const auto &p : patterns) pp.push_back(p.c_str());
+        return FromString(tinyfd_openFileDialog(title.c_str(), defaultPath.c_str(), (int)pp.size(),
+                                                pp.data(), description.c_str(), 0));
+    }, std::move(done));
+}
+
+void InputBoxAsync(const std::string &title, const std::string &message,
+                   const std::string &defaultInput, DialogCallback done) {
+    Queue([=] {
+        return FromString(tinyfd_inputBox(title.c_str(), message.c_str(), defaultInput.c_str()));
+    }, std::move(done));
+}
+
+void PollDialogs() {
+    std::deque<std::pair<DialogResult, DialogCallback>> ready;
+    {
+        std::lock_guard<std::mutex> lock(g_Dialogs->mutex);
+        ready.swap(g_Dialogs->finished);
+    }
+    // callbacks may queue follow-up dialogs, so run them unlocked and only
+    // then count them as delivered
+    for (auto &f : ready) {
+        if (f.second) f.second(f.first);
+        std::lock_guard<std::mutex> lock(g_Dialogs->mutex);
+        --g_Dialogs->outstanding;
+    }
+}
+
+bool DialogsBusy() {
+    std::lock_guard<std::mutex> lock(g_Dialogs->mutex);
+    return g_Dialogs->outstanding > 0;
+}
+
+void ShutdownDialogs() {
+    bool showing, reports;
+    {
+        std::lock_guard<std::mutex> lock(g_Dialogs->mutex);
+        g_Dialogs->quit = true;
+        auto &pending = g_Dialogs->pending;
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [](const DialogRequest &r) { return !r.report; }),
+                      pending.end());
+        showing = g_Dialogs->showing;
+        reports = !pending.empty();
+    }
+    g_Dialogs->wake.notify_one();
+    if (!g_Dialogs->worker.joinable()) return;
+    // an error the user has not seen yet is worth waiting for
+    if (showing && !reports) g_Dialogs->worker.detach();
+    else g_Dialogs->worker.join();
+}
@@ -0,0 +1,42 @@
+// Dialogs.hpp
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+// Non-blocking wrappers around tinyfiledialogs. Each call queues the dialog
+// on a dedicated dialog thread (one dialog at a time, in call order) and
+// returns immediately; the result is delivered to `done` on the main thread
+// from PollDialogs(), so the render loop keeps running while a dialog is up.
+
+struct DialogResult {
+    int button = 0;     // message box: 0 = cancel/no, 1 = ok/yes, 2 = no in yesnocancel
+    bool ok = false;    // file/input dialogs: false when cancelled
+    std::string text;   // chosen path or entered text
+};
+
+using DialogCallback = std::function<void(const DialogResult &)>;
+
+void MessageBoxAsync(const std::string &title, const std::string &message,
+                     const std::string &dialogType, const std::string &iconType,
+                     int defaultButton, DialogCallback done = nullptr);
+void SaveFileDialogAsync(const std::string &title, const std::string &defaultPath,
+                         const std::vector<std::string> &patterns, const std::string &description,
+                         DialogCallback done);
+void OpenFileDialogAsync(const std::string &title, const std::string &defaultPath,
+                         const std::vector<std::string> &patterns, const std::string &description,
+                         DialogCallback done);
+void InputBoxAsync(const std::string &title, const std::string &message,
+                   const std::string &defaultInput, DialogCallback done);
+
+// Runs the callbacks of finished dialogs. Call once per frame.
+void PollDialogs();
+
+// True while a dialog is queued, showing, or waiting for its callback.
+bool DialogsBusy();
+
+// Stops the dialog thread on exit. Queued message boxes without a callback
+// (error reports) are still shown, one after the other, and waited for;
+// other queued dialogs are dropped, and one that is still showing is
+// abandoned unless reports wait behind it.
+void ShutdownDialogs();
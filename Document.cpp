@@ -0,0 +1,308 @@
+// Document.cpp
+#include "Document.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+uint64_t NewStrokeId() {
+    static std::atomic<uint64_t> next{1};
+    return next++;
+}
+
+uint64_t NewLayerId() {
+    static uint64_t next = 1;
+    return next++;
+}
+
+namespace {
+
+using Tile = BackgroundSnapshot::Tile;
+const int kTile = BackgroundSnapshot::kTileSize;
+
+// Read with std::atomic_load from any thread, replaced with std::atomic_store.
+DocumentSnapshotRef g_Published = std::make_shared<DocumentSnapshot>();
+
+// main thread bookkeeping
+DocumentSnapshotRef g_Last = g_Published;
+
+// Live background. Tiles are handed out to snapshots as they are; a tile is
+// written in place only while nothing else holds it (use_count() == 1, which
+// no other thread can raise since they only ever see snapshot copies).
+struct LiveBackground {
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    uint64_t imageId = 0;
+    std::vector<std::shared_ptr<Tile>> tiles;
+};
+
+LiveBackground g_Live;
+std::shared_ptr<const BackgroundSnapshot> g_LiveSnapshot;  // matches g_Live unless g_BgChanged
+bool g_BgChanged = false;
+
+std::shared_ptr<const Tile> CopyTile(const Image &img, int tx, int ty) {
+    int x0 = tx * kTile, y0 = ty * kTile;
+    int w = std::min(kTile, img.width - x0);
+    int h = std::min(kTile, img.height - y0);
+    auto tile = std::make_shared<Tile>();
+    tile->rgba.resize((size_t)w * h * 4);
+    const uint8_t *src = (const uint8_t *)img.data;
+    for (int y = 0; y < h; ++y)
+        memcpy(tile->rgba.data() + (size_t)y * w * 4, src + ((size_t)(y0 + y) * img.width + x0) * 4, (size_t)w * 4);
+    return tile;
+}
+
+std::shared_ptr<BackgroundSnapshot> NewBackground(int width, int height) {
+    static std::atomic<uint64_t> nextImageId{1};
+    auto bg = std::make_shared<BackgroundSnapshot>();
+    bg->width = width;
+    bg->height = height;
+    bg->imageId = nextImageId++;
+    bg->tilesX = (width + kTile - 1) / kTile;
+    bg->tilesY = (height + kTile - 1) / kTile;
+    bg->tiles.resize((size_t)bg->tilesX * bg->tilesY);
+    return bg;
+}
+
+bool SameStroke(const CanvasStroke &a, const CanvasStroke &b) {
+    return a.id == b.id && a.points.size() == b.points.size() && a.erased == b.erased;
+}
+
+// Snapshot strokes of `strokes`, sharing every stroke `prev` already has;
+// usually only the stroke being drawn is new, and it is normally at the
+// same index.
+std::vector<std::shared_ptr<const CanvasStroke>> ShareStrokes(const std::vector<CanvasStroke> &strokes,
+                                                              const LayerSnapshot *prev) {
+    static const std::vector<std::shared_ptr<const CanvasStroke>> kNone;
+    const auto &old = prev ? prev->strokes : kNone;
+
+    std::unordered_map<uint64_t, size_t> byId;
+    std::vector<std::shared_ptr<const CanvasStroke>> out;
+    out.reserve(strokes.size());
+    for (size_t i = 0; i < strokes.size(); ++i) {
+        const CanvasStroke &s = strokes[i];
+        size_t match = SIZE_MAX;
+        if (i < old.size() && SameStroke(*old[i], s)) {
+            match = i;
+        } else {
+            if (byId.empty())
+                for (size_t k = 0; k < old.size(); ++k) byId[old[k]->id] = k;
+            auto it = byId.find(s.id);
+            if (it != byId.end() && SameStroke(*old[it->second], s)) match = it->second;
+        }
+        out.push_back(match != SIZE_MAX ? old[match] : std::make_shared<const CanvasStroke>(s));
+    }
+    return out;
+}
+
+} // namespace
+
+void BackgroundSnapshot::ReadRow(int y, int x0, int count, uint8_t *dst) const {
+    int ty = y / kTile, ry = y - ty * kTile;
+    while (count > 0) {
+        int tx = x0 / kTile, rx = x0 - tx * kTile;
+        int tw = std::min(kTile, width - tx * kTile);
+        int n = std::min(count, tw - rx);
+        const Tile &tile = *tiles[(size_t)ty * tilesX + tx];
+        memcpy(dst, tile.rgba.data() + ((size_t)ry * tw + rx) * 4, (size_t)n * 4);
+        dst += (size_t)n * 4;
+        x0 += n;
+        count -= n;
+    }
+}
+
+DocumentSnapshotRef AcquireDocument() {
+    return std::atomic_load(&g_Published);
+}
+
+std::shared_ptr<const BackgroundSnapshot> TileBackground(const Image &img) {
+    if (img.data == nullptr || img.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) return nullptr;
+
+    auto bg = NewBackground(img.width, img.height);
+    ParallelFor("tile background", (int)bg->tiles.size(), 16, [&](int t0, int t1) {
+        for (int t = t0; t < t1; ++t) bg->tiles[t] = CopyTile(img, t % bg->tilesX, t / bg->tilesX);
+    });
+    return bg;
+}
+
+std::shared_ptr<const BackgroundSnapshot> BuildBackground(int width, int height,
+                                                          const std::function<void(const BackgroundTileEdit &)> &fill) {
+    if (width <= 0 || height <= 0) return nullptr;
+
+    auto bg = NewBackground(width, height);
+    ParallelFor("build background", (int)bg->tiles.size(), 2, [&](int t0, int t1) {
+        for (int t = t0; t < t1; ++t) {
+            BackgroundTileEdit e;
+            e.x0 = (t % bg->tilesX) * kTile;
+            e.y0 = (t / bg->tilesX) * kTile;
+            e.width = std::min(kTile, width - e.x0);
+            e.height = std::min(kTile, height - e.y0);
+            auto tile = std::make_shared<Tile>();
+            tile->rgba.resize((size_t)e.width * e.height * 4);
+            e.rgba = tile->rgba.data();
+            fill(e);
+            bg->tiles[t] = std::move(tile);
+        }
+    });
+    return bg;
+}
+
+std::shared_ptr<const BackgroundSnapshot> RebuildBackground(const BackgroundSnapshot &src,
+                                                            const std::function<bool(int tx, int ty)> &keep,
+                                                            const std::function<void(const BackgroundTileEdit &)> &fill) {
+    if (src.width <= 0 || src.height <= 0) return nullptr;
+
+    auto bg = NewBackground(src.width, src.height);
+    ParallelFor("rebuild background", (int)bg->tiles.size(), 2, [&](int t0, int t1) {
+        for (int t = t0; t < t1; ++t) {
+            int tx = t % bg->tilesX, ty = t / bg->tilesX;
+            if (keep(tx, ty)) {
+                bg->tiles[t] = src.tiles[t];
+                continue;
+            }
+            BackgroundTileEdit e;
+            e.x0 = tx * kTile;
+            e.y0 = ty * kTile;
+            e.width = std::min(kTile, src.width - e.x0);
+            e.height = std::min(kTile, src.height - e.y0);
+            auto tile = std::make_shared<Tile>();
+            tile->rgba.resize((size_t)e.width * e.height * 4);
+            e.rgba = tile->rgba.data();
+            fill(e);
+            bg->tiles[t] = std::move(tile);
+        }
+    });
+    return bg;
+}
+
+void SetBackground(std::shared_ptr<const BackgroundSnapshot> bg) {
+    g_Live = {};
+    if (bg) {
+        g_Live.width = bg->width;
+        g_Live.height = bg->height;
+        g_Live.tilesX = bg->tilesX;
+        g_Live.tilesY = bg->tilesY;
+        g_Live.imageId = bg->imageId;
+        g_Live.tiles.reserve(bg->tiles.size());
+        // shared with `bg`, so the first write to each one copies it
+        for (const auto &t : bg->tiles) g_Live.tiles.push_back(std::const_pointer_cast<Tile>(t));
+    }
+    g_LiveSnapshot = std::move(bg);
+    g_BgChanged = false;
+}
+
+bool HasBackground() {
+    return !g_Live.tiles.empty();
+}
+
+int BackgroundWidth() {
+    return g_Live.width;
+}
+
+int BackgroundHeight() {
+    return g_Live.height;
+}
+
+Color GetBackgroundPixel(int x, int y) {
+    if (x < 0 || y < 0 || x >= g_Live.width || y >= g_Live.height) return BLANK;
+    int tx = x / kTile, ty = y / kTile;
+    int tw = std::min(kTile, g_Live.width - tx * kTile);
+    const uint8_t *p = g_Live.tiles[(size_t)ty * g_Live.tilesX + tx]->rgba.data() +
+                       ((size_t)(y - ty * kTile) * tw + (x - tx * kTile)) * 4;
+    return Color{ p[0], p[1], p[2], p[3] };
+}
+
+void EditBackground(int x0, int y0, int x1, int y1, const std::function<void(const BackgroundTileEdit &)> &edit,
+                    const std::function<bool(int tx, int ty)> &skip) {
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(g_Live.width, x1);
+    y1 = std::min(g_Live.height, y1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    int tx0 = x0 / kTile, tx1 = (x1 - 1) / kTile;
+    int ty0 = y0 / kTile, ty1 = (y1 - 1) / kTile;
+    int cols = tx1 - tx0 + 1;
+    ParallelFor("edit background", cols * (ty1 - ty0 + 1), 2, [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            int tx = tx0 + i % cols, ty = ty0 + i / cols;
+            if (skip && skip(tx, ty)) continue;
+            std::shared_ptr<Tile> &tile = g_Live.tiles[(size_t)ty * g_Live.tilesX + tx];
+            if (tile.use_count() > 1) tile = std::make_shared<Tile>(*tile);
+
+            BackgroundTileEdit e;
+            e.x0 = tx * kTile;
+            e.y0 = ty * kTile;
+            e.width = std::min(kTile, g_Live.width - e.x0);
+            e.height = std::min(kTile, g_Live.height - e.y0);
+            e.rgba = tile->rgba.data();
+            edit(e);
+        }
+    });
+    g_BgChanged = true;
+}
+
+DocumentSnapshotRef PublishDocument(uint64_t version, const std::vector<Layer> &layers,
+                                    int canvasW, int canvasH) {
+    const DocumentSnapshot &prev = *g_Last;
+    if (prev.version == version && !g_BgChanged && prev.background == g_LiveSnapshot &&
+        prev.canvasW == canvasW && prev.canvasH == canvasH && prev.layers.size() == layers.size())
+        return g_Last;
+
+    auto snap = std::make_shared<DocumentSnapshot>();
+    snap->version = version;
+    snap->canvasW = canvasW;
+    snap->canvasH = canvasH;
+
+    snap->layers.reserve(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const Layer &layer = layers[i];
+        const LayerSnapshot *old = nullptr;
+        if (i < prev.layers.size() && prev.layers[i].id == layer.id) old = &prev.layers[i];
+        for (size_t k = 0; !old && k < prev.layers.size(); ++k)
+            if (prev.layers[k].id == layer.id) old = &prev.layers[k];
+
+        LayerSnapshot ls;
+        static_cast<LayerProps &>(ls) = layer;
+        ls.strokes = ShareStrokes(layer.strokes, old);
+        snap->layers.push_back(std::move(ls));
+    }
+
+    if (g_BgChanged) {
+        // tiles are shared as they are; edits copy them before writing
+        auto bg = std::make_shared<BackgroundSnapshot>();
+        bg->width = g_Live.width;
+        bg->height = g_Live.height;
+        bg->tilesX = g_Live.tilesX;
+        bg->tilesY = g_Live.tilesY;
+        bg->imageId = g_Live.imageId;
+        bg->tiles.assign(g_Live.tiles.begin(), g_Live.tiles.end());
+        g_LiveSnapshot = std::move(bg);
+        g_BgChanged = false;
+    }
+    snap->background = g_LiveSnapshot;
+
+    g_Last = snap;
+    std::atomic_store(&g_Published, g_Last);
+    return g_Last;
+}
+
+Image BackgroundToImage(const BackgroundSnapshot &bg) {
+    Image img = {};
+    img.width = bg.width;
+    img.height = bg.height;
+    img.mipmaps = 1;
+    img.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+    img.data = malloc((size_t)bg.width * bg.height * 4);
+    if (!img.data) return {};
+
+    uint8_t *dst = (uint8_t *)img.data;
+    ParallelFor("restore background", bg.height, 64, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) bg.ReadRow(y, 0, bg.width, dst + (size_t)y * bg.width * 4);
+    });
+    return img;
+}
@@ -0,0 +1,131 @@
+// Document.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tools/CanvasStroke.hpp"
+
+// Immutable read snapshots of the document for background threads.
+//
+// The tools keep editing the live layers and background on the main thread. Once per frame, if anything changed, the main thread publishes a
+// new DocumentSnapshot (RCU style): strokes that did not change are shared
+// with the previous snapshot, and the background tiles are always shared
+// (see EditBackground), so publishing only copies the stroke being drawn.
+// Readers on any thread take the latest snapshot with AcquireDocument() and
+// keep it alive as long as they need; it never changes underneath them.
+
+// Background pixels split into square tiles, RGBA8, top-down.
+struct BackgroundSnapshot {
+    static const int kTileSize = 256;
+
+    struct Tile {
+        std::vector<uint8_t> rgba;  // tile width * tile height * 4
+    };
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<std::shared_ptr<const Tile>> tiles;  // row-major
+    uint64_t imageId = 0;  // kept by edits, new for every image tiled by TileBackground
+
+    // Copies `count` pixels of row `y` starting at column `x0` into `dst` (RGBA8).
+    void ReadRow(int y, int x0, int count, uint8_t *dst) const;
+};
+
+enum LayerBlend {
+    LAYER_BLEND_NORMAL = 0,
+    LAYER_BLEND_MULTIPLY,
+    LAYER_BLEND_SCREEN,
+    LAYER_BLEND_ADD,
+    LAYER_BLEND_COUNT
+};
+
+uint64_t NewLayerId();
+
+// How a layer is shown; shared by the live layers and their snapshots.
+struct LayerProps {
+    uint64_t id = 0;
+    std::string name;
+    bool visible = true;
+    float opacity = 1.0f;
+    LayerBlend blend = LAYER_BLEND_NORMAL;
+};
+
+// A live layer (main thread). Layers draw bottom (index 0) to top; the
+// bottom layer also owns the background image, when there is one.
+struct Layer : LayerProps {
+    std::vector<CanvasStroke> strokes;
+    uint64_t version = 0;         // document version of its last content change
+    uint64_t strokesVersion = 0;  // document version of its last stroke edit
+};
+
+struct LayerSnapshot : LayerProps {
+    std::vector<std::shared_ptr<const CanvasStroke>> strokes;
+};
+
+struct DocumentSnapshot {
+    uint64_t version = 0;       // g_DocumentVersion it was published at
+    int canvasW = 0;
+    int canvasH = 0;
+    std::vector<LayerSnapshot> layers;                     // bottom first
+    std::shared_ptr<const BackgroundSnapshot> background;  // of layers[0]; null without a background image
+};
+
+using DocumentSnapshotRef = std::shared_ptr<const DocumentSnapshot>;
+
+// Any thread: the most recently published snapshot (never null).
+DocumentSnapshotRef AcquireDocument();
+
+// Writable pixels of one background tile; (x0, y0) is its top-left in the image.
+struct BackgroundTileEdit {
+    int x0, y0;
+    int width, height;
+    uint8_t *rgba;  // width * height * 4
+};
+
+// Splits an RGBA8 image into a new background. Any thread.
+std::shared_ptr<const BackgroundSnapshot> TileBackground(const Image &img);
+
+// New `width` x `height` background whose tiles are written by `fill`, in
+// parallel. Any thread; used by whole-canvas operations that compute each
+// output tile from the old background.
+std::shared_ptr<const BackgroundSnapshot> BuildBackground(int width, int height,
+                                                          const std::function<void(const BackgroundTileEdit &)> &fill);
+
+// New background the size of `src` whose tiles are shared with `src` where
+// `keep(tx, ty)` is true and written by `fill`, in parallel, elsewhere.
+std::shared_ptr<const BackgroundSnapshot> RebuildBackground(const BackgroundSnapshot &src,
+                                                            const std::function<bool(int tx, int ty)> &keep,
+                                                            const std::function<void(const BackgroundTileEdit &)> &fill);
+
+// New RGBA8 image with the snapshot's pixels (caller unloads it).
+Image BackgroundToImage(const BackgroundSnapshot &bg);
+
+// --- Main thread only ---
+
+// The live background is a grid of the same tiles the snapshots hold. A tile
+// still shared with a snapshot is copied before it is written, so undo
+// states keep every tile that was not painted since.
+
+// Replaces the live background (null removes it).
+void SetBackground(std::shared_ptr<const BackgroundSnapshot> bg);
+bool HasBackground();
+int BackgroundWidth();
+int BackgroundHeight();
+// Pixel at (x, y); BLANK outside the background.
+Color GetBackgroundPixel(int x, int y);
+
+// Calls `edit` for every tile overlapping [x0, x1) x [y0, y1), in parallel
+// when there are several. Tiles for which `skip(tx, ty)` is true are left as
+// they are, not even copied.
+void EditBackground(int x0, int y0, int x1, int y1, const std::function<void(const BackgroundTileEdit &)> &edit,
+                    const std::function<bool(int tx, int ty)> &skip = nullptr);
+
+// Publishes the live state if it differs from the last snapshot and returns
+// the current snapshot.
+DocumentSnapshotRef PublishDocument(uint64_t version, const std::vector<Layer> &layers,
+                                    int canvasW, int canvasH);
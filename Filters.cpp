@@ -0,0 +1,319 @@
+// Filters.cpp
+#include "Filters.hpp"
+#include "ImageOps.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int kBand = 64;  // rows blurred and transposed together
+
+// Radii of the box passes for `p`; returns how many there are.
+int BoxRadii(const FilterParams &p, int radii[3]) {
+    if (p.kind == FILTER_BOX_BLUR) {
+        radii[0] = std::max(0, (int)roundf(p.radius));
+        return radii[0] > 0 ? 1 : 0;
+    }
+
+    // three boxes whose combined variance matches the Gaussian's
+    float sigma = std::max(0.0f, p.radius);
+    if (sigma < 0.5f) return 0;
+    float wIdeal = sqrtf(4.0f * sigma * sigma + 1.0f);
+    int wl = (int)floorf(wIdeal);
+    if (wl % 2 == 0) --wl;
+    int wu = wl + 2;
+    int m = (int)roundf((12.0f * sigma * sigma - 3.0f * wl * wl - 12.0f * wl - 9.0f) / (-4.0f * wl - 4.0f));
+    for (int i = 0; i < 3; ++i) radii[i] = ((i < m ? wl : wu) - 1) / 2;
+    return 3;
+}
+
+// Bytes to premultiplied channels with 8 fraction bits: c * a * 256 / 255,
+// with the division done as x + x / 256.
+void LoadPremultiplied(const uint8_t *rgba, int count, int32_t *out) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaLane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i alphaScale = _mm_and_si128(alphaLane, _mm_set1_epi16(255));
+    const __m128i half = _mm_set1_epi32(128);
+    // two pixels of 16-bit channels to four int32 pairs
+    auto two = [&](__m128i v, int32_t *dst) {
+        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_or_si128(_mm_andnot_si128(alphaLane, a), alphaScale);
+        __m128i p = _mm_mullo_epi16(v, a);
+        __m128i lo = _mm_unpacklo_epi16(p, zero), hi = _mm_unpackhi_epi16(p, zero);
+        lo = _mm_add_epi32(lo, _mm_srli_epi32(_mm_add_epi32(lo, half), 8));
+        hi = _mm_add_epi32(hi, _mm_srli_epi32(_mm_add_epi32(hi, half), 8));
+        _mm_storeu_si128((__m128i *)dst, lo);
+        _mm_storeu_si128((__m128i *)(dst + 4), hi);
+    };
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(rgba + i * 4));
+        two(_mm_unpacklo_epi8(v, zero), out + i * 4);
+        two(_mm_unpackhi_epi8(v, zero), out + i * 4 + 8);
+    }
+#endif
+    for (; i < count; ++i) {
+        int a = rgba[i * 4 + 3];
+        for (int c = 0; c < 4; ++c) {
+            int p = rgba[i * 4 + c] * (c == 3 ? 255 : a);
+            out[i * 4 + c] = p + ((p + 128) >> 8);
+        }
+    }
+}
+
+// Premultiplied bytes, already in `bytes`, to channels with 8 fraction bits.
+void LoadBytes(const uint8_t *bytes, int values, int32_t *out) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= values; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_slli_epi32(_mm_unpacklo_epi16(lo, zero), 8));
+        _mm_storeu_si128((__m128i *)(out + i + 4), _mm_slli_epi32(_mm_unpackhi_epi16(lo, zero), 8));
+        _mm_storeu_si128((__m128i *)(out + i + 8), _mm_slli_epi32(_mm_unpacklo_epi16(hi, zero), 8));
+        _mm_storeu_si128((__m128i *)(out + i + 12), _mm_slli_epi32(_mm_unpackhi_epi16(hi, zero), 8));
+    }
+#endif
+    for (; i < values; ++i) out[i] = bytes[i] << 8;
+}
+
+// Rounds back to bytes; the saturating packs do the clamping.
+void StoreBytes(const int32_t *in, int values, uint8_t *out) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i half = _mm_set1_epi32(128);
+    auto round4 = [&](int k) {
+        return _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *)(in + k)), half), 8);
+    };
+    for (; i + 16 <= values; i += 16) {
+        __m128i lo = _mm_packs_epi32(round4(i), round4(i + 4));
+        __m128i hi = _mm_packs_epi32(round4(i + 8), round4(i + 12));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < values; ++i) out[i] = (uint8_t)std::clamp((in[i] + 128) >> 8, 0, 255);
+}
+
+// One running-sum box pass over `n` consecutive RGBA pixels, edges
+// repeated. The window sum is updated in O(1) per pixel.
+void BoxLine(const int32_t *in, int32_t *out, int n, int r) {
+    const float inv = 1.0f / (2 * r + 1);
+    auto at = [&](int i) { return in + std::clamp(i, 0, n - 1) * 4; };
+
+#if defined(__SSE2__)
+    auto load = [&](const int32_t *px) { return _mm_loadu_si128((const __m128i *)px); };
+    __m128i sum = _mm_setzero_si128();
+    for (int k = -r; k <= r; ++k) sum = _mm_add_epi32(sum, load(at(k)));
+    const __m128 invv = _mm_set1_ps(inv);
+    auto step = [&](int x, const int32_t *add, const int32_t *sub) {
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), invv)));
+        sum = _mm_sub_epi32(_mm_add_epi32(sum, load(add)), load(sub));
+    };
+    // the window only needs clamping near the ends of the line
+    int a = std::min(n, r), b = std::max(a, n - r - 1);
+    int x = 0;
+    for (; x < a; ++x) step(x, at(x + r + 1), at(x - r));
+    for (; x < b; ++x) step(x, in + (x + r + 1) * 4, in + (x - r) * 4);
+    for (; x < n; ++x) step(x, at(x + r + 1), at(x - r));
+#else
+    int32_t sum[4] = { 0, 0, 0, 0 };
+    for (int k = -r; k <= r; ++k)
+        for (int c = 0; c < 4; ++c) sum[c] += at(k)[c];
+    for (int x = 0; x < n; ++x) {
+        const int32_t *add = at(x + r + 1), *sub = at(x - r);
+        for (int c = 0; c < 4; ++c) {
+            out[x * 4 + c] = (int32_t)lrintf(sum[c] * inv);
+            sum[c] += add[c] - sub[c];
+        }
+    }
+#endif
+}
+
+// Runs the box passes along a line of `n` pixels, in place.
+void BlurLine(uint8_t *line, int n, const int *radii, int passes, bool premultiply) {
+    thread_local std::vector<int32_t> a, b;
+    a.resize((size_t)n * 4);
+    b.resize((size_t)n * 4);
+    if (premultiply) LoadPremultiplied(line, n, a.data());
+    else LoadBytes(line, n * 4, a.data());
+    for (int p = 0; p < passes; ++p) {
+        BoxLine(a.data(), b.data(), n, radii[p]);
+        a.swap(b);
+    }
+    StoreBytes(a.data(), n * 4, line);
+}
+
+// A blurred area stored transposed: row `x - x0` holds column x of the
+// image, `height` pixels from y0 down.
+struct TransposedBlur {
+    int x0 = 0, y0 = 0, height = 0;
+    std::vector<uint8_t> px;
+
+    const uint8_t *At(int x, int y) const { return px.data() + ((size_t)(x - x0) * height + (y - y0)) * 4; }
+};
+
+// Premultiplied blur of `src`, stored transposed. Blurring the rows and
+// writing them out through a transpose lets the vertical passes run along
+// rows as well, so neither direction walks memory with a large stride. Only
+// the pixels of `area` (x0, y0, x1, y1) are computed, from the source around
+// it as far as the passes reach, and only that extent is held.
+void BlurTransposed(const BackgroundSnapshot &src, const int *radii, int passes, const int area[4],
+                    TransposedBlur &out) {
+    const int W = src.width, H = src.height;
+    int reach = 0;
+    for (int p = 0; p < passes; ++p) reach += radii[p];
+    const int ex0 = std::max(0, area[0] - reach), ex1 = std::min(W, area[2] + reach);
+    const int ey0 = std::max(0, area[1] - reach), ey1 = std::min(H, area[3] + reach);
+    const int ew = ex1 - ex0, eh = ey1 - ey0;
+    const int aw = area[2] - area[0];
+
+    // the vertical passes run on the area's columns only
+    out.x0 = area[0];
+    out.y0 = ey0;
+    out.height = eh;
+    out.px.resize((size_t)std::max(0, aw) * eh * 4);
+    if (aw <= 0) return;
+
+    const int bands = (eh + kBand - 1) / kBand;
+    ParallelFor("filter rows", bands, 1, [&](int b0, int b1) {
+        thread_local std::vector<uint8_t> band;
+        band.resize((size_t)kBand * ew * 4);
+        for (int b = b0; b < b1; ++b) {
+            int y0 = ey0 + b * kBand, rows = std::min(kBand, ey1 - y0);
+            for (int r = 0; r < rows; ++r) {
+                uint8_t *line = band.data() + (size_t)r * ew * 4;
+                src.ReadRow(y0 + r, ex0, ew, line);
+                BlurLine(line, ew, radii, passes, true);
+            }
+            TransposeRGBA(band.data() + (size_t)(area[0] - ex0) * 4, (size_t)ew * 4,
+                          out.px.data() + (size_t)(y0 - ey0) * 4, (size_t)eh * 4, aw, rows);
+        }
+    });
+
+    ParallelFor("filter columns", aw, 16, [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) BlurLine(out.px.data() + (size_t)i * eh * 4, eh, radii, passes, false);
+    });
+}
+
+// Sobel gradient magnitude of the image as seen over white, drawn dark on
+// white. Both 3x3 kernels are separable: smooth/difference down the
+// columns, then difference/smooth along the rows.
+void FindEdgesTile(const BackgroundSnapshot &src, const BackgroundTileEdit &t, float gain) {
+    const int W = src.width, H = src.height;
+    const int bw = t.width + 2, bh = t.height + 2;
+    thread_local std::vector<uint8_t> raw;
+    thread_local std::vector<int32_t> px, smooth, diff;
+    raw.resize((size_t)bw * 4);
+    px.resize((size_t)bw * bh * 3);
+    smooth.resize((size_t)bw * 3);
+    diff.resize((size_t)bw * 3);
+
+    // the tile plus a one pixel border, edges repeated
+    int sx0 = std::max(0, t.x0 - 1), sx1 = std::min(W, t.x0 + t.width + 1);
+    for (int r = 0; r < bh; ++r) {
+        int y = std::clamp(t.y0 - 1 + r, 0, H - 1);
+        src.ReadRow(y, sx0, sx1 - sx0, raw.data());
+        int32_t *row = px.data() + (size_t)r * bw * 3;
+        for (int i = 0; i < bw; ++i) {
+            int x = std::clamp(t.x0 - 1 + i, sx0, sx1 - 1) - sx0;
+            uint32_t p;
+            memcpy(&p, raw.data() + x * 4, 4);
+            p = FlattenOverWhite(p);
+            for (int c = 0; c < 3; ++c) row[i * 3 + c] = (p >> (c * 8)) & 0xFF;
+        }
+    }
+
+    const float scale = 0.25f * gain;
+    for (int y = 0; y < t.height; ++y) {
+        const int32_t *up = px.data() + (size_t)y * bw * 3;
+        const int32_t *mid = up + bw * 3;
+        const int32_t *down = mid + bw * 3;
+        for (int j = 0; j < bw * 3; ++j) {
+            smooth[j] = up[j] + 2 * mid[j] + down[j];
+            diff[j] = down[j] - up[j];
+        }
+        uint8_t *out = t.rgba + (size_t)y * t.width * 4;
+        for (int x = 0; x < t.width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                int l = x * 3 + c, m = l + 3, r = l + 6;
+                float gx = (float)(smooth[r] - smooth[l]);
+                float gy = (float)(diff[l] + 2 * diff[m] + diff[r]);
+                float mag = sqrtf(gx * gx + gy * gy) * scale;
+                out[x * 4 + c] = (uint8_t)(255.0f - std::min(255.0f, mag) + 0.5f);
+            }
+            out[x * 4 + 3] = 255;
+        }
+    }
+}
+
+} // namespace
+
+const char *FilterName(FilterKind kind) {
+    switch (kind) {
+        case FILTER_BOX_BLUR: return "Box Blur";
+        case FILTER_UNSHARP_MASK: return "Unsharp Mask";
+        case FILTER_FIND_EDGES: return "Find Edges";
+        default: return "Gaussian Blur";
+    }
+}
+
+std::shared_ptr<const BackgroundSnapshot> FilterBackground(const BackgroundSnapshot &src, const FilterParams &params,
+                                                           const SelectionMask *within) {
+    if (params.kind == FILTER_FIND_EDGES) {
+        return BuildBackgroundWithin(src, within, [&](const BackgroundTileEdit &t) {
+            FindEdgesTile(src, t, params.amount);
+        });
+    }
+
+    // only the selected part is blurred
+    int area[4] = { 0, 0, src.width, src.height };
+    if (within && !within->IsNull() && !within->Bounds(area[0], area[1], area[2], area[3]))
+        area[0] = area[1] = area[2] = area[3] = 0;
+    area[2] = std::min(area[2], src.width);
+    area[3] = std::min(area[3], src.height);
+
+    int radii[3];
+    int passes = BoxRadii(params, radii);
+    TransposedBlur blurred;
+    BlurTransposed(src, radii, passes, area, blurred);
+
+    const bool sharpen = params.kind == FILTER_UNSHARP_MASK;
+    const float amount = params.amount;
+    return BuildBackgroundWithin(src, within, [&](const BackgroundTileEdit &t) {
+        // back from columns to rows; tile pixels outside the area are
+        // unselected and put back afterwards
+        int x0 = std::max(t.x0, area[0]), x1 = std::min(t.x0 + t.width, area[2]);
+        int y0 = std::max(t.y0, area[1]), y1 = std::min(t.y0 + t.height, area[3]);
+        if (x0 >= x1 || y0 >= y1) return;
+        if (x1 - x0 < t.width || y1 - y0 < t.height) memset(t.rgba, 0, (size_t)t.width * t.height * 4);
+        TransposeRGBA(blurred.At(x0, y0), (size_t)blurred.height * 4,
+                      t.rgba + ((size_t)(y0 - t.y0) * t.width + (x0 - t.x0)) * 4, (size_t)t.width * 4, y1 - y0, x1 - x0);
+
+        thread_local std::vector<uint8_t> orig;
+        orig.resize((size_t)t.width * 4);
+        for (int y = 0; y < t.height; ++y) {
+            uint8_t *out = t.rgba + (size_t)y * t.width * 4;
+            UnpremultiplyRGBA(out, t.width);
+            if (!sharpen) continue;
+
+            // push each pixel away from its blurred neighbourhood
+            src.ReadRow(t.y0 + y, t.x0, t.width, orig.data());
+            for (int i = 0; i < t.width * 4; i += 4) {
+                for (int c = 0; c < 3; ++c) {
+                    float s = orig[i + c];
+                    out[i + c] = (uint8_t)std::clamp(s + amount * (s - out[i + c]) + 0.5f, 0.0f, 255.0f);
+                }
+                out[i + 3] = orig[i + 3];
+            }
+        }
+    });
+}
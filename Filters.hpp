@@ -0,0 +1,38 @@
+// Filters.hpp
+#pragma once
+#include <memory>
+#include "Document.hpp"
+#include "Selection.hpp"
+
+// Convolution filters for the background image.
+//
+// Blurs are separable running-sum box passes (three of them approximate a
+// Gaussian), so their cost per pixel does not depend on the radius. Rows are
+// blurred in parallel bands and written out transposed, so the vertical
+// passes also run along contiguous rows; four channels go in each SSE2
+// register and colour is blurred premultiplied. A last parallel pass cuts
+// the result back into tiles and does the unsharp mask. The edge detector
+// is a Sobel operator computed tile by tile.
+
+enum FilterKind {
+    FILTER_GAUSSIAN_BLUR = 0,
+    FILTER_BOX_BLUR,
+    FILTER_UNSHARP_MASK,
+    FILTER_FIND_EDGES,
+    FILTER_COUNT
+};
+
+struct FilterParams {
+    FilterKind kind = FILTER_GAUSSIAN_BLUR;
+    float radius = 4.0f;    // pixels: sigma for Gaussian and unsharp mask, half width for box
+    float amount = 1.0f;    // unsharp mask strength, edge gain
+};
+
+const char *FilterName(FilterKind kind);
+
+// `src` filtered. The radius is in pixels of `src`, so a preview on a
+// downscaled copy scales it down to match. With a selection only the
+// selected pixels change, and only the area around them is blurred. Any
+// thread.
+std::shared_ptr<const BackgroundSnapshot> FilterBackground(const BackgroundSnapshot &src, const FilterParams &params,
+                                                           const SelectionMask *within = nullptr);
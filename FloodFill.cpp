@@ -0,0 +1,266 @@
+// FloodFill.cpp
+#include "FloodFill.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// work mask values
+const uint8_t kOther = 0;
+const uint8_t kMatch = 1;
+const uint8_t kFilled = 2;
+const uint8_t kUnknown = 3;  // tiled fill: block not fetched yet
+
+inline bool Within(const uint8_t *p, const uint8_t *seed, int tolerance) {
+    for (int c = 0; c < 4; ++c)
+        if (std::abs((int)p[c] - (int)seed[c]) > tolerance) return false;
+    return true;
+}
+
+// Marks the pixels of one row that are within tolerance of the seed.
+void MatchRow(const uint8_t *row, int width, const uint8_t *seed, int tolerance, uint8_t *mask) {
+    int x = 0;
+
+#if defined(__SSE2__)
+    uint32_t seedPx;
+    memcpy(&seedPx, seed, 4);
+    const __m128i seedv = _mm_set1_epi32((int)seedPx);
+    const __m128i tolv = _mm_set1_epi8((char)tolerance);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i allOnes = _mm_cmpeq_epi32(zero, zero);
+    const __m128i one = _mm_set1_epi8(1);
+
+    // -1 in each 32-bit lane whose four channels are all within tolerance
+    auto match4 = [&](const uint8_t *p) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i d = _mm_or_si128(_mm_subs_epu8(v, seedv), _mm_subs_epu8(seedv, v));
+        __m128i ok = _mm_cmpeq_epi8(_mm_subs_epu8(d, tolv), zero);
+        return _mm_cmpeq_epi32(ok, allOnes);
+    };
+
+    for (; x + 16 <= width; x += 16) {
+        const uint8_t *p = row + (size_t)x * 4;
+        __m128i lo = _mm_packs_epi32(match4(p), match4(p + 16));
+        __m128i hi = _mm_packs_epi32(match4(p + 32), match4(p + 48));
+        _mm_storeu_si128((__m128i *)(mask + x), _mm_and_si128(_mm_packs_epi16(lo, hi), one));
+    }
+#endif
+
+    for (; x < width; ++x) mask[x] = Within(row + (size_t)x * 4, seed, tolerance) ? kMatch : kOther;
+}
+
+// First x in [x, end) with row[x] != value (or `end`).
+inline int SkipWhile(const uint8_t *row, int x, int end, uint8_t value) {
+#if defined(__SSE2__)
+    const __m128i v = _mm_set1_epi8((char)value);
+    for (; x + 16 <= end; x += 16) {
+        int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + x)), v));
+        if (eq != 0xFFFF) return x + __builtin_ctz(~eq & 0xFFFF);
+    }
+#endif
+    while (x < end && row[x] == value) ++x;
+    return x;
+}
+
+// First x in [x, end) with row[x] == value (or `end`).
+inline int SkipUntil(const uint8_t *row, int x, int end, uint8_t value) {
+#if defined(__SSE2__)
+    const __m128i v = _mm_set1_epi8((char)value);
+    for (; x + 16 <= end; x += 16) {
+        int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + x)), v));
+        if (eq != 0) return x + __builtin_ctz(eq);
+    }
+#endif
+    while (x < end && row[x] != value) ++x;
+    return x;
+}
+
+// One row of the result: filled pixels, plus their 4-neighbours when
+// expanding. `above`/`below` may be null at the image edges.
+void FinishRow(const uint8_t *row, const uint8_t *above, const uint8_t *below, int width,
+               int x0, int x1, bool expand, uint8_t *dst) {
+    auto scalar = [&](int x) {
+        bool in = row[x] == kFilled;
+        if (!in && expand) {
+            in = (x > 0 && row[x - 1] == kFilled) || (x + 1 < width && row[x + 1] == kFilled) ||
+                 (above && above[x] == kFilled) || (below && below[x] == kFilled);
+        }
+        dst[x - x0] = in ? 1 : 0;
+    };
+
+    int x = x0;
+#if defined(__SSE2__)
+    const __m128i filled = _mm_set1_epi8((char)kFilled);
+    const __m128i one = _mm_set1_epi8(1);
+    auto is = [&](const uint8_t *p) { return _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), filled); };
+    if (!expand) {
+        for (; x + 16 <= x1; x += 16)
+            _mm_storeu_si128((__m128i *)(dst + x - x0), _mm_and_si128(is(row + x), one));
+    } else if (above && below) {
+        // neighbours left and right need x-1 and x+16 inside the row
+        for (; x < x1 && x < 1; ++x) scalar(x);
+        for (; x + 17 <= std::min(x1 + 1, width); x += 16) {
+            __m128i in = _mm_or_si128(_mm_or_si128(is(row + x), is(row + x - 1)), is(row + x + 1));
+            in = _mm_or_si128(in, _mm_or_si128(is(above + x), is(below + x)));
+            _mm_storeu_si128((__m128i *)(dst + x - x0), _mm_and_si128(in, one));
+        }
+    }
+#endif
+    for (; x < x1; ++x) scalar(x);
+}
+
+// Matches rows [x0, x1) x y of `work` that are still unknown; null when the
+// whole mask was matched up front.
+using EnsureRange = std::function<void(int x0, int x1, int y)>;
+
+// Span walk from the seed over `work`: fills a whole run, then queues one
+// seed per run above and below. Runs stop at unknown pixels only after the
+// blocks behind them were fetched and matched.
+void Walk(std::vector<uint8_t> &work, int width, int height, int seedX, int seedY,
+          const EnsureRange &ensure, int &minX, int &maxX, int &minY, int &maxY) {
+    minX = maxX = seedX;
+    minY = maxY = seedY;
+    std::vector<std::pair<int, int>> stack = { { seedX, seedY } };
+    while (!stack.empty()) {
+        auto [x, y] = stack.back();
+        stack.pop_back();
+        uint8_t *row = work.data() + (size_t)y * width;
+        if (row[x] != kMatch) continue;
+
+        int lx = x;
+        for (;;) {
+            while (lx > 0 && row[lx - 1] == kMatch) --lx;
+            if (lx == 0 || row[lx - 1] != kUnknown) break;
+            ensure(lx - 1, lx, y);
+        }
+        int rx = x;
+        for (;;) {
+            rx = SkipWhile(row, rx, width, kMatch);
+            if (rx == width || row[rx] != kUnknown) break;
+            ensure(rx, rx + 1, y);
+        }
+        --rx;
+        memset(row + lx, kFilled, rx - lx + 1);
+        minX = std::min(minX, lx);
+        maxX = std::max(maxX, rx);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+
+        for (int ny : { y - 1, y + 1 }) {
+            if (ny < 0 || ny >= height) continue;
+            if (ensure) ensure(lx, rx + 1, ny);
+            const uint8_t *next = work.data() + (size_t)ny * width;
+            for (int i = SkipUntil(next, lx, rx + 1, kMatch); i <= rx; i = SkipUntil(next, i, rx + 1, kMatch)) {
+                stack.push_back({ i, ny });
+                i = SkipWhile(next, i, rx + 1, kMatch);
+            }
+        }
+    }
+}
+
+// The region's bounds and mask from the walked work mask.
+void FinishRegion(const std::vector<uint8_t> &work, int width, int height, bool expandEdges,
+                  int minX, int maxX, int minY, int maxY, FloodFillRegion &out) {
+    int grow = expandEdges ? 1 : 0;
+    out.x0 = std::max(0, minX - grow);
+    out.y0 = std::max(0, minY - grow);
+    out.x1 = std::min(width, maxX + 1 + grow);
+    out.y1 = std::min(height, maxY + 1 + grow);
+    const int w = out.Width();
+    out.mask.assign((size_t)w * out.Height(), 0);
+
+    // the work mask is only read here, so rows can go in parallel
+    std::atomic<size_t> count{ 0 };
+    ParallelFor("fill mask", out.Height(), 64, [&](int r0, int r1) {
+        size_t n = 0;
+        for (int r = r0; r < r1; ++r) {
+            int y = out.y0 + r;
+            const uint8_t *row = work.data() + (size_t)y * width;
+            const uint8_t *above = (y > 0) ? row - width : nullptr;
+            const uint8_t *below = (y + 1 < height) ? row + width : nullptr;
+            uint8_t *dst = out.mask.data() + (size_t)r * w;
+            FinishRow(row, above, below, width, out.x0, out.x1, expandEdges, dst);
+            for (int i = 0; i < w; ++i) n += dst[i];
+        }
+        count += n;
+    });
+    out.count = count;
+}
+
+} // namespace
+
+bool FloodFill(const uint8_t *rgba, int width, int height, ptrdiff_t stride,
+               int seedX, int seedY, int tolerance, bool expandEdges, FloodFillRegion &out) {
+    out = FloodFillRegion();
+    if (seedX < 0 || seedY < 0 || seedX >= width || seedY >= height) return false;
+    tolerance = std::clamp(tolerance, 0, 255);
+
+    uint8_t seed[4];
+    memcpy(seed, rgba + seedY * stride + (ptrdiff_t)seedX * 4, 4);
+
+    std::vector<uint8_t> work((size_t)width * height);
+    ParallelFor("fill match", height, 64, [&](int r0, int r1) {
+        for (int y = r0; y < r1; ++y)
+            MatchRow(rgba + y * stride, width, seed, tolerance, work.data() + (size_t)y * width);
+    });
+
+    int minX, maxX, minY, maxY;
+    Walk(work, width, height, seedX, seedY, nullptr, minX, maxX, minY, maxY);
+    FinishRegion(work, width, height, expandEdges, minX, maxX, minY, maxY, out);
+    return true;
+}
+
+bool FloodFillTiled(const FloodFillSource &source, int tileSize, int width, int height,
+                    int seedX, int seedY, int tolerance, bool expandEdges, FloodFillRegion &out,
+                    int *blocksFetched) {
+    out = FloodFillRegion();
+    if (blocksFetched) *blocksFetched = 0;
+    if (seedX < 0 || seedY < 0 || seedX >= width || seedY >= height || tileSize <= 0) return false;
+    tolerance = std::clamp(tolerance, 0, 255);
+
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    std::vector<uint8_t> fetched((size_t)tilesX * tilesY, 0);
+    std::vector<uint8_t> work((size_t)width * height, kUnknown);
+    std::vector<uint8_t> block;
+    uint8_t seed[4];
+    bool seedKnown = false;
+
+    auto fetch = [&](int tx, int ty) {
+        uint8_t &done = fetched[(size_t)ty * tilesX + tx];
+        if (done) return;
+        done = 1;
+        if (blocksFetched) ++*blocksFetched;
+        int x0 = tx * tileSize, y0 = ty * tileSize;
+        int w = std::min(tileSize, width - x0), h = std::min(tileSize, height - y0);
+        block.resize((size_t)w * h * 4);
+        source(x0, y0, w, h, block.data());
+        if (!seedKnown) {
+            // the seed's block comes first
+            memcpy(seed, block.data() + ((size_t)(seedY - y0) * w + (seedX - x0)) * 4, 4);
+            seedKnown = true;
+        }
+        ParallelFor("fill match", h, 64, [&](int r0, int r1) {
+            for (int r = r0; r < r1; ++r)
+                MatchRow(block.data() + (size_t)r * w * 4, w, seed, tolerance, work.data() + (size_t)(y0 + r) * width + x0);
+        });
+    };
+    fetch(seedX / tileSize, seedY / tileSize);
+
+    EnsureRange ensure = [&](int x0, int x1, int y) {
+        for (int tx = x0 / tileSize; tx <= (x1 - 1) / tileSize; ++tx) fetch(tx, y / tileSize);
+    };
+    int minX, maxX, minY, maxY;
+    Walk(work, width, height, seedX, seedY, ensure, minX, maxX, minY, maxY);
+    FinishRegion(work, width, height, expandEdges, minX, maxX, minY, maxY, out);
+    return true;
+}
@@ -0,0 +1,109 @@
+// Gradient.cpp
+#include "Gradient.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int kBayer[4][4] = {
+    { 0, 8, 2, 10 },
+    { 12, 4, 14, 6 },
+    { 3, 11, 1, 9 },
+    { 15, 7, 13, 5 },
+};
+
+// Ordered dither offset for pixel (x, y), within half a level of zero.
+inline float DitherOffset(int x, int y) {
+    return (kBayer[y & 3][x & 3] + 0.5f) / 16.0f - 0.5f;
+}
+
+// Straight-alpha `src` over `dst`, `count` pixels.
+void CompositeOver(const uint8_t *src, uint8_t *dst, int count) {
+    for (int i = 0; i < count; ++i, src += 4, dst += 4) {
+        float sa = src[3] / 255.0f, da = dst[3] / 255.0f;
+        float oa = sa + da * (1.0f - sa);
+        if (oa <= 0.0f) continue;
+        for (int c = 0; c < 3; ++c)
+            dst[c] = (uint8_t)std::clamp((src[c] * sa + dst[c] * da * (1.0f - sa)) / oa + 0.5f, 0.0f, 255.0f);
+        dst[3] = (uint8_t)(oa * 255.0f + 0.5f);
+    }
+}
+
+} // namespace
+
+float GradientPosition(const GradientParams &g, float x, float y) {
+    float dx = g.end.x - g.start.x, dy = g.end.y - g.start.y;
+    float len2 = dx * dx + dy * dy;
+    if (len2 < 1e-6f) return 1.0f;
+    float px = x - g.start.x, py = y - g.start.y;
+    float t = (g.shape == GRADIENT_LINEAR) ? (px * dx + py * dy) / len2 : sqrtf((px * px + py * py) / len2);
+    return std::clamp(t, 0.0f, 1.0f);
+}
+
+void GradientRow(const GradientParams &g, int y, int x0, int count, uint8_t *rgba) {
+    // translucent colours are painted aside and composited afterwards
+    thread_local std::vector<uint8_t> paint;
+    const bool opaque = g.from.a == 255 && g.to.a == 255;
+    uint8_t *out = rgba;
+    if (!opaque) {
+        paint.resize((size_t)count * 4);
+        out = paint.data();
+    }
+
+    const float from[4] = { (float)g.from.r, (float)g.from.g, (float)g.from.b, (float)g.from.a };
+    const float diff[4] = { g.to.r - from[0], g.to.g - from[1], g.to.b - from[2], g.to.a - from[3] };
+    int x = 0;
+
+#if defined(__SSE2__)
+    const float dx = g.end.x - g.start.x, dy = g.end.y - g.start.y;
+    const float len2 = dx * dx + dy * dy;
+    const bool flat = len2 < 1e-6f;
+    const float inv = flat ? 0.0f : 1.0f / len2;
+    const float cy = y + 0.5f - g.start.y;
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 dxv = _mm_set1_ps(dx), invv = _mm_set1_ps(inv);
+    const __m128 cyLinear = _mm_set1_ps(cy * dy), cy2 = _mm_set1_ps(cy * cy);
+    __m128 f[4], d[4];
+    for (int c = 0; c < 4; ++c) {
+        f[c] = _mm_set1_ps(from[c]);
+        d[c] = _mm_set1_ps(diff[c]);
+    }
+    // this row's dither offsets, twice over so any phase can be loaded
+    float rowDither[8];
+    for (int i = 0; i < 8; ++i) rowDither[i] = g.dither ? DitherOffset(i, y) : 0.0f;
+
+    for (; x + 4 <= count; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps(x0 + x + 0.5f - g.start.x), lane);
+        __m128 t;
+        if (flat) t = one;
+        else if (g.shape == GRADIENT_LINEAR) t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(px, dxv), cyLinear), invv);
+        else t = _mm_sqrt_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(px, px), cy2), invv));
+        t = _mm_min_ps(_mm_max_ps(t, zero), one);
+
+        __m128 dither = _mm_loadu_ps(rowDither + ((x0 + x) & 3));
+        __m128i ch[4];
+        for (int c = 0; c < 4; ++c) ch[c] = _mm_cvtps_epi32(_mm_add_ps(_mm_add_ps(f[c], _mm_mul_ps(d[c], t)), dither));
+
+        // four planar channels of four pixels to RGBA
+        __m128i v = _mm_packus_epi16(_mm_packs_epi32(ch[0], ch[1]), _mm_packs_epi32(ch[2], ch[3]));
+        __m128i rg = _mm_unpacklo_epi8(v, _mm_srli_si128(v, 4));
+        __m128i ba = _mm_unpacklo_epi8(_mm_srli_si128(v, 8), _mm_srli_si128(v, 12));
+        _mm_storeu_si128((__m128i *)(out + (size_t)x * 4), _mm_unpacklo_epi16(rg, ba));
+    }
+#endif
+
+    for (; x < count; ++x) {
+        float t = GradientPosition(g, x0 + x + 0.5f, y + 0.5f);
+        float dither = g.dither ? DitherOffset(x0 + x, y) : 0.0f;
+        for (int c = 0; c < 4; ++c)
+            out[x * 4 + c] = (uint8_t)std::clamp(lrintf(from[c] + diff[c] * t + dither), 0L, 255L);
+    }
+
+    if (!opaque) CompositeOver(out, rgba, count);
+}
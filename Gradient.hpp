@@ -0,0 +1,35 @@
+// Gradient.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+
+// CPU rasterization of the gradient tool's fills, done once on release
+// (the drag preview is drawn on the GPU).
+//
+// A row is evaluated four pixels at a time in SSE2: the gradient position
+// steps by a constant along a row for linear fills and is one square root
+// for radial ones, the two colours are interpolated per channel, and an
+// optional 4x4 ordered dither spreads the rounding so shallow ramps do not
+// band. Rows of different tiles are independent, so callers run tiles in
+// parallel.
+
+enum GradientShape {
+    GRADIENT_LINEAR = 0,
+    GRADIENT_RADIAL
+};
+
+struct GradientParams {
+    GradientShape shape = GRADIENT_LINEAR;
+    Vector2 start{};        // document pixels; radial fills are centred here
+    Vector2 end{};          // where `to` is reached
+    Color from = BLACK;
+    Color to = WHITE;
+    bool dither = true;
+};
+
+// Gradient position, 0 at `start` and 1 at `end`, of the point (x, y).
+float GradientPosition(const GradientParams &g, float x, float y);
+
+// Paints `count` straight-alpha RGBA pixels of row `y`, from column `x0` on,
+// with the gradient composited over them.
+void GradientRow(const GradientParams &g, int y, int x0, int count, uint8_t *rgba);
@@ -0,0 +1,161 @@
+// ImageOps.cpp
+#include "ImageOps.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// c*a + 255*(255-a) is at most 255*255, so the +128 rounding bias and the
+// (x + (x >> 8)) >> 8 division by 255 both stay inside 16 bits.
+static inline uint8_t OverWhite(uint32_t c, uint32_t a) {
+    uint32_t x = c * a + 255u * (255u - a) + 128u;
+    return (uint8_t)((x + (x >> 8)) >> 8);
+}
+
+void CompositeOverWhiteToRGB(const uint8_t *rgba, uint8_t *rgb, int count) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k255 = _mm_set1_epi16(255);
+    const __m128i kBias = _mm_set1_epi16(128);
+    alignas(16) uint8_t out[16];
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i *)(rgba + i * 4));
+
+        // broadcast each pixel's alpha into all four of its bytes
+        __m128i a = _mm_srli_epi32(px, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+        __m128i lo = _mm_unpacklo_epi8(px, zero), hi = _mm_unpackhi_epi8(px, zero);
+        __m128i alo = _mm_unpacklo_epi8(a, zero), ahi = _mm_unpackhi_epi8(a, zero);
+
+        // x = c*a + 255*(255-a) + 128 ; x / 255
+        __m128i xlo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), _mm_mullo_epi16(k255, _mm_sub_epi16(k255, alo)));
+        __m128i xhi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), _mm_mullo_epi16(k255, _mm_sub_epi16(k255, ahi)));
+        xlo = _mm_add_epi16(xlo, kBias);
+        xhi = _mm_add_epi16(xhi, kBias);
+        xlo = _mm_srli_epi16(_mm_add_epi16(xlo, _mm_srli_epi16(xlo, 8)), 8);
+        xhi = _mm_srli_epi16(_mm_add_epi16(xhi, _mm_srli_epi16(xhi, 8)), 8);
+
+        _mm_store_si128((__m128i *)out, _mm_packus_epi16(xlo, xhi));
+
+        uint8_t *d = rgb + i * 3;
+        memcpy(d, out, 3);
+        memcpy(d + 3, out + 4, 3);
+        memcpy(d + 6, out + 8, 3);
+        memcpy(d + 9, out + 12, 3);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        const uint8_t *s = rgba + i * 4;
+        rgb[i * 3 + 0] = OverWhite(s[0], s[3]);
+        rgb[i * 3 + 1] = OverWhite(s[1], s[3]);
+        rgb[i * 3 + 2] = OverWhite(s[2], s[3]);
+    }
+}
+
+void BoxDownsampleRGB(const uint8_t *src, size_t srcStride, int factor, int dstW, uint8_t *dst) {
+    if (factor <= 1) {
+        memcpy(dst, src, (size_t)dstW * 3);
+        return;
+    }
+
+    // vertical pass: sum `factor` rows into 16-bit lanes
+    const int n = dstW * factor * 3;
+    thread_local std::vector<uint16_t> acc;
+    acc.assign(n, 0);
+    for (int r = 0; r < factor; ++r) {
+        const uint8_t *row = src + r * srcStride;
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(row + i));
+            __m128i *a = (__m128i *)(acc.data() + i);
+            _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), _mm_unpacklo_epi8(v, zero)));
+            _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1), _mm_unpackhi_epi8(v, zero)));
+        }
+#endif
+        for (; i < n; ++i) acc[i] += row[i];
+    }
+
+    // horizontal pass: sum `factor` neighbours per channel, divide with rounding
+    const int shift = (factor == 2) ? 2 : 4;
+    const int round = 1 << (shift - 1);
+    for (int x = 0; x < dstW; ++x) {
+        const uint16_t *a = acc.data() + x * factor * 3;
+        for (int c = 0; c < 3; ++c) {
+            int sum = 0;
+            for (int k = 0; k < factor; ++k) sum += a[k * 3 + c];
+            dst[x * 3 + c] = (uint8_t)((sum + round) >> shift);
+        }
+    }
+}
+
+void UnpremultiplyRGBA(uint8_t *rgba, int count) {
+    for (int i = 0; i < count; ++i, rgba += 4) {
+        uint32_t a = rgba[3];
+        if (a == 255) continue;
+        if (a == 0) { rgba[0] = rgba[1] = rgba[2] = 0; continue; }
+        for (int c = 0; c < 3; ++c) {
+            uint32_t v = (rgba[c] * 255u + a / 2) / a;
+            rgba[c] = (uint8_t)(v > 255u ? 255u : v);
+        }
+    }
+}
+
+void ReverseRGBA(uint8_t *rgba, int count) {
+    uint32_t *px = (uint32_t *)rgba;
+    int i = 0, j = count;
+#if defined(__SSE2__)
+    for (; j - i >= 8; i += 4, j -= 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(px + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(px + j - 4));
+        _mm_storeu_si128((__m128i *)(px + i), _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_si128((__m128i *)(px + j - 4), _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+#endif
+    for (--j; i < j; ++i, --j) std::swap(px[i], px[j]);
+}
+
+void TransposeRGBA(const uint8_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, int width, int height) {
+    const int kBlock = 64;
+    auto at = [](const uint8_t *base, size_t stride, int x, int y) { return (const uint32_t *)(base + y * stride) + x; };
+    auto out = [](uint8_t *base, size_t stride, int x, int y) { return (uint32_t *)(base + y * stride) + x; };
+
+    for (int by = 0; by < height; by += kBlock) {
+        for (int bx = 0; bx < width; bx += kBlock) {
+            int ey = std::min(height, by + kBlock), ex = std::min(width, bx + kBlock);
+            int y = by;
+#if defined(__SSE2__)
+            for (; y + 4 <= ey; y += 4) {
+                int x = bx;
+                for (; x + 4 <= ex; x += 4) {
+                    __m128i r0 = _mm_loadu_si128((const __m128i *)at(src, srcStride, x, y));
+                    __m128i r1 = _mm_loadu_si128((const __m128i *)at(src, srcStride, x, y + 1));
+                    __m128i r2 = _mm_loadu_si128((const __m128i *)at(src, srcStride, x, y + 2));
+                    __m128i r3 = _mm_loadu_si128((const __m128i *)at(src, srcStride, x, y + 3));
+                    __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpackhi_epi32(r0, r1);
+                    __m128i t2 = _mm_unpacklo_epi32(r2, r3), t3 = _mm_unpackhi_epi32(r2, r3);
+                    _mm_storeu_si128((__m128i *)out(dst, dstStride, y, x), _mm_unpacklo_epi64(t0, t2));
+                    _mm_storeu_si128((__m128i *)out(dst, dstStride, y, x + 1), _mm_unpackhi_epi64(t0, t2));
+                    _mm_storeu_si128((__m128i *)out(dst, dstStride, y, x + 2), _mm_unpacklo_epi64(t1, t3));
+                    _mm_storeu_si128((__m128i *)out(dst, dstStride, y, x + 3), _mm_unpackhi_epi64(t1, t3));
+                }
+                for (; x < ex; ++x)
+                    for (int k = 0; k < 4; ++k) *out(dst, dstStride, y + k, x) = *at(src, srcStride, x, y + k);
+            }
+#endif
+            for (; y < ey; ++y)
+                for (int x = bx; x < ex; ++x) *out(dst, dstStride, y, x) = *at(src, srcStride, x, y);
+        }
+    }
+}
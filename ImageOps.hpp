@@ -0,0 +1,40 @@
+// ImageOps.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CPU pixel kernels shared by export, the benchmarks and the image tools.
+// All pixel data is 8-bit RGBA unless stated otherwise.
+
+// One straight-alpha RGBA pixel (as a little-endian uint32) composited over
+// white; the result is opaque. Same rounding as CompositeOverWhiteToRGB.
+inline uint32_t FlattenOverWhite(uint32_t px) {
+    uint32_t a = px >> 24;
+    if (a == 255) return px;
+    uint32_t out = 0xFF000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t x = ((px >> shift) & 0xFF) * a + 255u * (255u - a) + 128u;
+        out |= ((x + (x >> 8)) >> 8) << shift;
+    }
+    return out;
+}
+
+// Composites `count` straight-alpha RGBA pixels over opaque white and drops
+// alpha, writing `count` * 3 bytes of RGB. Integer maths, SSE2 where available.
+void CompositeOverWhiteToRGB(const uint8_t *rgba, uint8_t *rgb, int count);
+
+// Box-filters RGB down by `factor` (1, 2 or 4) in both directions. `src` holds
+// `factor` rows of dstW * factor pixels, `srcStride` bytes apart; `dst`
+// receives one row of dstW pixels.
+void BoxDownsampleRGB(const uint8_t *src, size_t srcStride, int factor, int dstW, uint8_t *dst);
+
+// Converts `count` premultiplied RGBA pixels to straight alpha in place.
+void UnpremultiplyRGBA(uint8_t *rgba, int count);
+
+// Reverses the order of `count` RGBA pixels in place.
+void ReverseRGBA(uint8_t *rgba, int count);
+
+// Transposes a `width` x `height` block of RGBA pixels: dst(y, x) = src(x, y).
+// Strides are in bytes; `dst` is `height` pixels wide. Works in 4x4 SSE2
+// blocks inside 64x64 cache blocks.
+void TransposeRGBA(const uint8_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, int width, int height);
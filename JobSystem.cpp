@@ -0,0 +1,308 @@
+// JobSystem.cpp
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+struct Job {
+    const char *name = nullptr;
+    std::function<void()> fn;
+    std::atomic<int> pending{1};     // unfinished dependencies + the submit token
+    std::atomic<bool> finished{false};
+    std::mutex mutex;                // guards done/continuations
+    std::condition_variable cv;
+    bool done = false;
+    std::vector<JobRef> continuations;
+};
+
+namespace {
+
+struct Worker {
+    std::mutex mutex;
+    std::deque<JobRef> queue;
+    std::thread thread;
+};
+
+struct JobPool {
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> nextQueue{0};
+    bool quit = false;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+};
+
+JobPool *g_Pool = nullptr;
+std::mutex g_PoolMutex;
+
+std::mutex g_PostMutex;
+std::vector<std::function<void()>> g_Posts;
+
+std::mutex g_TimingMutex;
+std::map<std::string, JobTiming> g_Timings;
+
+thread_local int t_WorkerIndex = -1;
+
+double NowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void RecordTiming(const char *name, double ms) {
+    if (!name) return;
+    std::lock_guard<std::mutex> lock(g_TimingMutex);
+    JobTiming &t = g_Timings[name];
+    t.runs++;
+    t.totalMs += ms;
+    t.maxMs = std::max(t.maxMs, ms);
+}
+
+void WorkerLoop(JobPool *pool, int index);
+
+// Called with g_PoolMutex held.
+void StartPool(int threads) {
+    if (threads <= 0) threads = std::max(2, (int)std::thread::hardware_concurrency() - 1);
+    g_Pool = new JobPool;
+    for (int i = 0; i < threads; ++i) g_Pool->workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < threads; ++i) g_Pool->workers[i]->thread = std::thread(WorkerLoop, g_Pool, i);
+}
+
+JobPool &Pool() {
+    std::lock_guard<std::mutex> lock(g_PoolMutex);
+    if (!g_Pool) StartPool(0);
+    return *g_Pool;
+}
+
+void Enqueue(JobPool &pool, JobRef job) {
+    int n = (int)pool.workers.size();
+    int target = (t_WorkerIndex >= 0) ? t_WorkerIndex : (int)(pool.nextQueue++ % (unsigned)n);
+    {
+        std::lock_guard<std::mutex> lock(pool.workers[target]->mutex);
+        pool.workers[target]->queue.push_back(std::move(job));
+    }
+    pool.queued++;
+    std::lock_guard<std::mutex> lock(pool.sleepMutex);
+    pool.sleepCv.notify_one();
+}
+
+// Newest job of our own queue, otherwise the oldest job of someone else's.
+bool TryPop(JobPool &pool, int self, JobRef &out) {
+    int n = (int)pool.workers.size();
+    if (self >= 0) {
+        Worker &w = *pool.workers[self];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (!w.queue.empty()) {
+            out = std::move(w.queue.back());
+            w.queue.pop_back();
+            pool.queued--;
+            return true;
+        }
+    }
+    for (int i = 1; i <= n; ++i) {
+        int victim = (self + i + n) % n;
+        if (victim == self) continue;
+        Worker &w = *pool.workers[victim];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (!w.queue.empty()) {
+            out = std::move(w.queue.front());
+            w.queue.pop_front();
+            pool.queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Execute(JobPool &pool, const JobRef &job) {
+    double t0 = NowMs();
+    job->fn();
+    RecordTiming(job->name, NowMs() - t0);
+    job->fn = nullptr;
+
+    std::vector<JobRef> next;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        job->finished.store(true, std::memory_order_release);
+        next.swap(job->continuations);
+    }
+    job->cv.notify_all();
+    for (auto &c : next)
+        if (--c->pending == 0) Enqueue(pool, c);
+}
+
+void WorkerLoop(JobPool *pool, int index) {
+    t_WorkerIndex = index;
+    for (;;) {
+        JobRef job;
+        if (TryPop(*pool, index, job)) {
+            Execute(*pool, job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(pool->sleepMutex);
+        pool->sleepCv.wait(lock, [pool] { return pool->quit || pool->queued > 0; });
+        if (pool->quit && pool->queued == 0) return;
+    }
+}
+
+} // namespace
+
+void JobsInit(int threads) {
+    std::lock_guard<std::mutex> lock(g_PoolMutex);
+    if (!g_Pool) StartPool(threads);
+}
+
+void JobsShutdown() {
+    std::lock_guard<std::mutex> lock(g_PoolMutex);
+    if (!g_Pool) return;
+    {
+        std::lock_guard<std::mutex> sleep(g_Pool->sleepMutex);
+        g_Pool->quit = true;
+    }
+    g_Pool->sleepCv.notify_all();
+    for (auto &w : g_Pool->workers) w->thread.join();
+    delete g_Pool;
+    g_Pool = nullptr;
+}
+
+int JobWorkerCount() {
+    return (int)Pool().workers.size();
+}
+
+JobRef CreateJob(const char *name, std::function<void()> fn) {
+    JobRef job = std::make_shared<Job>();
+    job->name = name;
+    job->fn = std::move(fn);
+    return job;
+}
+
+void AddJobDependency(const JobRef &job, const JobRef &dependsOn) {
+    std::lock_guard<std::mutex> lock(dependsOn->mutex);
+    if (dependsOn->done) return;
+    job->pending++;
+    dependsOn->continuations.push_back(job);
+}
+
+void SubmitJob(const JobRef &job) {
+    if (--job->pending == 0) Enqueue(Pool(), job);
+}
+
+JobRef RunJob(const char *name, std::function<void()> fn) {
+    JobRef job = CreateJob(name, std::move(fn));
+    SubmitJob(job);
+    return job;
+}
+
+bool IsJobDone(const JobRef &job) {
+    return job->finished.load(std::memory_order_acquire);
+}
+
+void WaitJob(const JobRef &job) {
+    JobPool &pool = Pool();
+    while (!IsJobDone(job)) {
+        if (t_WorkerIndex >= 0) {
+            JobRef other;
+            if (TryPop(pool, t_WorkerIndex, other)) {
+                Execute(pool, other);
+                continue;
+            }
+        }
+        std::unique_lock<std::mutex> lock(job->mutex);
+        if (t_WorkerIndex >= 0)
+            job->cv.wait_for(lock, std::chrono::milliseconds(1), [&] { return job->done; });
+        else
+            job->cv.wait(lock, [&] { return job->done; });
+    }
+}
+
+namespace {
+
+// Shared between a ParallelFor call and its helper jobs, which may still be
+// queued (and find nothing left to do) after the call has returned.
+struct ForState {
+    const std::function<void(int, int)> *fn = nullptr;
+    int count = 0;
+    int chunks = 0;
+    std::atomic<int> next{0};
+    std::atomic<int> remaining{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    void Run() {
+        int c;
+        while ((c = next++) < chunks) {
+            int b = (int)((long long)count * c / chunks);
+            int e = (int)((long long)count * (c + 1) / chunks);
+            (*fn)(b, e);
+            if (--remaining == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+void ParallelFor(const char *name, int count, int minPerChunk, const std::function<void(int, int)> &fn) {
+    if (count <= 0) return;
+    double t0 = NowMs();
+    int workers = JobWorkerCount();
+
+    // a few chunks per thread so stealing can even out uneven rows
+    int chunks = std::min(count / std::max(1, minPerChunk), (workers + 1) * 4);
+    if (chunks <= 1) {
+        fn(0, count);
+        RecordTiming(name, NowMs() - t0);
+        return;
+    }
+
+    auto state = std::make_shared<ForState>();
+    state->fn = &fn;
+    state->count = count;
+    state->chunks = chunks;
+    state->remaining = chunks;
+
+    int helpers = std::min(workers, chunks - 1);
+    for (int i = 0; i < helpers; ++i) RunJob(nullptr, [state] { state->Run(); });
+
+    state->Run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] { return state->remaining == 0; });
+    lock.unlock();
+    RecordTiming(name, NowMs() - t0);
+}
+
+void PostToMainThread(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(g_PostMutex);
+    g_Posts.push_back(std::move(fn));
+}
+
+void RunMainThreadPosts() {
+    std::vector<std::function<void()>> posts;
+    {
+        std::lock_guard<std::mutex> lock(g_PostMutex);
+        posts.swap(g_Posts);
+    }
+    for (auto &fn : posts) fn();
+}
+
+std::vector<JobTiming> GetJobTimings() {
+    std::lock_guard<std::mutex> lock(g_TimingMutex);
+    std::vector<JobTiming> out;
+    for (auto &kv : g_Timings) {
+        out.push_back(kv.second);
+        out.back().name = kv.first;
+    }
+    return out;
+}
+
+void ResetJobTimings() {
+    std::lock_guard<std::mutex> lock(g_TimingMutex);
+    g_Timings.clear();
+}
@@ -0,0 +1,58 @@
+// JobSystem.hpp
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Shared work-stealing thread pool for CPU-heavy document work (saving,
+// export, image conversion, undo snapshots). Each worker owns a deque: it
+// pops its own newest job and steals the oldest job of another worker when
+// empty. Jobs can depend on other jobs to form small task graphs.
+//
+// The render thread never runs pool jobs itself, so a long job (decoding a
+// huge file) can never stall a frame; it only blocks in WaitJob and in
+// ParallelFor, where it works through its own loop chunks.
+
+struct Job;
+using JobRef = std::shared_ptr<Job>;
+
+// Starts the workers. Optional: the pool starts on first use with the
+// default size (hardware threads minus the render thread, at least 2).
+void JobsInit(int threads = 0);
+// Finishes every queued job and stops the workers.
+void JobsShutdown();
+int JobWorkerCount();
+
+// A job runs once it has been submitted and all of its dependencies are done.
+// `name` (a string literal) is the key for the timing counters; nullptr skips them.
+JobRef CreateJob(const char *name, std::function<void()> fn);
+void AddJobDependency(const JobRef &job, const JobRef &dependsOn);  // before SubmitJob(job)
+void SubmitJob(const JobRef &job);
+JobRef RunJob(const char *name, std::function<void()> fn);          // create + submit
+
+bool IsJobDone(const JobRef &job);
+// Blocks until `job` is done. Pool workers keep running other jobs meanwhile,
+// so jobs may wait on jobs without deadlocking the pool.
+void WaitJob(const JobRef &job);
+
+// Calls fn(begin, end) over disjoint ranges covering [0, count), each at least
+// `minPerChunk` long (except possibly the last), in parallel. The caller takes
+// part and returns when every range is done.
+void ParallelFor(const char *name, int count, int minPerChunk, const std::function<void(int, int)> &fn);
+
+// Queues `fn` to run on the render thread at the next RunMainThreadPosts(),
+// for results that need the GPU or the document globals.
+void PostToMainThread(std::function<void()> fn);
+void RunMainThreadPosts();
+
+struct JobTiming {
+    std::string name;
+    unsigned long long runs = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+};
+
+// Per-name counters, accumulated since start or the last reset.
+std::vector<JobTiming> GetJobTimings();
+void ResetJobTimings();
@@ -0,0 +1,146 @@
+// LayerCompositor.cpp
+#include "LayerCompositor.hpp"
+#include "rlgl.h"
+#include <algorithm>
+
+static bool SameCamera(const Camera2D &a, const Camera2D &b) {
+    return a.offset.x == b.offset.x && a.offset.y == b.offset.y &&
+           a.target.x == b.target.x && a.target.y == b.target.y &&
+           a.rotation == b.rotation && a.zoom == b.zoom;
+}
+
+// The targets cover just the canvas area.
+static Camera2D LocalCamera(const Camera2D &cam, Rectangle area) {
+    Camera2D local = cam;
+    local.offset = { cam.offset.x - area.x, cam.offset.y - area.y };
+    return local;
+}
+
+const char *LayerBlendName(LayerBlend blend) {
+    switch (blend) {
+        case LAYER_BLEND_MULTIPLY: return "Multiply";
+        case LAYER_BLEND_SCREEN: return "Screen";
+        case LAYER_BLEND_ADD: return "Add";
+        default: return "Normal";
+    }
+}
+
+void BeginLayerContent() {
+    // colour is scaled by alpha on the way in, coverage accumulates as "over"
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+}
+
+void EndLayerContent() {
+    EndBlendMode();
+}
+
+void CompositeLayer(const RenderTexture2D &layer, Rectangle dst, float opacity, LayerBlend blend) {
+    // premultiplied source: opacity scales every channel
+    switch (blend) {
+        case LAYER_BLEND_MULTIPLY: rlSetBlendFactors(RL_DST_COLOR, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD); break;
+        case LAYER_BLEND_SCREEN: rlSetBlendFactors(RL_ONE, RL_ONE_MINUS_SRC_COLOR, RL_FUNC_ADD); break;
+        case LAYER_BLEND_ADD: rlSetBlendFactors(RL_ONE, RL_ONE, RL_FUNC_ADD); break;
+        default: rlSetBlendFactors(RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD); break;
+    }
+    unsigned char a = (unsigned char)(std::clamp(opacity, 0.0f, 1.0f) * 255.0f + 0.5f);
+
+    BeginBlendMode(BLEND_CUSTOM);
+    // render targets are stored bottom-up
+    Rectangle src = { 0, 0, (float)layer.texture.width, -(float)layer.texture.height };
+    DrawTexturePro(layer.texture, src, dst, { 0, 0 }, 0.0f, Color{ a, a, a, a });
+    EndBlendMode();
+}
+
+LayerViewCache::Entry *LayerViewCache::Find(uint64_t layerId) {
+    for (Entry &e : entries)
+        if (e.layerId == layerId) return &e;
+    return nullptr;
+}
+
+const LayerViewCache::Entry *LayerViewCache::Find(uint64_t layerId) const {
+    for (const Entry &e : entries)
+        if (e.layerId == layerId) return &e;
+    return nullptr;
+}
+
+void LayerViewCache::Update(const std::vector<Layer> &layers, const Camera2D &cam, Rectangle area,
+                            uint64_t backgroundGeneration, const DrawContent &draw) {
+    int w = (int)area.width, h = (int)area.height;
+
+    // targets of deleted and hidden layers go first
+    for (size_t i = 0; i < entries.size();) {
+        bool keep = false;
+        for (const Layer &l : layers)
+            if (l.id == entries[i].layerId) keep = l.visible;
+        if (keep) {
+            ++i;
+        } else {
+            UnloadRenderTexture(entries[i].target);
+            entries.erase(entries.begin() + i);
+        }
+    }
+    if (w <= 0 || h <= 0) return;
+    const Camera2D local = LocalCamera(cam, area);
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const Layer &layer = layers[i];
+        if (!layer.visible) continue;
+
+        Entry *e = Find(layer.id);
+        if (!e) {
+            entries.push_back(Entry());
+            e = &entries.back();
+            e->layerId = layer.id;
+        }
+        if (e->target.texture.width != w || e->target.texture.height != h) {
+            if (e->target.id != 0) UnloadRenderTexture(e->target);
+            e->target = LoadRenderTexture(w, h);
+            e->valid = false;
+        }
+
+        if (!Stale(layers, i, cam, area, backgroundGeneration)) continue;
+
+        BeginTextureMode(e->target);
+        ClearBackground(BLANK);
+        BeginMode2D(local);
+        BeginLayerContent();
+        draw(i);
+        EndLayerContent();
+        EndMode2D();
+        EndTextureMode();
+
+        e->valid = true;
+        e->version = layer.version;
+        e->backgroundGeneration = (i == 0) ? backgroundGeneration : 0;
+        e->cam = local;
+    }
+}
+
+bool LayerViewCache::Stale(const std::vector<Layer> &layers, size_t index, const Camera2D &cam, Rectangle area,
+                           uint64_t backgroundGeneration) const {
+    const Layer &layer = layers[index];
+    if (!layer.visible || (int)area.width <= 0 || (int)area.height <= 0) return false;
+    const Entry *e = Find(layer.id);
+    if (!e || !e->valid || e->target.texture.width != (int)area.width || e->target.texture.height != (int)area.height)
+        return true;
+    uint64_t generation = (index == 0) ? backgroundGeneration : 0;
+    return e->version != layer.version || e->backgroundGeneration != generation || !SameCamera(e->cam, LocalCamera(cam, area));
+}
+
+void LayerViewCache::Invalidate(uint64_t layerId) {
+    if (Entry *e = Find(layerId)) e->valid = false;
+}
+
+void LayerViewCache::Draw(const std::vector<Layer> &layers, Rectangle area) const {
+    for (const Layer &layer : layers) {
+        if (!layer.visible) continue;
+        const Entry *e = Find(layer.id);
+        if (e && e->valid) CompositeLayer(e->target, area, layer.opacity, layer.blend);
+    }
+}
+
+void LayerViewCache::Release() {
+    for (Entry &e : entries) UnloadRenderTexture(e.target);
+    entries.clear();
+}
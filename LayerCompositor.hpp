@@ -0,0 +1,61 @@
+// LayerCompositor.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Document.hpp"
+
+// GPU compositing of document layers.
+//
+// Each layer is rendered on its own into a transparent target, leaving
+// premultiplied colour, and is then blended over the layers below with its
+// opacity and blend mode. The canvas view keeps one screen-sized target per
+// visible layer and re-renders a layer only when its content, the camera or
+// the background tiles it shows changed; hidden layers have no target.
+
+const char *LayerBlendName(LayerBlend blend);
+
+// Blend state for drawing layer content into a cleared target.
+void BeginLayerContent();
+void EndLayerContent();
+
+// Blends a layer target (drawn upright) into `dst` of the current target.
+void CompositeLayer(const RenderTexture2D &layer, Rectangle dst, float opacity, LayerBlend blend);
+
+class LayerViewCache {
+public:
+    // Draws the content of layers[index] in document space.
+    using DrawContent = std::function<void(size_t index)>;
+
+    // Re-renders the targets of visible layers that changed since the last
+    // call. `area` is the canvas area on screen, `cam` the view camera and
+    // `backgroundGeneration` the pyramid generation (bottom layer only).
+    // Call outside scissor mode: it switches render targets.
+    void Update(const std::vector<Layer> &layers, const Camera2D &cam, Rectangle area,
+                uint64_t backgroundGeneration, const DrawContent &draw);
+    // Whether Update with the same arguments would re-render layers[index].
+    bool Stale(const std::vector<Layer> &layers, size_t index, const Camera2D &cam, Rectangle area,
+               uint64_t backgroundGeneration) const;
+    // Re-renders the layer with `layerId` on the next Update whatever its
+    // version, for content drawn from outside the layer (a move drag).
+    void Invalidate(uint64_t layerId);
+    // Composites the visible layers over the current target.
+    void Draw(const std::vector<Layer> &layers, Rectangle area) const;
+    void Release();
+
+private:
+    struct Entry {
+        uint64_t layerId = 0;
+        RenderTexture2D target = {};
+        bool valid = false;
+        uint64_t version = 0;
+        uint64_t backgroundGeneration = 0;
+        Camera2D cam = {};
+    };
+
+    Entry *Find(uint64_t layerId);
+    const Entry *Find(uint64_t layerId) const;
+
+    std::vector<Entry> entries;
+};
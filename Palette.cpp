@@ -0,0 +1,321 @@
+// Palette.cpp
+#include "Palette.hpp"
+#include "ImageOps.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int kMaxColors = 256;
+const int kCells = 32768;  // RGB555 histogram / lookup cells
+
+const int kBayer4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+inline uint32_t SlotOf(uint32_t key, int slots) {
+    return (key * 2654435761u) >> (32 - __builtin_ctz((unsigned)slots));
+}
+
+// Open-addressed colour set that gives up past 256 entries. Flattened colours
+// always have alpha 0xFF, so 0 marks an empty slot.
+struct ColorSet {
+    static const int kSlots = 1024;
+    uint32_t keys[kSlots] = {};
+    int count = 0;
+    bool overflow = false;
+
+    void Insert(uint32_t key) {
+        uint32_t s = SlotOf(key, kSlots);
+        while (keys[s] != 0) {
+            if (keys[s] == key) return;
+            s = (s + 1) & (kSlots - 1);
+        }
+        if (count == kMaxColors) { overflow = true; return; }
+        keys[s] = key;
+        count++;
+    }
+};
+
+// True when the four pixels at p all equal v.
+inline bool Run4(const uint32_t *p, uint32_t v) {
+#if defined(__SSE2__)
+    __m128i a = _mm_loadu_si128((const __m128i *)p);
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_set1_epi32((int)v))) == 0xFFFF;
+#else
+    return p[0] == v && p[1] == v && p[2] == v && p[3] == v;
+#endif
+}
+
+// Runs of identical pixels are skipped four at a time, so flat drawings only
+// pay for the colour changes.
+void CountColors(const uint32_t *px, size_t n, ColorSet &set, const std::atomic<bool> &stop) {
+    uint32_t last = px[0];
+    set.Insert(FlattenOverWhite(last));
+    size_t i = 1;
+    while (i < n && !set.overflow) {
+        if (i + 4 <= n && Run4(px + i, last)) { i += 4; continue; }
+        uint32_t v = px[i++];
+        if (v == last) continue;
+        last = v;
+        set.Insert(FlattenOverWhite(v));
+        if ((i & 0xFFFF) == 0 && stop.load(std::memory_order_relaxed)) return;
+    }
+}
+
+inline int CellOf(uint32_t flat) {
+    return (int)((((flat >> 3) & 0x1F) << 10) | (((flat >> 11) & 0x1F) << 5) | ((flat >> 19) & 0x1F));
+}
+
+struct Histogram {
+    std::vector<uint32_t> count;
+    std::vector<uint64_t> sum;  // r, g, b per cell
+
+    Histogram() : count(kCells, 0), sum((size_t)kCells * 3, 0) {}
+
+    void Add(const Histogram &o) {
+        for (int i = 0; i < kCells; ++i) count[i] += o.count[i];
+        for (size_t i = 0; i < sum.size(); ++i) sum[i] += o.sum[i];
+    }
+};
+
+struct Box {
+    int lo[3], hi[3];  // inclusive, 5-bit per axis (r, g, b)
+    uint64_t pop = 0;
+};
+
+inline int CellIndex(int r, int g, int b) { return (r << 10) | (g << 5) | b; }
+
+// Tightens a box to its non-empty cells and recounts its population.
+void ShrinkBox(const Histogram &h, Box &box) {
+    int lo[3] = { 31, 31, 31 }, hi[3] = { 0, 0, 0 };
+    box.pop = 0;
+    for (int r = box.lo[0]; r <= box.hi[0]; ++r)
+        for (int g = box.lo[1]; g <= box.hi[1]; ++g)
+            for (int b = box.lo[2]; b <= box.hi[2]; ++b) {
+                uint32_t c = h.count[CellIndex(r, g, b)];
+                if (!c) continue;
+                box.pop += c;
+                lo[0] = std::min(lo[0], r); hi[0] = std::max(hi[0], r);
+                lo[1] = std::min(lo[1], g); hi[1] = std::max(hi[1], g);
+                lo[2] = std::min(lo[2], b); hi[2] = std::max(hi[2], b);
+            }
+    if (box.pop) {
+        std::memcpy(box.lo, lo, sizeof(lo));
+        std::memcpy(box.hi, hi, sizeof(hi));
+    }
+}
+
+// Median cut over the RGB555 histogram.
+std::vector<Box> MedianCut(const Histogram &h) {
+    std::vector<Box> boxes(1);
+    boxes[0] = { { 0, 0, 0 }, { 31, 31, 31 }, 0 };
+    ShrinkBox(h, boxes[0]);
+
+    while ((int)boxes.size() < kMaxColors) {
+        int pick = -1;
+        for (int i = 0; i < (int)boxes.size(); ++i) {
+            const Box &b = boxes[i];
+            bool splittable = b.hi[0] > b.lo[0] || b.hi[1] > b.lo[1] || b.hi[2] > b.lo[2];
+            if (splittable && (pick < 0 || b.pop > boxes[pick].pop)) pick = i;
+        }
+        if (pick < 0) break;
+
+        Box box = boxes[pick];
+        int axis = 0;
+        for (int a = 1; a < 3; ++a)
+            if (box.hi[a] - box.lo[a] > box.hi[axis] - box.lo[axis]) axis = a;
+
+        // population of each slice along the axis
+        uint64_t slice[32] = {};
+        for (int r = box.lo[0]; r <= box.hi[0]; ++r)
+            for (int g = box.lo[1]; g <= box.hi[1]; ++g)
+                for (int b = box.lo[2]; b <= box.hi[2]; ++b) {
+                    int v[3] = { r, g, b };
+                    slice[v[axis]] += h.count[CellIndex(r, g, b)];
+                }
+
+        int split = box.lo[axis];
+        uint64_t acc = slice[split];
+        while (split + 1 < box.hi[axis] && acc * 2 < box.pop) acc += slice[++split];
+
+        Box a = box, b = box;
+        a.hi[axis] = split;
+        b.lo[axis] = split + 1;
+        ShrinkBox(h, a);
+        ShrinkBox(h, b);
+        boxes[pick] = a;
+        if (b.pop) boxes.push_back(b);
+    }
+    return boxes;
+}
+
+int BitDepthFor(size_t colors) {
+    if (colors <= 2) return 1;
+    if (colors <= 4) return 2;
+    if (colors <= 16) return 4;
+    return 8;
+}
+
+} // namespace
+
+uint8_t PaletteMap::Lookup(uint32_t flat) const {
+    if (!exact) return lut[CellOf(flat)];
+    uint32_t s = SlotOf(flat, kExactSlots);
+    while (keys[s] != flat) s = (s + 1) & (kExactSlots - 1);
+    return values[s];
+}
+
+void PaletteMap::MapRow(const uint8_t *rgba, int width, int y, uint8_t *dst) const {
+    const uint32_t *px = (const uint32_t *)rgba;
+    thread_local std::vector<uint8_t> idx;
+    idx.resize(width);
+
+    if (dither && !exact) {
+        const int *row = kBayer4[y & 3];
+        for (int x = 0; x < width; ++x) {
+            uint32_t flat = FlattenOverWhite(px[x]);
+            int d = row[x & 3] * 2 - 15;
+            int r = std::clamp((int)(flat & 0xFF) + d, 0, 255);
+            int g = std::clamp((int)((flat >> 8) & 0xFF) + d, 0, 255);
+            int b = std::clamp((int)((flat >> 16) & 0xFF) + d, 0, 255);
+            idx[x] = lut[CellIndex(r >> 3, g >> 3, b >> 3)];
+        }
+    } else {
+        uint32_t last = px[0];
+        uint8_t li = Lookup(FlattenOverWhite(last));
+        int x = 0;
+        while (x < width) {
+            if (x + 4 <= width && Run4(px + x, last)) {
+                std::memset(idx.data() + x, li, 4);
+                x += 4;
+                continue;
+            }
+            if (px[x] != last) {
+                last = px[x];
+                li = Lookup(FlattenOverWhite(last));
+            }
+            idx[x++] = li;
+        }
+    }
+
+    if (bitDepth == 8) {
+        std::memcpy(dst, idx.data(), width);
+        return;
+    }
+    int perByte = 8 / bitDepth;
+    std::memset(dst, 0, (width + perByte - 1) / perByte);
+    for (int x = 0; x < width; ++x)
+        dst[x / perByte] |= (uint8_t)(idx[x] << (8 - bitDepth * (x % perByte + 1)));
+}
+
+bool BuildPalette(const uint8_t *rgba, int width, int height, const PaletteOptions &opts, PaletteMap &out) {
+    out = PaletteMap();
+    if (opts.mode == PALETTE_OFF || width <= 0 || height <= 0) return false;
+    const uint32_t *px = (const uint32_t *)rgba;
+
+    // 1. exact colour count, stopping everyone as soon as 257 colours are seen
+    ColorSet all;
+    std::mutex mutex;
+    std::atomic<bool> stop{false};
+    ParallelFor("palette count", height, 64, [&](int y0, int y1) {
+        ColorSet local;
+        CountColors(px + (size_t)y0 * width, (size_t)(y1 - y0) * width, local, stop);
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t k : local.keys) if (k) all.Insert(k);
+        if (local.overflow || all.overflow) {
+            all.overflow = true;
+            stop = true;
+        }
+    });
+
+    if (!all.overflow) {
+        std::vector<uint32_t> colors;
+        for (uint32_t k : all.keys) if (k) colors.push_back(k);
+        std::sort(colors.begin(), colors.end());
+
+        out.exact = true;
+        out.keys.assign(PaletteMap::kExactSlots, 0);
+        out.values.assign(PaletteMap::kExactSlots, 0);
+        for (size_t i = 0; i < colors.size(); ++i) {
+            uint32_t c = colors[i];
+            out.palette.push_back((uint8_t)c);
+            out.palette.push_back((uint8_t)(c >> 8));
+            out.palette.push_back((uint8_t)(c >> 16));
+
+            uint32_t s = SlotOf(c, PaletteMap::kExactSlots);
+            while (out.keys[s] != 0) s = (s + 1) & (PaletteMap::kExactSlots - 1);
+            out.keys[s] = c;
+            out.values[s] = (uint8_t)i;
+        }
+        out.bitDepth = BitDepthFor(colors.size());
+        return true;
+    }
+    if (opts.mode != PALETTE_QUANTIZE) return false;
+
+    // 2. RGB555 histogram with per-cell colour sums, one per chunk (kept
+    //    large, since each local histogram is merged under the lock)
+    Histogram hist;
+    ParallelFor("palette histogram", height, 256, [&](int y0, int y1) {
+        Histogram local;
+        const uint32_t *p = px + (size_t)y0 * width;
+        size_t n = (size_t)(y1 - y0) * width;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t flat = FlattenOverWhite(p[i]);
+            int c = CellOf(flat);
+            local.count[c]++;
+            local.sum[c * 3 + 0] += flat & 0xFF;
+            local.sum[c * 3 + 1] += (flat >> 8) & 0xFF;
+            local.sum[c * 3 + 2] += (flat >> 16) & 0xFF;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        hist.Add(local);
+    });
+
+    // 3. median cut; each palette entry is the mean colour of its box
+    std::vector<Box> boxes = MedianCut(hist);
+    for (const Box &box : boxes) {
+        uint64_t sum[3] = {}, pop = 0;
+        for (int r = box.lo[0]; r <= box.hi[0]; ++r)
+            for (int g = box.lo[1]; g <= box.hi[1]; ++g)
+                for (int b = box.lo[2]; b <= box.hi[2]; ++b) {
+                    int c = CellIndex(r, g, b);
+                    pop += hist.count[c];
+                    for (int k = 0; k < 3; ++k) sum[k] += hist.sum[c * 3 + k];
+                }
+        for (int k = 0; k < 3; ++k) out.palette.push_back((uint8_t)((sum[k] + pop / 2) / std::max<uint64_t>(pop, 1)));
+    }
+
+    // 4. nearest palette entry for every cell (the cell's mean colour when it has pixels)
+    int colors = (int)out.palette.size() / 3;
+    out.lut.assign(kCells, 0);
+    ParallelFor("palette lut", kCells, 1024, [&](int c0, int c1) {
+        for (int c = c0; c < c1; ++c) {
+            int rgb[3] = { ((c >> 10) << 3) | 4, (((c >> 5) & 31) << 3) | 4, ((c & 31) << 3) | 4 };
+            if (hist.count[c])
+                for (int k = 0; k < 3; ++k) rgb[k] = (int)(hist.sum[c * 3 + k] / hist.count[c]);
+
+            int best = 0, bestDist = INT32_MAX;
+            for (int i = 0; i < colors; ++i) {
+                int dr = rgb[0] - out.palette[i * 3], dg = rgb[1] - out.palette[i * 3 + 1], db = rgb[2] - out.palette[i * 3 + 2];
+                int d = dr * dr + dg * dg + db * db;
+                if (d < bestDist) { bestDist = d; best = i; }
+            }
+            out.lut[c] = (uint8_t)best;
+        }
+    });
+
+    out.dither = opts.dither;
+    out.bitDepth = BitDepthFor(colors);
+    return true;
+}
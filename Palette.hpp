@@ -0,0 +1,48 @@
+// Palette.hpp
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Palette (indexed colour) export. Stroke drawings are usually a handful of
+// flat colours on white, which store far smaller as 1-8 bit indexed PNGs.
+
+enum PaletteMode {
+    PALETTE_OFF = 0,    // always write truecolour
+    PALETTE_EXACT,      // indexed only when the image has <= 256 colours
+    PALETTE_QUANTIZE    // exact when possible, otherwise median-cut to 256
+};
+
+struct PaletteOptions {
+    PaletteMode mode = PALETTE_EXACT;
+    bool dither = false;  // ordered dithering when quantizing
+};
+
+// Maps pixels of a straight-alpha RGBA image, flattened over white, to
+// palette indices. Read-only after BuildPalette, so MapRow may be called
+// from several threads at once.
+class PaletteMap {
+public:
+    std::vector<uint8_t> palette;  // RGB triplets
+    int bitDepth = 8;              // 1, 2, 4 or 8
+    bool exact = false;
+
+    // Writes one row of packed indices (PngRowBytes for `bitDepth`). `y` is
+    // the output row, used for the dither pattern.
+    void MapRow(const uint8_t *rgba, int width, int y, uint8_t *dst) const;
+
+private:
+    friend bool BuildPalette(const uint8_t *, int, int, const PaletteOptions &, PaletteMap &);
+
+    uint8_t Lookup(uint32_t flat) const;
+
+    static const int kExactSlots = 1024;
+    std::vector<uint32_t> keys;    // exact: open-addressed colour -> index
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> lut;      // quantized: RGB555 -> index
+    bool dither = false;
+};
+
+// Counts the colours of `rgba` (any row order) and builds the mapping.
+// Returns false when the image needs more than 256 colours and the options
+// do not allow quantizing.
+bool BuildPalette(const uint8_t *rgba, int width, int height, const PaletteOptions &opts, PaletteMap &out);
@@ -0,0 +1,347 @@
+// PngEncoder.cpp
+#include "PngEncoder.hpp"
+#include "Deflate.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+
+namespace {
+
+const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+const int kDictBytes = 32768;
+
+void PutU32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+bool WriteChunk(FILE *f, const char *type, const uint8_t *data, size_t len) {
+    uint8_t head[8];
+    PutU32(head, (uint32_t)len);
+    std::memcpy(head + 4, type, 4);
+    uint32_t crc = Crc32(0, head + 4, 4);
+    if (len) crc = Crc32(crc, data, len);
+    uint8_t tail[4];
+    PutU32(tail, crc);
+
+    return std::fwrite(head, 1, 8, f) == 8 &&
+           (len == 0 || std::fwrite(data, 1, len, f) == len) &&
+           std::fwrite(tail, 1, 4, f) == 4;
+}
+
+inline uint8_t Paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return (uint8_t)a;
+    return (uint8_t)((pb <= pc) ? b : c);
+}
+
+void FilterRow(int type, const uint8_t *cur, const uint8_t *prev, int rb, int bpp, uint8_t *dst) {
+    switch (type) {
+    case 0:
+        std::memcpy(dst, cur, rb);
+        break;
+    case 1:
+        for (int i = 0; i < bpp; ++i) dst[i] = cur[i];
+        for (int i = bpp; i < rb; ++i) dst[i] = (uint8_t)(cur[i] - cur[i - bpp]);
+        break;
+    case 2:
+        for (int i = 0; i < rb; ++i) dst[i] = (uint8_t)(cur[i] - prev[i]);
+        break;
+    case 3:
+        for (int i = 0; i < bpp; ++i) dst[i] = (uint8_t)(cur[i] - (prev[i] >> 1));
+        for (int i = bpp; i < rb; ++i) dst[i] = (uint8_t)(cur[i] - ((cur[i - bpp] + prev[i]) >> 1));
+        break;
+    case 4:
+        for (int i = 0; i < bpp; ++i) dst[i] = (uint8_t)(cur[i] - prev[i]);
+        for (int i = bpp; i < rb; ++i) dst[i] = (uint8_t)(cur[i] - Paeth(cur[i - bpp], prev[i], prev[i - bpp]));
+        break;
+    }
+}
+
+uint32_t SumAbs(const uint8_t *p, int n) {
+    uint32_t s = 0;
+    for (int i = 0; i < n; ++i) s += (uint32_t)std::abs((int)(int8_t)p[i]);
+    return s;
+}
+
+} // namespace
+
+struct PngBand {
+    int y0 = 0;
+    int rows = 0;
+    bool last = false;
+    std::vector<uint8_t> raw;   // unfiltered rows from RawStart(y0), filled by the worker if empty
+    std::vector<uint8_t> chunk; // finished IDAT chunk (length, type, data, crc)
+    uint32_t adler = 1;
+    size_t dataLen = 0;         // filtered bytes covered by `adler`
+    JobRef job;                 // null when processed inline
+};
+
+// Bands are queued in order, processed as pool jobs in any order and
+// written back out in order.
+class PngBandPipeline {
+public:
+    ~PngBandPipeline() { Drain(); if (file) std::fclose(file); }
+
+    bool Begin(const std::string &path, const PngFormat &f, const PngEncodeOptions &o,
+               std::atomic<float> *prog) {
+        fmt = f;
+        opts = o;
+        opts.level = std::clamp(opts.level, 0, 9);
+        progress = prog;
+        rowBytes = PngRowBytes(fmt);
+        bpp = std::max(1, rowBytes / std::max(1, fmt.width));
+        if (fmt.bitDepth < 8) bpp = 1;
+
+        // enough previous rows to prime the 32 KB deflate window
+        prefixRows = (opts.level > 0) ? (kDictBytes + rowBytes) / (rowBytes + 1) : 0;
+
+        int threads = opts.threads > 0 ? opts.threads : JobWorkerCount();
+        threads = std::max(1, threads);
+        parallel = threads > 1;
+        maxInFlight = threads * 2;
+
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+
+        uint8_t ihdr[13];
+        PutU32(ihdr, (uint32_t)fmt.width);
+        PutU32(ihdr + 4, (uint32_t)fmt.height);
+        ihdr[8] = (uint8_t)fmt.bitDepth;
+        ihdr[9] = (uint8_t)fmt.colorType;
+        ihdr[10] = 0; // deflate
+        ihdr[11] = 0; // adaptive filtering
+        ihdr[12] = 0; // no interlace
+
+        ok = std::fwrite(kPngSignature, 1, 8, file) == 8 && WriteChunk(file, "IHDR", ihdr, 13);
+        if (fmt.colorType == PNG_INDEXED) {
+            ok = ok && WriteChunk(file, "PLTE", fmt.palette.data(), fmt.palette.size());
+            if (!fmt.paletteAlpha.empty())
+                ok = ok && WriteChunk(file, "tRNS", fmt.paletteAlpha.data(), fmt.paletteAlpha.size());
+        }
+        return ok;
+    }
+
+    // First unfiltered row a band starting at y0 needs (dictionary + one row of filter context).
+    int RawStart(int y0) const {
+        int filterY0 = y0 - std::min(prefixRows, y0);
+        return filterY0 > 0 ? filterY0 - 1 : 0;
+    }
+
+    void Submit(std::unique_ptr<PngBand> band) {
+        PngBand *b = band.get();
+        if (parallel) b->job = RunJob("png band", [this, b] { Process(*b); });
+        else Process(*b);
+        inFlight.push_back(std::move(band));
+
+        WriteFinished(false);
+        while ((int)inFlight.size() > maxInFlight) WriteFinished(true);
+    }
+
+    bool End() {
+        while (!inFlight.empty()) WriteFinished(true);
+
+        uint8_t trailer[4];
+        PutU32(trailer, adler);
+        ok = ok && WriteChunk(file, "IDAT", trailer, 4);
+        ok = ok && WriteChunk(file, "IEND", nullptr, 0);
+        ok = (std::fclose(file) == 0) && ok;
+        file = nullptr;
+        if (progress) *progress = 1.0f;
+        return ok;
+    }
+
+    PngFormat fmt;
+    PngEncodeOptions opts;
+    PngRowSource source;  // fills band->raw when the band arrives empty
+    int rowBytes = 0;
+
+private:
+    static bool Done(const PngBand &b) { return !b.job || IsJobDone(b.job); }
+
+    // Band jobs point into this object, so none may outlive it.
+    void Drain() {
+        for (auto &b : inFlight)
+            if (b->job) WaitJob(b->job);
+    }
+
+    // Writes finished bands from the front of the queue; optionally waits for the first one.
+    void WriteFinished(bool wait) {
+        if (wait && !inFlight.empty() && inFlight.front()->job) WaitJob(inFlight.front()->job);
+
+        while (!inFlight.empty() && Done(*inFlight.front())) {
+            std::unique_ptr<PngBand> b = std::move(inFlight.front());
+            inFlight.pop_front();
+
+            ok = ok && std::fwrite(b->chunk.data(), 1, b->chunk.size(), file) == b->chunk.size();
+            adler = Adler32Combine(adler, b->adler, b->dataLen);
+            rowsWritten += b->rows;
+            if (progress) *progress = 0.99f * (float)rowsWritten / (float)std::max(1, fmt.height);
+        }
+    }
+
+    void Process(PngBand &b) {
+        const int rb = rowBytes;
+        const int stride = rb + 1;
+        const int dictRows = std::min(prefixRows, b.y0);
+        const int filterY0 = b.y0 - dictRows;
+        const int rawY0 = RawStart(b.y0);
+        const int rawRows = b.y0 + b.rows - rawY0;
+
+        if (b.raw.empty()) {
+            b.raw.resize((size_t)rawRows * rb);
+            source(rawY0, rawRows, b.raw.data());
+        }
+
+        std::vector<uint8_t> filtered((size_t)(dictRows + b.rows) * stride);
+        std::vector<uint8_t> zero(rb, 0);
+        std::vector<uint8_t> scratch;
+
+        bool adaptive = opts.level >= 3 && fmt.colorType != PNG_INDEXED && fmt.bitDepth >= 8;
+        int fixedType = (opts.level == 0 || fmt.colorType == PNG_INDEXED || fmt.bitDepth < 8) ? 0 : 2;
+        if (adaptive) scratch.resize((size_t)rb * 5);
+
+        for (int y = filterY0; y < b.y0 + b.rows; ++y) {
+            const uint8_t *cur = b.raw.data() + (size_t)(y - rawY0) * rb;
+            const uint8_t *prev = (y > 0) ? cur - rb : zero.data();
+            uint8_t *dst = filtered.data() + (size_t)(y - filterY0) * stride;
+
+            if (!adaptive) {
+                dst[0] = (uint8_t)fixedType;
+                FilterRow(fixedType, cur, prev, rb, bpp, dst + 1);
+                continue;
+            }
+
+            // minimum sum of absolute differences heuristic
+            int bestType = 0;
+            uint32_t bestSum = UINT32_MAX;
+            for (int t = 0; t < 5; ++t) {
+                uint8_t *s = scratch.data() + (size_t)t * rb;
+                FilterRow(t, cur, prev, rb, bpp, s);
+                uint32_t sum = SumAbs(s, rb);
+                if (sum < bestSum) { bestSum = sum; bestType = t; }
+            }
+            dst[0] = (uint8_t)bestType;
+            std::memcpy(dst + 1, scratch.data() + (size_t)bestType * rb, rb);
+        }
+        b.raw.clear();
+        b.raw.shrink_to_fit();
+
+        size_t dictLen = std::min((size_t)kDictBytes, (size_t)dictRows * stride);
+        const uint8_t *seg = filtered.data() + (size_t)dictRows * stride;
+        b.dataLen = (size_t)b.rows * stride;
+        b.adler = Adler32(1, seg, b.dataLen);
+
+        b.chunk.clear();
+        b.chunk.resize(8);
+        std::memcpy(b.chunk.data() + 4, "IDAT", 4);
+        if (b.y0 == 0) {
+            static const uint8_t kFlevel[10] = { 0x01, 0x01, 0x5E, 0x5E, 0x5E, 0x5E, 0x9C, 0xDA, 0xDA, 0xDA };
+            b.chunk.push_back(0x78);
+            b.chunk.push_back(kFlevel[opts.level]);
+        }
+        DeflateSegment(seg - dictLen, dictLen, b.dataLen, opts.level, b.last, b.chunk);
+
+        PutU32(b.chunk.data(), (uint32_t)(b.chunk.size() - 8));
+        uint32_t crc = Crc32(0, b.chunk.data() + 4, b.chunk.size() - 4);
+        b.chunk.resize(b.chunk.size() + 4);
+        PutU32(b.chunk.data() + b.chunk.size() - 4, crc);
+    }
+
+    FILE *file = nullptr;
+    bool ok = false;
+    int bpp = 1;
+    int prefixRows = 0;
+    int maxInFlight = 2;
+    int rowsWritten = 0;
+    uint32_t adler = 1;
+    std::atomic<float> *progress = nullptr;
+
+    bool parallel = false;
+    std::deque<std::unique_ptr<PngBand>> inFlight;
+};
+
+int PngRowBytes(const PngFormat &fmt) {
+    int channels = 1;
+    switch (fmt.colorType) {
+    case PNG_GRAY:    channels = 1; break;
+    case PNG_RGB:     channels = 3; break;
+    case PNG_INDEXED: channels = 1; break;
+    case PNG_RGBA:    channels = 4; break;
+    }
+    return (fmt.width * channels * fmt.bitDepth + 7) / 8;
+}
+
+bool EncodePng(const std::string &path, const PngFormat &fmt, const PngRowSource &rows,
+               const PngEncodeOptions &opts, std::atomic<float> *progress) {
+    if (fmt.width <= 0 || fmt.height <= 0) return false;
+
+    PngBandPipeline pipe;
+    pipe.source = rows;
+    if (!pipe.Begin(path, fmt, opts, progress)) return false;
+
+    int bandRows = opts.bandRows;
+    if (bandRows <= 0) bandRows = std::max(16, (1 << 20) / (pipe.rowBytes + 1));
+
+    for (int y = 0; y < fmt.height; y += bandRows) {
+        auto band = std::make_unique<PngBand>();
+        band->y0 = y;
+        band->rows = std::min(bandRows, fmt.height - y);
+        band->last = (y + band->rows == fmt.height);
+        pipe.Submit(std::move(band));
+    }
+    return pipe.End();
+}
+
+PngStreamWriter::PngStreamWriter() = default;
+PngStreamWriter::~PngStreamWriter() = default;
+
+bool PngStreamWriter::Open(const std::string &path, const PngFormat &fmt,
+                           const PngEncodeOptions &opts, std::atomic<float> *progress) {
+    if (fmt.width <= 0 || fmt.height <= 0) return false;
+    pipe = std::make_unique<PngBandPipeline>();
+    nextRow = 0;
+    tail.clear();
+    if (pipe->Begin(path, fmt, opts, progress)) return true;
+    pipe.reset();
+    return false;
+}
+
+bool PngStreamWriter::WriteRows(const uint8_t *rows, int count) {
+    if (!pipe || count <= 0 || nextRow + count > pipe->fmt.height) return false;
+    const size_t rb = (size_t)pipe->rowBytes;
+
+    // the band needs a few rows from earlier calls as filter/dictionary context
+    auto band = std::make_unique<PngBand>();
+    band->y0 = nextRow;
+    band->rows = count;
+    band->last = (nextRow + count == pipe->fmt.height);
+
+    int rawStart = pipe->RawStart(nextRow);
+    size_t keep = (size_t)(nextRow - rawStart) * rb;
+    band->raw.reserve(keep + (size_t)count * rb);
+    band->raw.assign(tail.end() - keep, tail.end());
+    band->raw.insert(band->raw.end(), rows, rows + (size_t)count * rb);
+
+    nextRow += count;
+    size_t tailRows = (size_t)(nextRow - pipe->RawStart(nextRow));
+    tail.assign(band->raw.end() - tailRows * rb, band->raw.end());
+
+    pipe->Submit(std::move(band));
+    return true;
+}
+
+bool PngStreamWriter::Close() {
+    if (!pipe) return false;
+    bool complete = (nextRow == pipe->fmt.height);
+    bool ok = pipe->End();
+    pipe.reset();
+    return complete && ok;
+}
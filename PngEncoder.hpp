@@ -0,0 +1,70 @@
+// PngEncoder.hpp
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Multi-threaded PNG writer. The image is split into row bands that are
+// filtered and deflated in parallel; each band is primed with the last 32 KB
+// of the band before it, so compression stays close to a single stream while
+// the result is one ordinary zlib stream inside the IDAT chunks.
+
+// IHDR colour types
+enum PngColorType {
+    PNG_GRAY = 0,
+    PNG_RGB = 2,
+    PNG_INDEXED = 3,
+    PNG_RGBA = 6
+};
+
+struct PngEncodeOptions {
+    int level = 6;     // compression vs speed: 0 = store, 1 = fastest ... 9 = smallest
+    int threads = 0;   // bands compressed at once: 0 = job pool size, 1 = inline
+    int bandRows = 0;  // rows per independently deflated band, 0 = auto
+};
+
+struct PngFormat {
+    int width = 0;
+    int height = 0;
+    PngColorType colorType = PNG_RGBA;
+    int bitDepth = 8;
+    std::vector<uint8_t> palette;       // RGB triplets, PNG_INDEXED only
+    std::vector<uint8_t> paletteAlpha;  // optional tRNS entries, PNG_INDEXED only
+};
+
+// Bytes in one packed row of `fmt` (without the filter byte).
+int PngRowBytes(const PngFormat &fmt);
+
+// Writes `count` packed rows starting at row `y` into `dst`. Called from
+// worker threads, in any order, and possibly more than once for a row.
+using PngRowSource = std::function<void(int y, int count, uint8_t *dst)>;
+
+// Encodes the whole image and writes it to `path`. `progress`, if given, is
+// advanced from 0 to 1 as bands are written.
+bool EncodePng(const std::string &path, const PngFormat &fmt, const PngRowSource &rows,
+               const PngEncodeOptions &opts, std::atomic<float> *progress = nullptr);
+
+class PngBandPipeline;
+
+// Streaming variant for images produced a strip at a time (tiled export).
+// Rows arrive top to bottom; each WriteRows call becomes one band that is
+// compressed in the background while the caller produces the next strip.
+// WriteRows blocks once enough bands are in flight, which bounds memory.
+class PngStreamWriter {
+public:
+    PngStreamWriter();
+    ~PngStreamWriter();
+
+    bool Open(const std::string &path, const PngFormat &fmt, const PngEncodeOptions &opts,
+              std::atomic<float> *progress = nullptr);
+    bool WriteRows(const uint8_t *rows, int count);  // `count` packed rows, copied
+    bool Close();                                     // false if rows are missing or a write failed
+
+private:
+    std::unique_ptr<PngBandPipeline> pipe;
+    std::vector<uint8_t> tail;  // last rows written, context for the next band
+    int nextRow = 0;
+};
@@ -0,0 +1,171 @@
+// Resample.cpp
+#include "Resample.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Weights of one axis: output pixel i reads `count[i]` source pixels from
+// `first[i]` on, with `taps` weight slots each.
+struct AxisFilter {
+    int taps = 0;
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<float> weights;
+};
+
+float FilterRadius(ResampleFilter filter) {
+    return filter == RESAMPLE_LANCZOS3 ? 3.0f : 1.0f;
+}
+
+float Kernel(ResampleFilter filter, float x) {
+    x = fabsf(x);
+    if (filter == RESAMPLE_BILINEAR) return x < 1.0f ? 1.0f - x : 0.0f;
+    if (x < 1e-5f) return 1.0f;
+    if (x >= 3.0f) return 0.0f;
+    float px = PI * x;
+    return 3.0f * sinf(px) * sinf(px / 3.0f) / (px * px);
+}
+
+AxisFilter MakeAxisFilter(int srcSize, int dstSize, ResampleFilter filter) {
+    AxisFilter a;
+    float scale = (float)srcSize / (float)dstSize;
+    float stretch = std::max(1.0f, scale);
+    float support = FilterRadius(filter) * stretch;
+    a.taps = (int)ceilf(support * 2.0f) + 1;
+    a.first.resize(dstSize);
+    a.count.resize(dstSize);
+    a.weights.assign((size_t)dstSize * a.taps, 0.0f);
+
+    for (int i = 0; i < dstSize; ++i) {
+        float center = (i + 0.5f) * scale;
+        int lo = std::max(0, (int)floorf(center - support));
+        int hi = std::min(srcSize, (int)ceilf(center + support));
+        hi = std::min(hi, lo + a.taps);
+
+        float *w = &a.weights[(size_t)i * a.taps];
+        float sum = 0.0f;
+        for (int j = lo; j < hi; ++j) {
+            w[j - lo] = Kernel(filter, (j + 0.5f - center) / stretch);
+            sum += w[j - lo];
+        }
+        // taps cut off at the image edges are given back to the rest
+        if (sum != 0.0f)
+            for (int k = 0; k < hi - lo; ++k) w[k] /= sum;
+        a.first[i] = lo;
+        a.count[i] = hi - lo;
+    }
+    return a;
+}
+
+// weighted sum of `count` RGBA float pixels
+#if defined(__SSE2__)
+inline void Accumulate(const float *px, const float *w, int count, float *out) {
+    __m128 acc = _mm_setzero_ps();
+    for (int k = 0; k < count; ++k)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(px + k * 4), _mm_set1_ps(w[k])));
+    _mm_storeu_ps(out, acc);
+}
+#else
+inline void Accumulate(const float *px, const float *w, int count, float *out) {
+    float acc[4] = { 0, 0, 0, 0 };
+    for (int k = 0; k < count; ++k)
+        for (int c = 0; c < 4; ++c) acc[c] += px[k * 4 + c] * w[k];
+    for (int c = 0; c < 4; ++c) out[c] = acc[c];
+}
+#endif
+
+void PremultiplyToFloat(const uint8_t *src, int count, float *dst) {
+    for (int i = 0; i < count; ++i) {
+        float a = src[i * 4 + 3];
+        float s = a * (1.0f / 255.0f);
+        dst[i * 4 + 0] = src[i * 4 + 0] * s;
+        dst[i * 4 + 1] = src[i * 4 + 1] * s;
+        dst[i * 4 + 2] = src[i * 4 + 2] * s;
+        dst[i * 4 + 3] = a;
+    }
+}
+
+// acc[j] += in[j] * w over `n` floats (a multiple of 4)
+inline void AccumulateRow(float *acc, const float *in, float w, int n) {
+    int j = 0;
+#if defined(__SSE2__)
+    const __m128 wv = _mm_set1_ps(w);
+    for (; j < n; j += 4)
+        _mm_storeu_ps(acc + j, _mm_add_ps(_mm_loadu_ps(acc + j), _mm_mul_ps(_mm_loadu_ps(in + j), wv)));
+#endif
+    for (; j < n; ++j) acc[j] += in[j] * w;
+}
+
+inline uint8_t ToByte(float v) {
+    return (uint8_t)std::clamp(v + 0.5f, 0.0f, 255.0f);
+}
+
+void UnpremultiplyToBytes(const float *src, int count, uint8_t *dst) {
+    for (int i = 0; i < count; ++i) {
+        const float *p = src + i * 4;
+        float a = std::clamp(p[3], 0.0f, 255.0f);
+        if (a < 0.5f) {
+            dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = dst[i * 4 + 3] = 0;
+            continue;
+        }
+        float s = 255.0f / a;
+        dst[i * 4 + 0] = ToByte(p[0] * s);
+        dst[i * 4 + 1] = ToByte(p[1] * s);
+        dst[i * 4 + 2] = ToByte(p[2] * s);
+        dst[i * 4 + 3] = ToByte(a);
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const BackgroundSnapshot> ResampleBackground(const BackgroundSnapshot &src, int dstW, int dstH,
+                                                             ResampleFilter filter) {
+    if (dstW <= 0 || dstH <= 0 || src.width <= 0 || src.height <= 0) return nullptr;
+
+    const AxisFilter hf = MakeAxisFilter(src.width, dstW, filter);
+    const AxisFilter vf = MakeAxisFilter(src.height, dstH, filter);
+
+    return BuildBackground(dstW, dstH, [&](const BackgroundTileEdit &t) {
+        // the block of source pixels this tile reads
+        int x1 = t.x0 + t.width - 1, y1 = t.y0 + t.height - 1;
+        int sx0 = hf.first[t.x0], sx1 = hf.first[x1] + hf.count[x1];
+        int sy0 = vf.first[t.y0], sy1 = vf.first[y1] + vf.count[y1];
+        int sw = sx1 - sx0;
+
+        thread_local std::vector<uint8_t> raw;
+        thread_local std::vector<float> row, block, acc;
+        raw.resize((size_t)sw * 4);
+        row.resize((size_t)sw * 4);
+        block.resize((size_t)(sy1 - sy0) * t.width * 4);
+        acc.resize((size_t)t.width * 4);
+
+        // horizontal: every source row of the block down to the tile's width
+        for (int y = sy0; y < sy1; ++y) {
+            src.ReadRow(y, sx0, sw, raw.data());
+            PremultiplyToFloat(raw.data(), sw, row.data());
+            float *out = block.data() + (size_t)(y - sy0) * t.width * 4;
+            for (int x = 0; x < t.width; ++x) {
+                int i = t.x0 + x;
+                Accumulate(row.data() + (size_t)(hf.first[i] - sx0) * 4, &hf.weights[(size_t)i * hf.taps],
+                           hf.count[i], out + x * 4);
+            }
+        }
+
+        // vertical: whole filtered rows at a time
+        const int n = t.width * 4;
+        for (int y = 0; y < t.height; ++y) {
+            int i = t.y0 + y;
+            const float *w = &vf.weights[(size_t)i * vf.taps];
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (int k = 0; k < vf.count[i]; ++k)
+                AccumulateRow(acc.data(), block.data() + (size_t)(vf.first[i] + k - sy0) * n, w[k], n);
+            UnpremultiplyToBytes(acc.data(), t.width, t.rgba + (size_t)y * t.width * 4);
+        }
+    });
+}
@@ -0,0 +1,22 @@
+// Resample.hpp
+#pragma once
+#include <memory>
+#include "Document.hpp"
+
+// Background scaling for Change Canvas Size.
+//
+// The filter is separable: each output tile of the new background first
+// filters the source rows it needs horizontally, then filters that block
+// vertically. Tiles run in parallel on the job pool and pixels are filtered
+// premultiplied, four channels per SSE register, so transparent areas do not
+// bleed dark fringes into their neighbours.
+
+enum ResampleFilter {
+    RESAMPLE_BILINEAR = 0,
+    RESAMPLE_LANCZOS3
+};
+
+// `src` scaled to `dstW` x `dstH`. When shrinking, the filter is widened to
+// cover every source pixel. Any thread.
+std::shared_ptr<const BackgroundSnapshot> ResampleBackground(const BackgroundSnapshot &src, int dstW, int dstH,
+                                                             ResampleFilter filter);
@@ -0,0 +1,365 @@
+// Selection.cpp
+#include "Selection.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int kTile = BackgroundSnapshot::kTileSize;
+
+// Bits [from, to) of a word, 0 <= from < to <= 64.
+inline uint64_t SpanBits(int from, int to) {
+    uint64_t upto = (to >= 64) ? ~0ull : (1ull << to) - 1;
+    return upto & ~((1ull << from) - 1);
+}
+
+// Calls fn(x0, x1) for every run [x0, x1) of set bits in `words` words.
+template <typename Fn>
+void ForEachRun(const uint64_t *row, int words, Fn fn) {
+    int start = -1;
+    for (int i = 0; i < words; ++i) {
+        const uint64_t w = row[i];
+        int pos = 0;
+        while (pos < 64) {
+            // the next bit that differs from the run we are in (or not in)
+            uint64_t rest = (start < 0 ? w : ~w) >> pos;
+            if (!rest) break;
+            pos += __builtin_ctzll(rest);
+            if (start < 0) {
+                start = i * 64 + pos;
+            } else {
+                fn(start, i * 64 + pos);
+                start = -1;
+            }
+        }
+    }
+    if (start >= 0) fn(start, words * 64);
+}
+
+// First pixel whose centre is at or right of `x`.
+inline int PixelAtOrAfter(float x) {
+    return (int)ceilf(x - 0.5f);
+}
+
+// Puts back the pixels of a tile the selection does not cover, from
+// `original` (the tile as it was, same layout). Tiles start on a multiple of
+// 256 columns, so each tile row is a whole number of mask words.
+void RestoreUnselected(const SelectionMask &mask, const BackgroundTileEdit &t, const uint8_t *original) {
+    const int firstWord = t.x0 / 64;
+    for (int y = 0; y < t.height; ++y) {
+        const size_t rowOffset = (size_t)y * t.width * 4;
+        const int my = t.y0 + y;
+        const uint64_t *bits = (my < mask.Height()) ? mask.Row(my) : nullptr;
+        for (int x = 0; x < t.width; x += 64) {
+            const int n = std::min(64, t.width - x);
+            const int word = firstWord + x / 64;
+            uint64_t w = (bits && word < mask.WordsPerRow()) ? bits[word] : 0;
+            const uint64_t all = SpanBits(0, n);
+            w &= all;
+            if (w == all) continue;
+
+            const size_t offset = rowOffset + (size_t)x * 4;
+            if (w == 0) {
+                memcpy(t.rgba + offset, original + offset, (size_t)n * 4);
+                continue;
+            }
+            for (uint64_t keep = ~w & all; keep; keep &= keep - 1) {
+                size_t p = offset + (size_t)__builtin_ctzll(keep) * 4;
+                memcpy(t.rgba + p, original + p, 4);
+            }
+        }
+    }
+}
+
+// Selection coverage of tile (tx, ty) of an image `width` x `height`.
+SelectionCoverage TileCoverage(const SelectionMask &mask, int tx, int ty, int width, int height) {
+    return mask.Coverage(tx * kTile, ty * kTile, std::min(width, (tx + 1) * kTile), std::min(height, (ty + 1) * kTile));
+}
+
+} // namespace
+
+SelectionMask::SelectionMask(int width, int height)
+    : width(std::max(0, width)), height(std::max(0, height)), words((this->width + 63) / 64),
+      bits((size_t)words * this->height, 0) {
+}
+
+bool SelectionMask::Get(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) return false;
+    return (Row(y)[x >> 6] >> (x & 63)) & 1;
+}
+
+void SelectionMask::SelectSpan(int y, int x0, int x1) {
+    FillSpan(y, x0, x1);
+    Changed();
+}
+
+void SelectionMask::FillSpan(int y, int x0, int x1) {
+    if (y < 0 || y >= height) return;
+    x0 = std::max(0, x0);
+    x1 = std::min(width, x1);
+    if (x0 >= x1) return;
+
+    uint64_t *row = bits.data() + (size_t)y * words;
+    int w0 = x0 >> 6, w1 = (x1 - 1) >> 6;
+    if (w0 == w1) {
+        row[w0] |= SpanBits(x0 & 63, ((x1 - 1) & 63) + 1);
+    } else {
+        row[w0] |= SpanBits(x0 & 63, 64);
+        for (int w = w0 + 1; w < w1; ++w) row[w] = ~0ull;
+        row[w1] |= SpanBits(0, ((x1 - 1) & 63) + 1);
+    }
+}
+
+void SelectionMask::Combine(const SelectionMask &shape, SelectionOp op) {
+    if (shape.width != width || shape.height != height) return;
+    if (op == SELECTION_REPLACE) {
+        bits = shape.bits;
+        Changed();
+        return;
+    }
+
+    const size_t perRow = (size_t)words;
+    ParallelFor("combine selection", height, 256, [&](int y0, int y1) {
+        uint64_t *dst = bits.data() + y0 * perRow;
+        const uint64_t *src = shape.bits.data() + y0 * perRow;
+        const size_t n = (size_t)(y1 - y0) * perRow;
+        switch (op) {
+            case SELECTION_ADD: for (size_t i = 0; i < n; ++i) dst[i] |= src[i]; break;
+            case SELECTION_SUBTRACT: for (size_t i = 0; i < n; ++i) dst[i] &= ~src[i]; break;
+            case SELECTION_INTERSECT: for (size_t i = 0; i < n; ++i) dst[i] &= src[i]; break;
+            default: break;
+        }
+    });
+    Changed();
+}
+
+void SelectionMask::Invert() {
+    for (uint64_t &w : bits) w = ~w;
+    ClearPadding();
+    Changed();
+}
+
+// Keeps the bits past the last column zero, which Empty(), Coverage() and
+// the outline rely on.
+void SelectionMask::ClearPadding() {
+    if ((width & 63) == 0) return;
+    const uint64_t keep = SpanBits(0, width & 63);
+    for (int y = 0; y < height; ++y) bits[(size_t)y * words + words - 1] &= keep;
+}
+
+bool SelectionMask::Empty() const {
+    return std::all_of(bits.begin(), bits.end(), [](uint64_t w) { return w == 0; });
+}
+
+SelectionCoverage SelectionMask::Coverage(int x0, int y0, int x1, int y1) const {
+    bool all = x0 >= 0 && y0 >= 0 && x1 <= width && y1 <= height;
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(width, x1);
+    y1 = std::min(height, y1);
+    if (x0 >= x1 || y0 >= y1) return SELECTION_COVERS_NONE;
+
+    const int w0 = x0 >> 6, w1 = (x1 - 1) >> 6;
+    const uint64_t first = SpanBits(x0 & 63, w0 == w1 ? ((x1 - 1) & 63) + 1 : 64);
+    const uint64_t last = SpanBits(0, ((x1 - 1) & 63) + 1);
+    bool any = false;
+    for (int y = y0; y < y1; ++y) {
+        const uint64_t *row = Row(y);
+        for (int w = w0; w <= w1; ++w) {
+            uint64_t want = (w == w0) ? first : (w == w1) ? last : ~0ull;
+            uint64_t got = row[w] & want;
+            any |= got != 0;
+            all &= got == want;
+        }
+        if (any && !all) return SELECTION_COVERS_SOME;
+    }
+    return all ? SELECTION_COVERS_ALL : any ? SELECTION_COVERS_SOME : SELECTION_COVERS_NONE;
+}
+
+bool SelectionMask::Bounds(int &x0, int &y0, int &x1, int &y1) const {
+    x0 = width;
+    y0 = height;
+    x1 = y1 = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint64_t *row = Row(y);
+        for (int w = 0; w < words; ++w) {
+            if (!row[w]) continue;
+            x0 = std::min(x0, w * 64 + __builtin_ctzll(row[w]));
+            break;
+        }
+        for (int w = words - 1; w >= 0; --w) {
+            if (!row[w]) continue;
+            x1 = std::max(x1, w * 64 + 64 - __builtin_clzll(row[w]));
+            y0 = std::min(y0, y);
+            y1 = y + 1;
+            break;
+        }
+    }
+    return x0 < x1 && y0 < y1;
+}
+
+SelectionMask SelectionMask::Resized(int w, int h) const {
+    SelectionMask out(w, h);
+    if (IsNull() || out.IsNull() || h <= 0) return out;
+    std::vector<int> column(w);
+    for (int x = 0; x < w; ++x) column[x] = std::min(width - 1, (int)(((int64_t)x * 2 + 1) * width / (2 * w)));
+    for (int y = 0; y < h; ++y) {
+        const uint64_t *src = Row(std::min(height - 1, (int)(((int64_t)y * 2 + 1) * height / (2 * h))));
+        uint64_t *dst = out.bits.data() + (size_t)y * out.words;
+        for (int x = 0; x < w; ++x)
+            if ((src[column[x] >> 6] >> (column[x] & 63)) & 1) dst[x >> 6] |= 1ull << (x & 63);
+    }
+    return out;
+}
+
+// The outline is every boundary between a selected and an unselected pixel
+// (or the canvas edge): horizontal runs come from XOR-ing neighbouring rows,
+// vertical ones from XOR-ing a row with itself shifted by one column, and
+// vertical unit edges are joined down the rows.
+const std::vector<SelectionEdge> &SelectionMask::Edges() const {
+    if (edgesValid) return edges;
+    edges.clear();
+    edgesValid = true;
+    if (IsNull()) return edges;
+
+    std::vector<uint64_t> diff(words);
+    for (int y = 0; y <= height; ++y) {
+        for (int w = 0; w < words; ++w)
+            diff[w] = (y > 0 ? Row(y - 1)[w] : 0) ^ (y < height ? Row(y)[w] : 0);
+        ForEachRun(diff.data(), words, [&](int x0, int x1) {
+            edges.push_back({ { (float)x0, (float)y }, { (float)x1, (float)y } });
+        });
+    }
+
+    // (x << 32 | y) for each vertical edge left of column x on row y
+    std::vector<uint64_t> unit;
+    for (int y = 0; y < height; ++y) {
+        const uint64_t *row = Row(y);
+        uint64_t carry = 0;
+        for (int w = 0; w < words; ++w) {
+            for (uint64_t t = row[w] ^ ((row[w] << 1) | carry); t; t &= t - 1)
+                unit.push_back((uint64_t)(w * 64 + __builtin_ctzll(t)) << 32 | (uint32_t)y);
+            carry = row[w] >> 63;
+        }
+        // a selection running to the last column of a full last word
+        if (carry) unit.push_back((uint64_t)(words * 64) << 32 | (uint32_t)y);
+    }
+    std::sort(unit.begin(), unit.end());
+    for (size_t i = 0; i < unit.size();) {
+        size_t j = i + 1;
+        while (j < unit.size() && unit[j] == unit[j - 1] + 1) ++j;
+        float x = (float)(unit[i] >> 32);
+        edges.push_back({ { x, (float)(uint32_t)unit[i] }, { x, (float)((uint32_t)unit[j - 1] + 1) } });
+        i = j;
+    }
+    return edges;
+}
+
+SelectionMask RectangleSelection(int width, int height, Rectangle r) {
+    SelectionMask mask(width, height);
+    int x0 = PixelAtOrAfter(r.x), x1 = PixelAtOrAfter(r.x + r.width);
+    int y0 = std::max(0, PixelAtOrAfter(r.y)), y1 = std::min(height, PixelAtOrAfter(r.y + r.height));
+    for (int y = y0; y < y1; ++y) mask.SelectSpan(y, x0, x1);
+    return mask;
+}
+
+SelectionMask EllipseSelection(int width, int height, Rectangle bounds) {
+    SelectionMask mask(width, height);
+    const float a = bounds.width * 0.5f, b = bounds.height * 0.5f;
+    if (a <= 0.0f || b <= 0.0f) return mask;
+    const float cx = bounds.x + a, cy = bounds.y + b;
+
+    int y0 = std::max(0, PixelAtOrAfter(bounds.y)), y1 = std::min(height, PixelAtOrAfter(bounds.y + bounds.height));
+    ParallelFor("ellipse selection", y1 - y0, 256, [&](int i0, int i1) {
+        for (int y = y0 + i0; y < y0 + i1; ++y) {
+            float dy = (y + 0.5f - cy) / b;
+            if (dy * dy >= 1.0f) continue;
+            float half = a * sqrtf(1.0f - dy * dy);
+            mask.FillSpan(y, PixelAtOrAfter(cx - half), PixelAtOrAfter(cx + half));
+        }
+    });
+    return mask;
+}
+
+SelectionMask PolygonSelection(int width, int height, const std::vector<Vector2> &points) {
+    SelectionMask mask(width, height);
+    if (points.size() < 3) return mask;
+
+    // non-horizontal edges, top end first, sorted by top
+    struct Edge { float y0, y1, x0, slope; };
+    std::vector<Edge> edges;
+    float top = height, bottom = 0.0f;
+    for (size_t i = 0; i < points.size(); ++i) {
+        Vector2 p = points[i], q = points[(i + 1) % points.size()];
+        if (p.y == q.y) continue;
+        if (p.y > q.y) std::swap(p, q);
+        edges.push_back({ p.y, q.y, p.x, (q.x - p.x) / (q.y - p.y) });
+        top = std::min(top, p.y);
+        bottom = std::max(bottom, q.y);
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge &l, const Edge &r) { return l.y0 < r.y0; });
+
+    int y0 = std::max(0, PixelAtOrAfter(top)), y1 = std::min(height, PixelAtOrAfter(bottom));
+    ParallelFor("polygon selection", y1 - y0, 64, [&](int i0, int i1) {
+        // edges crossing this band of rows
+        const float bandTop = y0 + i0 + 0.5f, bandBottom = y0 + i1 - 0.5f;
+        std::vector<const Edge *> band;
+        for (const Edge &e : edges) {
+            if (e.y0 > bandBottom) break;
+            if (e.y1 > bandTop) band.push_back(&e);
+        }
+
+        std::vector<float> xs;
+        for (int y = y0 + i0; y < y0 + i1; ++y) {
+            const float yc = y + 0.5f;
+            xs.clear();
+            for (const Edge *e : band)
+                if (e->y0 <= yc && yc < e->y1) xs.push_back(e->x0 + (yc - e->y0) * e->slope);
+            std::sort(xs.begin(), xs.end());
+            // even-odd: inside between each pair of crossings
+            for (size_t k = 0; k + 1 < xs.size(); k += 2)
+                mask.FillSpan(y, PixelAtOrAfter(xs[k]), PixelAtOrAfter(xs[k + 1]));
+        }
+    });
+    return mask;
+}
+
+std::shared_ptr<const BackgroundSnapshot> BuildBackgroundWithin(const BackgroundSnapshot &src, const SelectionMask *within,
+                                                                const std::function<void(const BackgroundTileEdit &)> &fill) {
+    if (!within || within->IsNull()) return BuildBackground(src.width, src.height, fill);
+    const int width = src.width, height = src.height;
+
+    return RebuildBackground(src, [&](int tx, int ty) {
+        return TileCoverage(*within, tx, ty, width, height) == SELECTION_COVERS_NONE;
+    }, [&](const BackgroundTileEdit &t) {
+        fill(t);
+        if (TileCoverage(*within, t.x0 / kTile, t.y0 / kTile, width, height) != SELECTION_COVERS_ALL) {
+            const auto &original = src.tiles[(size_t)(t.y0 / kTile) * src.tilesX + t.x0 / kTile]->rgba;
+            RestoreUnselected(*within, t, original.data());
+        }
+    });
+}
+
+void EditBackgroundWithin(const SelectionMask *within, int x0, int y0, int x1, int y1,
+                          const std::function<void(const BackgroundTileEdit &)> &edit) {
+    if (!within || within->IsNull()) {
+        EditBackground(x0, y0, x1, y1, edit);
+        return;
+    }
+    const int width = BackgroundWidth(), height = BackgroundHeight();
+
+    EditBackground(x0, y0, x1, y1, [&](const BackgroundTileEdit &t) {
+        if (TileCoverage(*within, t.x0 / kTile, t.y0 / kTile, width, height) == SELECTION_COVERS_ALL) {
+            edit(t);
+            return;
+        }
+        thread_local std::vector<uint8_t> original;
+        original.assign(t.rgba, t.rgba + (size_t)t.width * t.height * 4);
+        edit(t);
+        RestoreUnselected(*within, t, original.data());
+    }, [&](int tx, int ty) {
+        return TileCoverage(*within, tx, ty, width, height) == SELECTION_COVERS_NONE;
+    });
+}
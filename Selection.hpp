@@ -0,0 +1,107 @@
+// Selection.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Document.hpp"
+
+// Pixel selections for the background image.
+//
+// A selection is a bit mask, one bit per canvas pixel packed into 64-bit
+// words per row, so a 4000 x 3000 canvas takes 1.5 MB. Shapes are
+// rasterized one row span at a time (the lasso with an even-odd scanline
+// fill), and combining two selections is a word-wise and/or/and-not over
+// the rows. Pixel operations ask which background tiles the mask touches
+// at all and leave the rest untouched, not even copied for undo. The
+// outline is traced from the mask once per change into a list of edge
+// segments that is drawn every frame.
+
+enum SelectionOp {
+    SELECTION_REPLACE = 0,
+    SELECTION_ADD,
+    SELECTION_SUBTRACT,
+    SELECTION_INTERSECT
+};
+
+// How much of an area a selection covers.
+enum SelectionCoverage {
+    SELECTION_COVERS_NONE = 0,
+    SELECTION_COVERS_SOME,
+    SELECTION_COVERS_ALL
+};
+
+// One outline segment in document pixels; either horizontal or vertical.
+struct SelectionEdge {
+    Vector2 a, b;
+};
+
+class SelectionMask {
+public:
+    SelectionMask() = default;
+    SelectionMask(int width, int height);  // nothing selected
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int WordsPerRow() const { return words; }
+    // A default-constructed mask: no selection, so everything is editable.
+    bool IsNull() const { return width == 0; }
+
+    const uint64_t *Row(int y) const { return bits.data() + (size_t)y * words; }
+    bool Get(int x, int y) const;
+
+    // Selects columns [x0, x1) of row `y`, clipped to the mask.
+    void SelectSpan(int y, int x0, int x1);
+    // Combines `shape` (same size) into this mask.
+    void Combine(const SelectionMask &shape, SelectionOp op);
+    void Invert();
+
+    // Whether nothing is selected at all.
+    bool Empty() const;
+    // How much of [x0, x1) x [y0, y1) is selected; area outside the mask
+    // counts as unselected.
+    SelectionCoverage Coverage(int x0, int y0, int x1, int y1) const;
+    // Bounds of the selected pixels as [x0, x1) x [y0, y1); false if none.
+    bool Bounds(int &x0, int &y0, int &x1, int &y1) const;
+
+    // The mask sampled (nearest) at another size, for previews.
+    SelectionMask Resized(int w, int h) const;
+
+    // The outline; traced on the first call after a change.
+    const std::vector<SelectionEdge> &Edges() const;
+
+private:
+    int width = 0;
+    int height = 0;
+    int words = 0;
+    std::vector<uint64_t> bits;
+
+    mutable bool edgesValid = false;
+    mutable std::vector<SelectionEdge> edges;
+
+    void Changed() { edgesValid = false; }
+    void ClearPadding();
+    // SelectSpan without touching the outline cache, so the shape builders
+    // can fill different rows from several threads
+    void FillSpan(int y, int x0, int x1);
+
+    friend SelectionMask EllipseSelection(int width, int height, Rectangle bounds);
+    friend SelectionMask PolygonSelection(int width, int height, const std::vector<Vector2> &points);
+};
+
+// Shapes on a `width` x `height` canvas; a pixel is inside when its centre is.
+SelectionMask RectangleSelection(int width, int height, Rectangle r);
+SelectionMask EllipseSelection(int width, int height, Rectangle bounds);
+// Even-odd fill of the closed polygon through `points`.
+SelectionMask PolygonSelection(int width, int height, const std::vector<Vector2> &points);
+
+// Background edits limited to a selection; a null or IsNull() selection
+// means the whole image. Tiles with nothing selected are skipped (shared
+// with `src` / left uncopied), and in partly selected tiles the unselected
+// pixels are put back after `fill` / `edit` ran.
+std::shared_ptr<const BackgroundSnapshot> BuildBackgroundWithin(const BackgroundSnapshot &src, const SelectionMask *within,
+                                                                const std::function<void(const BackgroundTileEdit &)> &fill);
+// Main thread only, like EditBackground.
+void EditBackgroundWithin(const SelectionMask *within, int x0, int y0, int x1, int y1,
+                          const std::function<void(const BackgroundTileEdit &)> &edit);
@@ -0,0 +1,203 @@
+// StrokeFlatten.cpp
+#include "StrokeFlatten.hpp"
+#include "BrushEngine.hpp"
+#include "StrokeLod.hpp"
+#include "raymath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int kTile = BackgroundSnapshot::kTileSize;
+
+// A stroke ready to paint: its lines (the source and each symmetric copy)
+// or its dabs, worked out once and read by every tile job.
+struct PreparedStroke {
+    const CanvasStroke *stroke;
+    std::vector<std::vector<Vector2>> lines;
+    std::vector<BrushDab> dabs;
+};
+
+bool Overlaps(const Rectangle &b, int x0, int y0, int x1, int y1) {
+    return b.x < x1 && b.x + b.width > x0 && b.y < y1 && b.y + b.height > y0;
+}
+
+// Straight-alpha "over" of `color` at `sa` onto one pixel.
+inline void Over(uint8_t *px, float sa, Color color) {
+    float da = px[3] * (1.0f / 255.0f);
+    float oa = sa + da * (1.0f - sa);
+    float k = da * (1.0f - sa);
+    px[0] = (uint8_t)((color.r * sa + px[0] * k) / oa + 0.5f);
+    px[1] = (uint8_t)((color.g * sa + px[1] * k) / oa + 0.5f);
+    px[2] = (uint8_t)((color.b * sa + px[2] * k) / oa + 0.5f);
+    px[3] = (uint8_t)(oa * 255.0f + 0.5f);
+}
+
+// `color` at `alpha` per pixel onto the tile.
+void Composite(const BackgroundTileEdit &t, const float *alpha, Color color) {
+    for (int i = 0; i < t.width * t.height; ++i)
+        if (alpha[i] > 0.0f) Over(t.rgba + (size_t)i * 4, alpha[i], color);
+}
+
+// A line the way DrawStrokePoints draws it: a DrawLineEx segment, then a
+// disc on every point after the first. Each piece is blended over the tile
+// in turn, at `color` times its coverage, so a translucent line darkens
+// where pieces overlap just as the GPU stacks them.
+void PaintLine(const BackgroundTileEdit &t, const std::vector<Vector2> &points, float r, Color color) {
+    const float alpha = color.a / 255.0f;
+    // one piece inside the box around lo..hi
+    auto piece = [&](Vector2 lo, Vector2 hi, auto coverage) {
+        int x0 = std::max(t.x0, (int)floorf(lo.x - r - 1.0f));
+        int y0 = std::max(t.y0, (int)floorf(lo.y - r - 1.0f));
+        int x1 = std::min(t.x0 + t.width, (int)ceilf(hi.x + r + 1.0f));
+        int y1 = std::min(t.y0 + t.height, (int)ceilf(hi.y + r + 1.0f));
+        for (int y = y0; y < y1; ++y) {
+            uint8_t *row = t.rgba + ((size_t)(y - t.y0) * t.width - t.x0) * 4;
+            for (int x = x0; x < x1; ++x) {
+                float c = coverage(x + 0.5f, y + 0.5f);
+                if (c > 0.0f) Over(row + (size_t)x * 4, c * alpha, color);
+            }
+        }
+    };
+
+    for (size_t i = 1; i < points.size(); ++i) {
+        Vector2 a = points[i - 1], b = points[i];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len = sqrtf(dx * dx + dy * dy);
+        if (len > 0.0f) {
+            // the segment's rectangle: across, then along
+            float nx = dx / len, ny = dy / len;
+            piece(Vector2Min(a, b), Vector2Max(a, b), [&](float px, float py) {
+                float fx = px - a.x, fy = py - a.y;
+                float along = fx * nx + fy * ny;
+                float across = fabsf(fx * ny - fy * nx);
+                return std::clamp(r + 0.5f - across, 0.0f, 1.0f) *
+                       std::clamp(along + 0.5f, 0.0f, 1.0f) * std::clamp(len - along + 0.5f, 0.0f, 1.0f);
+            });
+        }
+        piece(b, b, [&](float px, float py) {
+            float ex = px - b.x, ey = py - b.y;
+            return std::clamp(r + 0.5f - sqrtf(ex * ex + ey * ey), 0.0f, 1.0f);
+        });
+    }
+}
+
+// Dabs piled up "over" each other, as alpha only: they share one colour.
+void CoverDabs(const BackgroundTileEdit &t, const CanvasStroke &stroke, const std::vector<BrushDab> &dabs, float *cov) {
+    const StrokeBrush &brush = *stroke.brush;
+    const float h = stroke.size * 0.5f;
+    const float reach = h * 1.4143f;  // the rotated quad's corners
+    const float flow = std::clamp(brush.flow, 0.0f, 1.0f);
+    for (const BrushDab &d : dabs) {
+        int x0 = std::max(t.x0, (int)floorf(d.pos.x - reach));
+        int y0 = std::max(t.y0, (int)floorf(d.pos.y - reach));
+        int x1 = std::min(t.x0 + t.width, (int)ceilf(d.pos.x + reach));
+        int y1 = std::min(t.y0 + t.height, (int)ceilf(d.pos.y + reach));
+        if (x0 >= x1 || y0 >= y1) continue;
+
+        // tip axes as DrawDabs lays the texture out, scaled to [-1, 1]
+        float ux = cosf(d.angle) / h, uy = sinf(d.angle) / h;
+        for (int y = y0; y < y1; ++y) {
+            float *row = cov + (size_t)(y - t.y0) * t.width - t.x0;
+            float fy = y + 0.5f - d.pos.y;
+            for (int x = x0; x < x1; ++x) {
+                float fx = x + 0.5f - d.pos.x;
+                float u = fx * ux + fy * uy, v = fy * ux - fx * uy;
+                if (fabsf(u) >= 1.0f || fabsf(v) >= 1.0f) continue;
+                float a = BrushTipAlpha(brush.tip, u, v, h) * flow;
+                row[x] = a + row[x] * (1.0f - a);
+            }
+        }
+    }
+}
+
+void PaintTile(const BackgroundTileEdit &t, const std::vector<PreparedStroke> &prepared) {
+    const int x1 = t.x0 + t.width, y1 = t.y0 + t.height;
+    std::vector<float> cov;
+    for (const PreparedStroke &p : prepared) {
+        const CanvasStroke &s = *p.stroke;
+        if (!Overlaps(s.bounds, t.x0, t.y0, x1, y1)) continue;
+        if (!s.brush) {
+            for (const auto &line : p.lines) PaintLine(t, line, s.size * 0.5f, s.color);
+            continue;
+        }
+        cov.assign((size_t)t.width * t.height, 0.0f);
+        CoverDabs(t, s, p.dabs, cov.data());
+        const float alpha = s.color.a / 255.0f * std::clamp(s.brush->opacity, 0.0f, 1.0f);
+        for (float &c : cov) c *= alpha;
+        Composite(t, cov.data(), s.color);
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const BackgroundSnapshot> FlattenStrokes(const std::shared_ptr<const BackgroundSnapshot> &base,
+                                                         int width, int height,
+                                                         const std::vector<std::shared_ptr<const CanvasStroke>> &strokes) {
+    std::vector<PreparedStroke> prepared;
+    prepared.reserve(strokes.size());
+    for (const auto &stroke : strokes) {
+        if (stroke->erased || stroke->points.size() < 2) continue;
+        PreparedStroke p;
+        p.stroke = stroke.get();
+        if (stroke->brush) {
+            BrushDabCursor cursor;
+            PlaceBrushDabs(*stroke, cursor, p.dabs);
+        } else {
+            p.lines.push_back(stroke->points);
+            if (stroke->symmetry) {
+                for (const Matrix &m : stroke->symmetry->copies) {
+                    std::vector<Vector2> copy;
+                    copy.reserve(stroke->points.size());
+                    for (const Vector2 &v : stroke->points) copy.push_back(Vector2Transform(v, m));
+                    p.lines.push_back(std::move(copy));
+                }
+            }
+        }
+        prepared.push_back(std::move(p));
+    }
+
+    if (!base) {
+        return BuildBackground(width, height, [&](const BackgroundTileEdit &t) {
+            memset(t.rgba, 255, (size_t)t.width * t.height * 4);
+            PaintTile(t, prepared);
+        });
+    }
+
+    // tiles no stroke reaches stay shared with the old background
+    std::vector<uint8_t> touched((size_t)base->tilesX * base->tilesY, 0);
+    for (const PreparedStroke &p : prepared) {
+        const Rectangle &b = p.stroke->bounds;
+        int tx0 = std::max(0, (int)floorf(b.x / kTile)), ty0 = std::max(0, (int)floorf(b.y / kTile));
+        int tx1 = std::min(base->tilesX - 1, (int)floorf((b.x + b.width) / kTile));
+        int ty1 = std::min(base->tilesY - 1, (int)floorf((b.y + b.height) / kTile));
+        for (int ty = ty0; ty <= ty1; ++ty)
+            for (int tx = tx0; tx <= tx1; ++tx) touched[(size_t)ty * base->tilesX + tx] = 1;
+    }
+    const BackgroundSnapshot &src = *base;
+    auto painted = RebuildBackground(src, [&](int tx, int ty) {
+        return !touched[(size_t)ty * src.tilesX + tx];
+    }, [&](const BackgroundTileEdit &t) {
+        const auto &tile = src.tiles[(size_t)(t.y0 / kTile) * src.tilesX + t.x0 / kTile];
+        memcpy(t.rgba, tile->rgba.data(), (size_t)t.width * t.height * 4);
+        PaintTile(t, prepared);
+    });
+    // an edit of the same image, so the view re-uploads only the painted tiles
+    auto edited = std::make_shared<BackgroundSnapshot>(*painted);
+    edited->imageId = src.imageId;
+    return edited;
+}
+
+void PaintLineOnTile(const BackgroundTileEdit &tile, const std::vector<Vector2> &points, float size, Color color) {
+    PaintLine(tile, points, size * 0.5f, color);
+}
+
+size_t StrokeBytes(const CanvasStroke &stroke) {
+    size_t bytes = sizeof(CanvasStroke) + stroke.points.capacity() * sizeof(Vector2);
+    if (stroke.lod) {
+        bytes += sizeof(StrokeLod);
+        for (const auto &level : stroke.lod->levels) bytes += sizeof(level) + level.points.capacity() * sizeof(Vector2);
+    }
+    return bytes;
+}
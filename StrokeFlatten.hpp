@@ -0,0 +1,40 @@
+// StrokeFlatten.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "Document.hpp"
+
+// Painting strokes into the background image on the CPU.
+//
+// Long sessions would otherwise keep every stroke as vector data forever.
+// Once the bottom layer grows past its stroke budget, its oldest strokes
+// are painted into the background tiles on the job pool and dropped from
+// the stroke list, which bounds both memory and the work done per frame.
+// The painting follows the GPU drawing: solid lines as anti-aliased
+// segments and joint discs blended one after the other, so translucent
+// overlaps stack the same way (symmetric copies included), brush strokes as
+// their dabs accumulated apart and then blended at the stroke's opacity.
+// Only the tiles the strokes overlap are written; the rest stay shared with
+// the old background. The raster pencil paints its segments with the same
+// line painter, straight into the live tiles.
+
+struct StrokeBudget {
+    size_t maxPoints = 2000000;  // live points on the bottom layer; 0 = no limit
+    size_t maxStrokes = 20000;   // live strokes on the bottom layer; 0 = no limit
+};
+
+// Any thread. `base` with `strokes` painted over it in order, or a white
+// `width` x `height` image with them when `base` is null. Paint outside the
+// image is cut off.
+std::shared_ptr<const BackgroundSnapshot> FlattenStrokes(const std::shared_ptr<const BackgroundSnapshot> &base,
+                                                         int width, int height,
+                                                         const std::vector<std::shared_ptr<const CanvasStroke>> &strokes);
+
+// Any thread. Paints the line through `points` onto one tile, anti-aliased
+// and the way DrawStrokePoints draws it; {p, p} paints a dot.
+void PaintLineOnTile(const BackgroundTileEdit &tile, const std::vector<Vector2> &points, float size, Color color);
+
+// Memory a live stroke holds: the stroke and its point and LOD storage.
+size_t StrokeBytes(const CanvasStroke &stroke);
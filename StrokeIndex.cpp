@@ -0,0 +1,162 @@
+// StrokeIndex.cpp
+#include "StrokeIndex.hpp"
+#include "raymath.h"
+#include "Symmetry.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kMaxCellsPerSide = 256;
+
+float SegmentDistanceSq(Vector2 p, Vector2 a, Vector2 b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float len2 = dx * dx + dy * dy;
+    float t = (len2 > 0.0f) ? std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / len2, 0.0f, 1.0f) : 0.0f;
+    float ex = a.x + dx * t - p.x, ey = a.y + dy * t - p.y;
+    return ex * ex + ey * ey;
+}
+
+// Liang-Barsky: whether segment ab crosses the rectangle.
+bool SegmentTouchesRect(Vector2 a, Vector2 b, Rectangle r) {
+    float t0 = 0.0f, t1 = 1.0f;
+    const float d[2] = { b.x - a.x, b.y - a.y };
+    const float lo[2] = { r.x - a.x, r.y - a.y };
+    const float hi[2] = { r.x + r.width - a.x, r.y + r.height - a.y };
+    for (int axis = 0; axis < 2; ++axis) {
+        if (d[axis] == 0.0f) {
+            if (lo[axis] > 0.0f || hi[axis] < 0.0f) return false;
+            continue;
+        }
+        float ta = lo[axis] / d[axis], tb = hi[axis] / d[axis];
+        if (ta > tb) std::swap(ta, tb);
+        t0 = std::max(t0, ta);
+        t1 = std::min(t1, tb);
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+// Whether the stroke's own line passes within `reach` of `p`.
+bool LineNearPoint(const CanvasStroke &stroke, Vector2 p, float reach) {
+    float reach2 = reach * reach;
+    if (stroke.points.size() == 1) return SegmentDistanceSq(p, stroke.points[0], stroke.points[0]) <= reach2;
+    for (size_t i = 1; i < stroke.points.size(); ++i)
+        if (SegmentDistanceSq(p, stroke.points[i - 1], stroke.points[i]) <= reach2) return true;
+    return false;
+}
+
+} // namespace
+
+void StrokeIndex::Build(const std::vector<CanvasStroke> &strokes) {
+    Clear();
+    if (strokes.empty()) return;
+
+    float minX = strokes[0].bounds.x, minY = strokes[0].bounds.y;
+    float maxX = minX, maxY = minY;
+    for (const CanvasStroke &s : strokes) {
+        minX = std::min(minX, s.bounds.x);
+        minY = std::min(minY, s.bounds.y);
+        maxX = std::max(maxX, s.bounds.x + s.bounds.width);
+        maxY = std::max(maxY, s.bounds.y + s.bounds.height);
+    }
+
+    // about one cell per stroke
+    float w = std::max(1.0f, maxX - minX), h = std::max(1.0f, maxY - minY);
+    cell = std::max(16.0f, sqrtf(w * h / (float)strokes.size()));
+    cols = std::clamp((int)ceilf(w / cell), 1, kMaxCellsPerSide);
+    rows = std::clamp((int)ceilf(h / cell), 1, kMaxCellsPerSide);
+    cell = std::max(w / cols, h / rows);
+    origin = { minX, minY };
+    cells.resize((size_t)cols * rows);
+
+    for (size_t i = 0; i < strokes.size(); ++i) {
+        const Rectangle &b = strokes[i].bounds;
+        int cx0 = std::clamp((int)((b.x - origin.x) / cell), 0, cols - 1);
+        int cy0 = std::clamp((int)((b.y - origin.y) / cell), 0, rows - 1);
+        int cx1 = std::clamp((int)((b.x + b.width - origin.x) / cell), 0, cols - 1);
+        int cy1 = std::clamp((int)((b.y + b.height - origin.y) / cell), 0, rows - 1);
+        for (int cy = cy0; cy <= cy1; ++cy)
+            for (int cx = cx0; cx <= cx1; ++cx) cells[(size_t)cy * cols + cx].push_back((uint32_t)i);
+    }
+}
+
+void StrokeIndex::Clear() {
+    cols = rows = 0;
+    cells.clear();
+}
+
+void StrokeIndex::Query(Rectangle r, std::vector<size_t> &out) const {
+    out.clear();
+    if (cells.empty()) return;
+    int cx0 = (int)floorf((r.x - origin.x) / cell), cx1 = (int)floorf((r.x + r.width - origin.x) / cell);
+    int cy0 = (int)floorf((r.y - origin.y) / cell), cy1 = (int)floorf((r.y + r.height - origin.y) / cell);
+    if (cx1 < 0 || cy1 < 0 || cx0 >= cols || cy0 >= rows) return;
+    cx0 = std::max(0, cx0);
+    cy0 = std::max(0, cy0);
+    cx1 = std::min(cols - 1, cx1);
+    cy1 = std::min(rows - 1, cy1);
+
+    for (int cy = cy0; cy <= cy1; ++cy)
+        for (int cx = cx0; cx <= cx1; ++cx)
+            for (uint32_t i : cells[(size_t)cy * cols + cx]) out.push_back(i);
+    // strokes spanning several cells are listed in each
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool StrokeContainsPoint(const CanvasStroke &stroke, Vector2 p, float slop) {
+    if (stroke.points.empty()) return false;
+    float reach = stroke.size * 0.5f + slop;
+    if (!stroke.symmetry) return LineNearPoint(stroke, p, reach);
+
+    // a copy covers `p` when the source covers the point that copy maps there
+    thread_local std::vector<Vector2> queries;
+    queries.clear();
+    SymmetryQueryPoints(stroke, p, queries);
+    const Rectangle &b = stroke.sourceBounds;
+    const bool boxed = stroke.boundsPoints == stroke.points.size();
+    Rectangle near = { b.x - slop, b.y - slop, b.width + 2 * slop, b.height + 2 * slop };
+    for (const Vector2 &q : queries)
+        if ((!boxed || CheckCollisionPointRec(q, near)) && LineNearPoint(stroke, q, reach)) return true;
+    return false;
+}
+
+bool StrokeTouchesRect(const CanvasStroke &stroke, Rectangle r) {
+    if (stroke.points.empty()) return false;
+    const size_t copies = stroke.symmetry ? stroke.symmetry->copies.size() : 0;
+    for (size_t c = 0; c <= copies; ++c) {
+        // the rectangle stays axis-aligned only in document space, so the
+        // copies' segments are transformed rather than the rectangle
+        const Matrix *m = (c == 0) ? nullptr : &stroke.symmetry->copies[c - 1];
+        auto at = [&](size_t i) { return m ? Vector2Transform(stroke.points[i], *m) : stroke.points[i]; };
+        if (stroke.points.size() == 1) {
+            if (CheckCollisionPointRec(at(0), r)) return true;
+            continue;
+        }
+        Vector2 prev = at(0);
+        for (size_t i = 1; i < stroke.points.size(); ++i) {
+            Vector2 next = at(i);
+            if (SegmentTouchesRect(prev, next, r)) return true;
+            prev = next;
+        }
+    }
+    return false;
+}
+
+Rectangle TransformedBounds(Rectangle r, const Matrix &m) {
+    const Vector2 corners[4] = {
+        Vector2Transform({ r.x, r.y }, m),
+        Vector2Transform({ r.x + r.width, r.y }, m),
+        Vector2Transform({ r.x, r.y + r.height }, m),
+        Vector2Transform({ r.x + r.width, r.y + r.height }, m),
+    };
+    float minX = corners[0].x, minY = corners[0].y, maxX = minX, maxY = minY;
+    for (const Vector2 &c : corners) {
+        minX = std::min(minX, c.x);
+        minY = std::min(minY, c.y);
+        maxX = std::max(maxX, c.x);
+        maxY = std::max(maxY, c.y);
+    }
+    return { minX, minY, maxX - minX, maxY - minY };
+}
@@ -0,0 +1,40 @@
+// StrokeIndex.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <vector>
+#include "tools/CanvasStroke.hpp"
+
+// Picking strokes by point or rectangle.
+//
+// A uniform grid over the strokes' bounds, with cells sized so there are
+// about as many cells as strokes; each cell lists the strokes whose bounds
+// overlap it. A query visits only the cells it covers and then tests the
+// candidates' segments exactly, so picking stays cheap with thousands of
+// strokes on a layer. Built from a layer's strokes after their bounds are
+// up to date (UpdateStrokeBounds); main thread.
+
+class StrokeIndex {
+public:
+    void Build(const std::vector<CanvasStroke> &strokes);
+    void Clear();
+
+    // Indices of strokes whose bounds overlap `r`, ascending, each once.
+    void Query(Rectangle r, std::vector<size_t> &out) const;
+
+private:
+    Vector2 origin{};
+    float cell = 1.0f;
+    int cols = 0;
+    int rows = 0;
+    std::vector<std::vector<uint32_t>> cells;  // row-major
+};
+
+// Whether `p` is on the stroke, within `slop` document pixels of its edge.
+// Symmetric copies count as part of the stroke.
+bool StrokeContainsPoint(const CanvasStroke &stroke, Vector2 p, float slop);
+// Whether any part of the stroke's line, or of a copy, lies inside `r`.
+bool StrokeTouchesRect(const CanvasStroke &stroke, Rectangle r);
+
+// Axis-aligned box around `r` after the transform `m`.
+Rectangle TransformedBounds(Rectangle r, const Matrix &m);
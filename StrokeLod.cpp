@@ -0,0 +1,138 @@
+// StrokeLod.cpp
+#include "StrokeLod.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+const size_t kLodMinPoints = 16;      // shorter strokes are cheap enough as they are
+const float kFirstTolerance = 0.25f;
+const int kMaxLevels = 10;
+const int kMaxBuildsPerFrame = 64;
+const float kMaxScreenError = 0.5f;
+
+struct FinishedLod {
+    uint64_t id;
+    std::shared_ptr<const StrokeLod> lod;
+};
+
+std::mutex g_FinishedMutex;
+std::vector<FinishedLod> g_Finished;   // filled by workers
+std::unordered_set<uint64_t> g_Pending;  // main thread: stroke ids being built
+
+float SegmentDistance2(Vector2 p, Vector2 a, Vector2 b) {
+    float abx = b.x - a.x, aby = b.y - a.y;
+    float apx = p.x - a.x, apy = p.y - a.y;
+    float len2 = abx*abx + aby*aby;
+    float t = (len2 > 0.0f) ? std::clamp((apx*abx + apy*aby) / len2, 0.0f, 1.0f) : 0.0f;
+    float dx = apx - abx*t, dy = apy - aby*t;
+    return dx*dx + dy*dy;
+}
+
+// Douglas-Peucker with an explicit stack: keeps the points needed to stay
+// within `tolerance` of the full polyline.
+void Simplify(const std::vector<Vector2> &points, float tolerance, std::vector<Vector2> &out) {
+    size_t n = points.size();
+    std::vector<uint8_t> keep(n, 0);
+    keep[0] = keep[n - 1] = 1;
+
+    float tol2 = tolerance * tolerance;
+    std::vector<std::pair<size_t, size_t>> stack = { { 0, n - 1 } };
+    while (!stack.empty()) {
+        auto [a, b] = stack.back();
+        stack.pop_back();
+        if (b <= a + 1) continue;
+
+        float worst = -1.0f;
+        size_t at = a;
+        for (size_t i = a + 1; i < b; ++i) {
+            float d2 = SegmentDistance2(points[i], points[a], points[b]);
+            if (d2 > worst) { worst = d2; at = i; }
+        }
+        if (worst > tol2) {
+            keep[at] = 1;
+            stack.push_back({ a, at });
+            stack.push_back({ at, b });
+        }
+    }
+
+    out.clear();
+    for (size_t i = 0; i < n; ++i)
+        if (keep[i]) out.push_back(points[i]);
+}
+
+std::shared_ptr<const StrokeLod> BuildLod(const std::vector<Vector2> &points) {
+    auto lod = std::make_shared<StrokeLod>();
+    lod->sourcePoints = points.size();
+
+    size_t count = points.size();
+    float tolerance = kFirstTolerance;
+    for (int k = 0; k < kMaxLevels && count > 2; ++k, tolerance *= 2.0f) {
+        StrokeLod::Level level;
+        level.tolerance = tolerance;
+        Simplify(points, tolerance, level.points);
+        // a level that barely drops points is not worth keeping
+        if (level.points.size() * 4 > count * 3) continue;
+        count = level.points.size();
+        lod->levels.push_back(std::move(level));
+    }
+    return lod;
+}
+
+} // namespace
+
+const std::vector<Vector2> &StrokePointsForZoom(const CanvasStroke &stroke, float zoom) {
+    if (stroke.lod && stroke.lod->sourcePoints == stroke.points.size()) {
+        const auto &levels = stroke.lod->levels;
+        for (auto it = levels.rbegin(); it != levels.rend(); ++it)
+            if (it->tolerance * zoom < kMaxScreenError) return it->points;
+    }
+    return stroke.points;
+}
+
+FinishedStrokeLods TakeFinishedStrokeLods() {
+    std::vector<FinishedLod> finished;
+    {
+        std::lock_guard<std::mutex> lock(g_FinishedMutex);
+        finished.swap(g_Finished);
+    }
+    FinishedStrokeLods byId;
+    for (auto &f : finished) {
+        g_Pending.erase(f.id);
+        byId[f.id] = std::move(f.lod);
+    }
+    return byId;
+}
+
+void AttachStrokeLods(std::vector<CanvasStroke> &strokes, const FinishedStrokeLods &finished) {
+    if (finished.empty()) return;
+    // a stroke that changed (or went away) meanwhile gets queued again with
+    // its layer's next edit
+    for (auto &stroke : strokes) {
+        auto it = finished.find(stroke.id);
+        if (it != finished.end() && it->second->sourcePoints == stroke.points.size()) stroke.lod = it->second;
+    }
+}
+
+bool QueueStrokeLods(const std::vector<CanvasStroke> &strokes, const CanvasStroke *inProgress) {
+    int queued = 0;
+    for (const auto &stroke : strokes) {
+        if (&stroke == inProgress || stroke.erased || stroke.points.size() < kLodMinPoints) continue;
+        if (stroke.lod && stroke.lod->sourcePoints == stroke.points.size()) continue;
+        if (g_Pending.count(stroke.id)) continue;
+        if (queued >= kMaxBuildsPerFrame) return false;
+        g_Pending.insert(stroke.id);
+
+        uint64_t id = stroke.id;
+        RunJob("stroke lod", [id, points = stroke.points] {
+            auto lod = BuildLod(points);
+            std::lock_guard<std::mutex> lock(g_FinishedMutex);
+            g_Finished.push_back({ id, std::move(lod) });
+        });
+        ++queued;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+// StrokeLod.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "tools/CanvasStroke.hpp"
+
+// Level-of-detail polylines for strokes seen from far away.
+//
+// A committed stroke gets simplified copies of its points (Douglas-Peucker
+// against the full polyline) at doubling tolerances, built on the job pool.
+// The renderer draws the coarsest copy whose error is still under half a
+// screen pixel, so a zoomed-out view costs about as many segments as it has
+// pixels, however many points were recorded.
+
+struct StrokeLod {
+    struct Level {
+        float tolerance;              // max distance from the full polyline, document pixels
+        std::vector<Vector2> points;
+    };
+    size_t sourcePoints = 0;          // stroke point count the levels were built from
+    std::vector<Level> levels;        // coarser with each level
+};
+
+// Points to draw `stroke` with at `zoom` screen pixels per document pixel.
+const std::vector<Vector2> &StrokePointsForZoom(const CanvasStroke &stroke, float zoom);
+
+// Levels finished on the job pool, by stroke id.
+using FinishedStrokeLods = std::unordered_map<uint64_t, std::shared_ptr<const StrokeLod>>;
+
+// Main thread, once per frame: the levels finished since the last call.
+FinishedStrokeLods TakeFinishedStrokeLods();
+// Main thread: attaches `finished` levels to the strokes they were built
+// for; a stroke that changed meanwhile is left without.
+void AttachStrokeLods(std::vector<CanvasStroke> &strokes, const FinishedStrokeLods &finished);
+// Main thread, after strokes were committed or edited: queues builds for
+// strokes without up-to-date levels, a few per call. False while some are
+// left for the next call. `inProgress` (may be null) is still being drawn
+// and is left alone.
+bool QueueStrokeLods(const std::vector<CanvasStroke> &strokes, const CanvasStroke *inProgress);
@@ -0,0 +1,158 @@
+// Symmetry.cpp
+#include "Symmetry.hpp"
+#include "raymath.h"
+#include "rlgl.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kJointSegments = 36;  // as DrawCircleV
+
+Matrix AboutCenter(Vector2 c, const Matrix &m) {
+    return MatrixMultiply(MatrixMultiply(MatrixTranslate(-c.x, -c.y, 0.0f), m), MatrixTranslate(c.x, c.y, 0.0f));
+}
+
+bool SameSettings(const SymmetrySettings &a, const SymmetrySettings &b) {
+    return a.mode == b.mode && a.folds == b.folds && a.center.x == b.center.x && a.center.y == b.center.y;
+}
+
+// Triangles of the line as DrawLineEx + DrawCircleV would draw it.
+void Tessellate(const std::vector<Vector2> &points, float size, std::vector<Vector2> &tris) {
+    static float cosTable[kJointSegments + 1], sinTable[kJointSegments + 1];
+    if (cosTable[0] == 0.0f) {
+        for (int i = 0; i <= kJointSegments; ++i) {
+            cosTable[i] = cosf(2.0f * PI * i / kJointSegments);
+            sinTable[i] = sinf(2.0f * PI * i / kJointSegments);
+        }
+    }
+
+    const float r = size * 0.5f;
+    tris.clear();
+    for (size_t i = 1; i < points.size(); ++i) {
+        Vector2 a = points[i - 1], b = points[i];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len = sqrtf(dx * dx + dy * dy);
+        if (len > 0.0f) {
+            float nx = -dy / len * r, ny = dx / len * r;
+            Vector2 a0 = { a.x + nx, a.y + ny }, a1 = { a.x - nx, a.y - ny };
+            Vector2 b0 = { b.x + nx, b.y + ny }, b1 = { b.x - nx, b.y - ny };
+            // same winding as DrawLineEx's strip
+            tris.insert(tris.end(), { b1, a1, a0, b0, b1, a0 });
+        }
+        for (int s = 0; s < kJointSegments; ++s) {
+            tris.push_back(b);
+            tris.push_back({ b.x + cosTable[s + 1] * r, b.y + sinTable[s + 1] * r });
+            tris.push_back({ b.x + cosTable[s] * r, b.y + sinTable[s] * r });
+        }
+    }
+}
+
+void EmitTriangles(const std::vector<Vector2> &tris, const Matrix *m) {
+    if (!m) {
+        for (const Vector2 &v : tris) rlVertex2f(v.x, v.y);
+        return;
+    }
+    // a mirror flips the winding; keep every triangle front-facing
+    bool flip = m->m0 * m->m5 - m->m4 * m->m1 < 0.0f;
+    for (size_t i = 0; i + 2 < tris.size(); i += 3) {
+        Vector2 a = Vector2Transform(tris[i], *m);
+        Vector2 b = Vector2Transform(tris[i + 1], *m);
+        Vector2 c = Vector2Transform(tris[i + 2], *m);
+        if (flip) std::swap(b, c);
+        rlVertex2f(a.x, a.y);
+        rlVertex2f(b.x, b.y);
+        rlVertex2f(c.x, c.y);
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const StrokeSymmetry> MakeSymmetry(const SymmetrySettings &settings) {
+    static SymmetrySettings lastSettings;
+    static std::shared_ptr<const StrokeSymmetry> last;
+    if (settings.mode == SYMMETRY_OFF) return nullptr;
+    if (last && SameSettings(settings, lastSettings)) return last;
+
+    auto sym = std::make_shared<StrokeSymmetry>();
+    const Vector2 c = settings.center;
+    const Matrix flipX = AboutCenter(c, MatrixScale(-1.0f, 1.0f, 1.0f));
+    const Matrix flipY = AboutCenter(c, MatrixScale(1.0f, -1.0f, 1.0f));
+    const int folds = std::max(2, settings.folds);
+    switch (settings.mode) {
+        case SYMMETRY_MIRROR_X:
+            sym->copies = { flipX };
+            break;
+        case SYMMETRY_MIRROR_Y:
+            sym->copies = { flipY };
+            break;
+        case SYMMETRY_MIRROR_XY:
+            sym->copies = { flipX, flipY, MatrixMultiply(flipX, flipY) };
+            break;
+        case SYMMETRY_RADIAL:
+        case SYMMETRY_MANDALA:
+            for (int k = 0; k < folds; ++k) {
+                Matrix rotate = AboutCenter(c, MatrixRotateZ(2.0f * PI * k / folds));
+                if (k > 0) sym->copies.push_back(rotate);
+                if (settings.mode == SYMMETRY_MANDALA) sym->copies.push_back(MatrixMultiply(flipX, rotate));
+            }
+            break;
+        default:
+            break;
+    }
+    for (const Matrix &m : sym->copies) sym->inverses.push_back(MatrixInvert(m));
+
+    lastSettings = settings;
+    last = sym;
+    return last;
+}
+
+std::shared_ptr<const StrokeSymmetry> TransformedSymmetry(const StrokeSymmetry &sym, const Matrix &m) {
+    // back to where the copies were defined, the copy, then forward again
+    const Matrix inv = MatrixInvert(m);
+    auto moved = std::make_shared<StrokeSymmetry>();
+    for (const Matrix &c : sym.copies) moved->copies.push_back(MatrixMultiply(MatrixMultiply(inv, c), m));
+    for (const Matrix &c : sym.inverses) moved->inverses.push_back(MatrixMultiply(MatrixMultiply(inv, c), m));
+    return moved;
+}
+
+void SymmetryQueryPoints(const CanvasStroke &stroke, Vector2 p, std::vector<Vector2> &out) {
+    out.push_back(p);
+    if (!stroke.symmetry) return;
+    for (const Matrix &inv : stroke.symmetry->inverses) out.push_back(Vector2Transform(p, inv));
+}
+
+void DrawSymmetricStroke(const CanvasStroke &stroke, const std::vector<Vector2> &points) {
+    static std::vector<Vector2> tris;  // main thread
+    Tessellate(points, stroke.size, tris);
+    if (tris.empty()) return;
+
+    const Color c = stroke.color;
+    rlBegin(RL_TRIANGLES);
+    rlColor4ub(c.r, c.g, c.b, c.a);
+    EmitTriangles(tris, nullptr);
+    if (stroke.symmetry)
+        for (const Matrix &m : stroke.symmetry->copies) EmitTriangles(tris, &m);
+    rlEnd();
+}
+
+void DrawSymmetryGuides(const SymmetrySettings &settings, float canvasW, float canvasH, float zoom) {
+    if (settings.mode == SYMMETRY_OFF) return;
+    const Vector2 c = settings.center;
+    const float thick = 1.0f / zoom;
+    const Color color = Fade(SKYBLUE, 0.8f);
+
+    if (settings.mode == SYMMETRY_MIRROR_X || settings.mode == SYMMETRY_MIRROR_XY)
+        DrawLineEx({ c.x, 0.0f }, { c.x, canvasH }, thick, color);
+    if (settings.mode == SYMMETRY_MIRROR_Y || settings.mode == SYMMETRY_MIRROR_XY)
+        DrawLineEx({ 0.0f, c.y }, { canvasW, c.y }, thick, color);
+    if (settings.mode == SYMMETRY_RADIAL || settings.mode == SYMMETRY_MANDALA) {
+        // one spoke per fold, long enough to leave the canvas
+        const int folds = std::max(2, settings.folds);
+        const float reach = canvasW + canvasH;
+        for (int k = 0; k < folds; ++k) {
+            float a = 2.0f * PI * k / folds - PI * 0.5f;
+            DrawLineEx(c, { c.x + cosf(a) * reach, c.y + sinf(a) * reach }, thick, color);
+        }
+    }
+}
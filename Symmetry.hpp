@@ -0,0 +1,54 @@
+// Symmetry.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <memory>
+#include <vector>
+#include "tools/CanvasStroke.hpp"
+
+// Mirror and radial symmetry for line work.
+//
+// A symmetric stroke is stored once, with a shared StrokeSymmetry listing
+// the transforms of its copies: a 12-fold mandala is one stroke's points
+// plus one list of matrices that every stroke drawn with the same settings
+// points to. Drawing tessellates the line once and replays the triangles
+// through each copy's matrix in the same batch, so the copies cost vertex
+// transforms rather than another tessellation each. Hit tests run the
+// query point backwards through the inverse transforms and test it against
+// the one source line.
+
+enum SymmetryMode {
+    SYMMETRY_OFF = 0,
+    SYMMETRY_MIRROR_X,   // across the vertical centre line
+    SYMMETRY_MIRROR_Y,   // across the horizontal centre line
+    SYMMETRY_MIRROR_XY,  // into all four quadrants
+    SYMMETRY_RADIAL,     // `folds` rotations around the centre
+    SYMMETRY_MANDALA     // `folds` rotations, each also mirrored
+};
+
+struct SymmetrySettings {
+    SymmetryMode mode = SYMMETRY_OFF;
+    int folds = 6;
+    Vector2 center{};  // document coordinates
+};
+
+// The copies for `settings`, null when off. Asking again with the same
+// settings returns the same object, so strokes share it.
+std::shared_ptr<const StrokeSymmetry> MakeSymmetry(const SymmetrySettings &settings);
+
+// `sym` for strokes whose points were moved by `m`: each copy is conjugated
+// by `m`, so the copies follow their source stroke.
+std::shared_ptr<const StrokeSymmetry> TransformedSymmetry(const StrokeSymmetry &sym, const Matrix &m);
+
+// Appends `p` and, for every copy of `stroke`, the source point that copy
+// draws at `p`: a hit test against the source line with each of them covers
+// all the copies.
+void SymmetryQueryPoints(const CanvasStroke &stroke, Vector2 p, std::vector<Vector2> &out);
+
+// Draws the line through `points` (the stroke's own or a simplified copy)
+// at the stroke's size and colour, once per copy, as one triangle batch.
+// Inside BeginMode2D.
+void DrawSymmetricStroke(const CanvasStroke &stroke, const std::vector<Vector2> &points);
+
+// Mirror lines / rotation spokes over a `canvasW` x `canvasH` canvas, one
+// screen pixel wide at `zoom`. Inside BeginMode2D.
+void DrawSymmetryGuides(const SymmetrySettings &settings, float canvasW, float canvasH, float zoom);
@@ -1,6 +1,6 @@
 // main.cpp
 #include <raylib-cpp.hpp>
-#include "tinyfiledialogs.h"
+#include "rlgl.h"
 #include <memory>
 #include <vector>
 #include <string>
@@ -8,12 +8,43 @@
 #include <cstring>
 #include <cstdlib>
 #include <deque>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include "PngEncoder.hpp"
+#include "ImageOps.hpp"
+#include "Palette.hpp"
+#include "Benchmark.hpp"
+#include "Dialogs.hpp"
+#include "JobSystem.hpp"
+#include "Document.hpp"
+#include "BackgroundPyramid.hpp"
+#include "StrokeLod.hpp"
+#include "LayerCompositor.hpp"
+#include "FloodFill.hpp"
+#include "Resample.hpp"
+#include "CanvasTransform.hpp"
+#include "Filters.hpp"
+#include "Adjustments.hpp"
+#include "Gradient.hpp"
+#include "Selection.hpp"
+#include "StrokeIndex.hpp"
+#include "BrushEngine.hpp"
+#include "Symmetry.hpp"
+#include "StrokeFlatten.hpp"
 #include "tools/Tool.hpp"
+#include "tools/CanvasStroke.hpp"
 #include "tools/PencilTool.hpp"
 #include "tools/EraserTool.hpp"
 #include "tools/DropperTool.hpp"
+#include "tools/BucketTool.hpp"
 #include "tools/SquareTool.hpp"
 #include "tools/CircleTool.hpp"
+#include "tools/GradientTool.hpp"
+#include "tools/SelectTool.hpp"
+#include "tools/MoveTool.hpp"
+#include "tools/BrushTool.hpp"
 
 int g_ScreenWidth = 1200;
 int g_ScreenHeight = 800;
@@ -25,31 +56,88 @@ float g_ColorValue = 1.0f;
 float g_SelectedHue = 0.0f;
 float g_SelectedSat = 0.0f;
 
-struct CanvasStroke {
-    std::vector<Vector2> points;
-    float size;
-    Color color;
-    bool erased = false;
-};
-
-std::vector<CanvasStroke> g_CanvasStrokes;
+// Layers, bottom first. The bottom layer also owns the background image;
+// tools draw into the active layer.
+std::vector<Layer> g_Layers;
+int g_ActiveLayer = 0;
 CanvasStroke* g_CurrentStroke = nullptr;
+LayerViewCache g_LayerCache;
+BrushRenderer g_Brushes;  // dab batches and rasters of brush strokes
+
+std::vector<CanvasStroke> &ActiveStrokes() {
+    return g_Layers[g_ActiveLayer].strokes;
+}
 
-Image g_BackgroundImage = { 0 };
-Texture2D g_BackgroundTexture = { 0 };
-RenderTexture2D g_RenderTex = { 0 };
+// Canvas size in document pixels. The background image, when there is one,
+// lives in the document as tiles and is drawn through g_BackgroundPyramid.
+int g_CanvasWidth = 0;
+int g_CanvasHeight = 0;
+BackgroundPyramid g_BackgroundPyramid;
+
+// Background edits are limited to the selected pixels; with no selection
+// (IsNull()) the whole image is editable.
+static SelectionMask g_Selection;
+
+static const SelectionMask *ActiveSelection() {
+    return g_Selection.IsNull() ? nullptr : &g_Selection;
+}
 
 std::string g_CurrentFile = "";
 bool g_HasUnsavedChanges = false;
+// Bumped on every edit so a finished background save can tell whether the
+// document still matches the snapshot it wrote.
+uint64_t g_DocumentVersion = 0;
+
+// Publishes the live document if it changed and returns the latest snapshot.
+// The background pyramid follows the published background.
+DocumentSnapshotRef CurrentDocument() {
+    DocumentSnapshotRef doc = PublishDocument(g_DocumentVersion, g_Layers, g_CanvasWidth, g_CanvasHeight);
+    g_BackgroundPyramid.SetSource(doc->background);
+    return doc;
+}
+
+// Content of the active layer changed.
+void MarkDocumentChanged() {
+    g_HasUnsavedChanges = true;
+    ++g_DocumentVersion;
+    g_Layers[g_ActiveLayer].version = g_DocumentVersion;
+    g_Layers[g_ActiveLayer].strokesVersion = g_DocumentVersion;
+}
+
+// Layer order or properties changed; no layer content needs re-rendering.
+static void MarkLayersChanged() {
+    g_HasUnsavedChanges = true;
+    ++g_DocumentVersion;
+}
+
+// Every layer's content changed (undo, whole-canvas operations).
+static void MarkAllLayersChanged() {
+    MarkLayersChanged();
+    for (auto &layer : g_Layers) layer.version = layer.strokesVersion = g_DocumentVersion;
+}
+
+// Only the background image (of the bottom layer) changed; its strokes did
+// not, so they are not gone over again.
+static void MarkBackgroundChanged() {
+    MarkLayersChanged();
+    g_Layers[0].version = g_DocumentVersion;
+}
+
+// A new document has one empty layer.
+static void ResetLayers() {
+    g_CurrentStroke = nullptr;
+    g_Layers.clear();
+    g_Layers.push_back(Layer());
+    g_Layers[0].id = NewLayerId();
+    g_Layers[0].name = "Background";
+    g_ActiveLayer = 0;
+}
 
 // --- Undo/Redo state snapshot ---
+// Undo states are published document snapshots, so unchanged strokes and
+// background tiles are shared between states instead of copied per state.
 struct AppState {
-    std::vector<CanvasStroke> strokes;
-
-    std::vector<unsigned char> bgPixels;
-    int bgW = 0;
-    int bgH = 0;
-    bool hasBg = false;
+    DocumentSnapshotRef doc;
 };
 
 static std::deque<AppState> g_UndoStack;
@@ -57,10 +145,14 @@ static std::deque<AppState> g_RedoStack;
 static const size_t kUndoLimit = 50;
 
 Image RenderCanvasImage(int canvasW, int canvasH);
+std::shared_ptr<const StrokeSymmetry> CurrentSymmetry();
 void File_New();
 void File_Open();
 void File_Save();
 void File_SaveAs();
+void File_ExportHiRes();
+void Edit_ChangeCanvasSize();
+static void CancelOpen();
 
 float DrawValueSlider(int x, int y, int w, int h, float value);
 
@@ -121,139 +213,506 @@ float DrawValueSlider(int x, int y, int w, int h, float value) {
 
 void FlattenToWhite(Image &img) {
     Color* px = (Color*)img.data;
-    int count = img.width * img.height;
+    int w = img.width;
 
-    for (int i = 0; i < count; i++) {
-        float a = px[i].a / 255.0f;
+    ParallelFor("flatten", img.height, 64, [&](int y0, int y1) {
+        for (int i = y0 * w; i < y1 * w; i++) {
+            float a = px[i].a / 255.0f;
 
-        px[i].r = (unsigned char)(px[i].r * a + 255 * (1.0f - a));
-        px[i].g = (unsigned char)(px[i].g * a + 255 * (1.0f - a));
-        px[i].b = (unsigned char)(px[i].b * a + 255 * (1.0f - a));
+            px[i].r = (unsigned char)(px[i].r * a + 255 * (1.0f - a));
+            px[i].g = (unsigned char)(px[i].g * a + 255 * (1.0f - a));
+            px[i].b = (unsigned char)(px[i].b * a + 255 * (1.0f - a));
 
-        px[i].a = 255;
-    }
+            px[i].a = 255;
+        }
+    });
 }
 
-void DoExportImage(const std::string &dst, int canvasW, int canvasH) {
-    Image img = RenderCanvasImage(canvasW, canvasH);
+// --- Background save ---
+// The canvas is rendered and read back on the main thread (GPU work), the
+// resulting pixels become an immutable snapshot owned by the job, and the
+// flatten/flip/encode/write steps run as a pool job that posts its result
+// back to the main thread.
+struct SaveJob {
+    std::string dst;
+    Image img = {};
+    uint64_t version = 0;   // g_DocumentVersion when the snapshot was taken
+    bool png = true;        // false: let raylib pick the encoder from the extension
+    PngEncodeOptions pngOptions;
+    PaletteOptions paletteOptions;
+    std::atomic<float> progress{0.0f};
+    bool ok = false;
+    JobRef task;
+};
 
-    FlattenToWhite(img); // optional: remove alpha for saving
-    ImageFlipVertical(&img);
+// Print per-job timing counters on exit (--job-stats)
+bool g_PrintJobStats = false;
+// PNG compression level / thread count used for saving (--png-level N)
+PngEncodeOptions g_PngOptions;
+// Indexed PNG output (--png-palette off|exact|quantize, --png-dither)
+PaletteOptions g_PaletteOptions;
+
+// Jobs run one at a time in submission order so two saves to the same path
+// never race each other.
+static std::deque<std::unique_ptr<SaveJob>> g_SaveJobs;
+
+static void OnSaveJobDone();
+
+static void RunSaveJob(SaveJob *job) {
+    if (job->png) {
+        // Single pass: each band reads the bottom-up readback rows directly,
+        // composites them over white and hands RGB (or palette index) rows
+        // to the encoder.
+        PngFormat fmt;
+        fmt.width = job->img.width;
+        fmt.height = job->img.height;
+        fmt.colorType = PNG_RGB;
+        const unsigned char *px = (const unsigned char *)job->img.data;
+        size_t srcStride = (size_t)fmt.width * 4;
+        int lastRow = fmt.height - 1;
+
+        PaletteMap palette;
+        if (BuildPalette(px, fmt.width, fmt.height, job->paletteOptions, palette)) {
+            fmt.colorType = PNG_INDEXED;
+            fmt.bitDepth = palette.bitDepth;
+            fmt.palette = palette.palette;
+        }
+        size_t dstStride = (size_t)PngRowBytes(fmt);
+
+        job->ok = EncodePng(job->dst, fmt,
+            [&](int y, int count, uint8_t *dst) {
+                for (int i = 0; i < count; ++i) {
+                    const unsigned char *src = px + (lastRow - y - i) * srcStride;
+                    if (fmt.colorType == PNG_INDEXED) palette.MapRow(src, fmt.width, y + i, dst + i * dstStride);
+                    else CompositeOverWhiteToRGB(src, dst + i * dstStride, fmt.width);
+                }
+            },
+            job->pngOptions, &job->progress);
+    } else {
+        FlattenToWhite(job->img);
+        ImageFlipVertical(&job->img);
+        job->ok = ExportImage(job->img, job->dst.c_str());
+    }
+    UnloadImage(job->img);
+    job->img = {};
 
-    ExportImage(img, dst.c_str());
-    UnloadImage(img);
+    job->progress = 1.0f;
+    PostToMainThread(OnSaveJobDone);
 }
 
-void File_New() {
-    if (g_HasUnsavedChanges) {
-        int result = tinyfd_messageBox("Unsaved Changes",
-            "Do you want to save the current file?",
-            "yesno", "question", 1);
-
-        if (result == 1) {
-            if (g_CurrentFile.empty()) {
-                const char* patterns[] = {"*.png"};
-                const char** pp = patterns;
-                const char* dst = tinyfd_saveFileDialog("Save As", "image.png", 1, pp, "PNG files");
-                if (!dst) return;
-                g_CurrentFile = dst;
-            }
-
-            int canvasW = g_RenderTex.texture.width;
-            int canvasH = g_RenderTex.texture.height;
-            DoExportImage(g_CurrentFile, canvasW, canvasH);
-        }
-    }
+static void StartNextSaveJob() {
+    if (g_SaveJobs.empty()) return;
+    SaveJob *job = g_SaveJobs.front().get();
+    if (!job->task) job->task = RunJob("save", [job] { RunSaveJob(job); });
+}
 
-    g_CanvasStrokes.clear();
+// Main thread: retires the running (front) job and starts the next one.
+static void OnSaveJobDone() {
+    std::unique_ptr<SaveJob> job = std::move(g_SaveJobs.front());
+    g_SaveJobs.pop_front();
 
-    if (g_BackgroundTexture.id != 0) {
-        UnloadTexture(g_BackgroundTexture);
-        g_BackgroundTexture = {};
+    if (!job->ok) {
+        MessageBoxAsync("Error", "Failed to save image.", "ok", "error", 1);
+    } else if (job->version == g_DocumentVersion && job->dst == g_CurrentFile) {
+        g_HasUnsavedChanges = false;
     }
-    if (g_BackgroundImage.data != nullptr) {
-        UnloadImage(g_BackgroundImage);
-        g_BackgroundImage = {};
+    StartNextSaveJob();
+}
+
+// Blocks until every queued save has been written (used on exit).
+static void FinishSaveJobs() {
+    while (!g_SaveJobs.empty()) {
+        WaitJob(g_SaveJobs.front()->task);
+        RunMainThreadPosts();
     }
+}
+
+static void DrawSaveProgress(int x, int y, int w, int h) {
+    if (g_SaveJobs.empty()) return;
+
+    float p = std::clamp(g_SaveJobs.front()->progress.load(), 0.0f, 1.0f);
+    DrawRectangle(x, y, w, h, Color{245,245,245,255});
+    DrawRectangle(x, y, (int)(w * p), h, SKYBLUE);
+    DrawRectangleLines(x, y, w, h, BLACK);
+
+    const char *label = (g_SaveJobs.size() > 1)
+        ? TextFormat("Saving %d%% (+%d)", (int)(p * 100), (int)g_SaveJobs.size() - 1)
+        : TextFormat("Saving %d%%", (int)(p * 100));
+    DrawText(label, x + 6, y + (h - 14) / 2, 14, BLACK);
+}
+
+void DoExportImage(const std::string &dst, int canvasW, int canvasH) {
+    auto job = std::make_unique<SaveJob>();
+    job->dst = dst;
+    job->img = RenderCanvasImage(canvasW, canvasH);
+    job->version = g_DocumentVersion;
+    job->png = IsFileExtension(dst.c_str(), ".png");
+    job->pngOptions = g_PngOptions;
+    job->paletteOptions = g_PaletteOptions;
+
+    g_SaveJobs.push_back(std::move(job));
+    StartNextSaveJob();
+}
+
+static void ResetDocument() {
+    CancelOpen();
+    ResetLayers();
+    SetBackground(nullptr);
+    g_Selection = SelectionMask();
 
     g_CurrentFile.clear();
     g_UndoStack.clear();
     g_RedoStack.clear();
     g_HasUnsavedChanges = false;
+    ++g_DocumentVersion;
 }
 
-void RecreateRenderTex(int canvasW, int canvasH) {
-    if (g_RenderTex.texture.id != 0) UnloadRenderTexture(g_RenderTex);
-    g_RenderTex = LoadRenderTexture(canvasW, canvasH);
+void File_New() {
+    if (!g_HasUnsavedChanges) {
+        ResetDocument();
+        return;
+    }
+
+    MessageBoxAsync("Unsaved Changes", "Do you want to save the current file?",
+        "yesno", "question", 1, [](const DialogResult &r) {
+            if (r.button != 1) {
+                ResetDocument();
+                return;
+            }
+            if (!g_CurrentFile.empty()) {
+                DoExportImage(g_CurrentFile, g_CanvasWidth, g_CanvasHeight);
+                ResetDocument();
+                return;
+            }
+            SaveFileDialogAsync("Save As", "image.png", {"*.png"}, "PNG files", [](const DialogResult &s) {
+                if (!s.ok) return;
+                g_CurrentFile = s.text;
+                DoExportImage(g_CurrentFile, g_CanvasWidth, g_CanvasHeight);
+                ResetDocument();
+            });
+        });
 }
 
-void File_Open() {
-    if (g_HasUnsavedChanges) {
-        int result = tinyfd_messageBox("Unsaved Changes",
-            "Do you want to save the current file before opening another?",
-            "yesno", "question", 1);
+// --- Canvas camera ---
+// The document is viewed through a 2-D camera: `offset` is the top-left of
+// the canvas area on screen, `target` the document point shown there.
+Camera2D g_Camera = { { 0, 0 }, { 0, 0 }, 0.0f, 1.0f };
+static bool g_Panning = false;
+
+static const float kMinZoom = 1.0f / 64.0f;
+static const float kMaxZoom = 64.0f;
 
-        if (result == 1) {
-            File_Save();
+static Vector2 ScreenToDocument(Vector2 p) {
+    return GetScreenToWorld2D(p, g_Camera);
+}
+
+// Document-space rectangle visible in the canvas area.
+static Rectangle VisibleDocumentRect() {
+    Vector2 a = ScreenToDocument({ (float)toolbarWidth, (float)menuBarHeight });
+    Vector2 b = ScreenToDocument({ (float)g_ScreenWidth, (float)g_ScreenHeight });
+    return { a.x, a.y, b.x - a.x, b.y - a.y };
+}
+
+// Zooms out (never in) until the whole canvas fits, and centres it.
+static void FitCanvasInView() {
+    float viewW = (float)(g_ScreenWidth - toolbarWidth);
+    float viewH = (float)(g_ScreenHeight - menuBarHeight);
+    float canvasW = (float)std::max(1, g_CanvasWidth);
+    float canvasH = (float)std::max(1, g_CanvasHeight);
+
+    g_Camera.offset = { (float)toolbarWidth, (float)menuBarHeight };
+    g_Camera.zoom = std::clamp(std::min({ 1.0f, viewW / canvasW, viewH / canvasH }), kMinZoom, kMaxZoom);
+    g_Camera.target = { (canvasW - viewW / g_Camera.zoom) * 0.5f, (canvasH - viewH / g_Camera.zoom) * 0.5f };
+}
+
+// Wheel zooms around the cursor; middle drag or Space + left drag pans;
+// Ctrl+0 fits the canvas, Ctrl+1 shows it at 100%.
+static void UpdateCanvasCamera(Vector2 mouse, bool overCanvas) {
+    g_Camera.offset = { (float)toolbarWidth, (float)menuBarHeight };
+
+    float wheel = GetMouseWheelMove();
+    if (overCanvas && wheel != 0.0f) {
+        Vector2 anchor = ScreenToDocument(mouse);
+        g_Camera.zoom = std::clamp(g_Camera.zoom * powf(1.15f, wheel), kMinZoom, kMaxZoom);
+        // keep the document point under the cursor fixed
+        Vector2 after = ScreenToDocument(mouse);
+        g_Camera.target.x += anchor.x - after.x;
+        g_Camera.target.y += anchor.y - after.y;
+    }
+
+    bool spacePan = IsKeyDown(KEY_SPACE) && IsMouseButtonDown(MOUSE_LEFT_BUTTON);
+    if (overCanvas && (IsMouseButtonPressed(MOUSE_MIDDLE_BUTTON) || (IsKeyDown(KEY_SPACE) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON))))
+        g_Panning = true;
+    if (!IsMouseButtonDown(MOUSE_MIDDLE_BUTTON) && !spacePan)
+        g_Panning = false;
+    if (g_Panning) {
+        Vector2 d = GetMouseDelta();
+        g_Camera.target.x -= d.x / g_Camera.zoom;
+        g_Camera.target.y -= d.y / g_Camera.zoom;
+    }
+
+    if (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) {
+        if (IsKeyPressed(KEY_ZERO)) FitCanvasInView();
+        if (IsKeyPressed(KEY_ONE)) {
+            Vector2 centre = ScreenToDocument({ (toolbarWidth + g_ScreenWidth) * 0.5f, (menuBarHeight + g_ScreenHeight) * 0.5f });
+            g_Camera.zoom = 1.0f;
+            g_Camera.target = { centre.x - (g_ScreenWidth - toolbarWidth) * 0.5f, centre.y - (g_ScreenHeight - menuBarHeight) * 0.5f };
         }
     }
+}
+
+// --- Asynchronous open ---
+// LoadImage, the RGBA conversion and the split into background tiles run on
+// a worker thread. A small preview is published as soon as the file is
+// decoded; the current document stays editable until the tiles are ready and
+// replace it. Nothing is uploaded up front: the background pyramid builds
+// its coarser levels in the background and streams in the visible tiles.
+enum OpenStage {
+    OPEN_LOADING = 0,   // worker is decoding the file
+    OPEN_PREVIEW,       // preview pixels ready, worker is converting and tiling
+    OPEN_DECODED,       // background is ready to be swapped in
+    OPEN_FAILED
+};
+
+struct OpenJob {
+    std::string path;
+    uint64_t version = 0;            // g_DocumentVersion when the open started
+    std::atomic<int> stage{OPEN_LOADING};
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> finished{false};
+    JobRef task;
+
+    std::shared_ptr<const BackgroundSnapshot> background;  // written by the worker before OPEN_DECODED
+    std::vector<Color> previewPixels;
+    int previewW = 0, previewH = 0;
+    Texture2D preview = {};
+    bool confirming = false;         // waiting for the discard-changes answer
+};
 
-    const char* patterns[] = {"*.png"};
-    const char** pp = patterns;
+static const int kOpenPreviewSide = 256;
 
-    const char* file = tinyfd_openFileDialog("Open PNG", "", 1, pp, "PNG images", 0);
-    if (!file) return;
+static std::unique_ptr<OpenJob> g_OpenJob;
+// Cancelled jobs whose worker is still inside LoadImage; freed once it returns.
+static std::vector<std::unique_ptr<OpenJob>> g_CancelledOpens;
 
-    Image img = LoadImage(file);
-    if (img.data == nullptr) {
-        tinyfd_messageBox("Error", "Failed to open image.", "ok", "error", 1);
+static void RunOpenJob(OpenJob *job) {
+    Image img = LoadImage(job->path.c_str());
+    if (img.data == nullptr || job->cancel.load()) {
+        if (img.data != nullptr) UnloadImage(img);
+        job->stage = OPEN_FAILED;
+        job->finished.store(true, std::memory_order_release);
         return;
     }
 
-    ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-
-    if (g_BackgroundTexture.id != 0) {
-        UnloadTexture(g_BackgroundTexture);
-        g_BackgroundTexture = {};
+    // point-sampled preview, straight from the decoded format
+    float fit = std::min(1.0f, (float)kOpenPreviewSide / (float)std::max(img.width, img.height));
+    job->previewW = std::max(1, (int)(img.width * fit));
+    job->previewH = std::max(1, (int)(img.height * fit));
+    job->previewPixels.resize((size_t)job->previewW * job->previewH);
+    for (int y = 0; y < job->previewH; ++y) {
+        int sy = (int)(((long long)y * img.height) / job->previewH);
+        for (int x = 0; x < job->previewW; ++x) {
+            int sx = (int)(((long long)x * img.width) / job->previewW);
+            job->previewPixels[(size_t)y * job->previewW + x] = GetImageColor(img, sx, sy);
+        }
     }
-    if (g_BackgroundImage.data != nullptr) {
-        UnloadImage(g_BackgroundImage);
-        g_BackgroundImage = {};
+    job->stage.store(OPEN_PREVIEW, std::memory_order_release);
+
+    if (!job->cancel.load()) {
+        // the decoded image is only needed until it is tiled
+        ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        job->background = TileBackground(img);
     }
+    UnloadImage(img);
+    job->stage.store(job->cancel.load() || !job->background ? OPEN_FAILED : OPEN_DECODED, std::memory_order_release);
+    job->finished.store(true, std::memory_order_release);
+}
+
+static void ReleaseOpenJob(OpenJob &job) {
+    if (job.task) WaitJob(job.task);
+    if (job.preview.id != 0) UnloadTexture(job.preview);
+    job.preview = {};
+    job.background.reset();
+}
 
-    g_BackgroundImage = img;
-    g_BackgroundTexture = LoadTextureFromImage(g_BackgroundImage);
+static void CancelOpen() {
+    if (!g_OpenJob) return;
+    g_OpenJob->cancel = true;
+    g_CancelledOpens.push_back(std::move(g_OpenJob));
+}
 
-    int newWindowW = toolbarWidth + g_BackgroundImage.width;
-    int newWindowH = menuBarHeight + g_BackgroundImage.height;
-    g_ScreenWidth = newWindowW;
-    g_ScreenHeight = newWindowH;
-    SetWindowSize(g_ScreenWidth, g_ScreenHeight);
+// Swaps the loaded image in as the new document (the tail of the old
+// synchronous File_Open).
+static void CommitOpenJob(OpenJob &job) {
+    SetBackground(std::move(job.background));
 
-    RecreateRenderTex(g_BackgroundImage.width, g_BackgroundImage.height);
+    // the window keeps its size; the camera fits the new canvas instead
+    g_CanvasWidth = BackgroundWidth();
+    g_CanvasHeight = BackgroundHeight();
+    g_Selection = SelectionMask();
+    FitCanvasInView();
 
-    g_CanvasStrokes.clear();
+    ResetLayers();
     g_UndoStack.clear();
-    g_RedoStack.clear(); 
+    g_RedoStack.clear();
 
-    g_CurrentFile = file;
+    g_CurrentFile = job.path;
     g_HasUnsavedChanges = false;
+    ++g_DocumentVersion;
 }
 
-void File_SaveAs() {
-    const char* patterns[] = {"*.png"};
-    const char** pp = patterns;
+// Called once per frame: uploads the preview and commits the document once
+// the worker has tiled the image.
+static void PollOpenJob() {
+    for (size_t i = 0; i < g_CancelledOpens.size();) {
+        if (g_CancelledOpens[i]->finished.load(std::memory_order_acquire)) {
+            ReleaseOpenJob(*g_CancelledOpens[i]);
+            g_CancelledOpens.erase(g_CancelledOpens.begin() + i);
+        } else {
+            ++i;
+        }
+    }
 
-    const char* dst = tinyfd_saveFileDialog("Save As", "image.png", 1, pp, "PNG files");
-    if (!dst) return;
+    if (!g_OpenJob) return;
+    OpenJob &job = *g_OpenJob;
+    int stage = job.stage.load(std::memory_order_acquire);
 
-    g_CurrentFile = dst;
+    if (stage == OPEN_FAILED) {
+        ReleaseOpenJob(job);
+        g_OpenJob.reset();
+        MessageBoxAsync("Error", "Failed to open image.", "ok", "error", 1);
+        return;
+    }
 
-    int canvasW = g_RenderTex.texture.width;
-    int canvasH = g_RenderTex.texture.height;
-    DoExportImage(g_CurrentFile, canvasW, canvasH);
+    if (stage >= OPEN_PREVIEW && job.preview.id == 0) {
+        Image p = { job.previewPixels.data(), job.previewW, job.previewH, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+        job.preview = LoadTextureFromImage(p);
+        SetTextureFilter(job.preview, TEXTURE_FILTER_BILINEAR);
+    }
 
-    g_HasUnsavedChanges = false;
+    if (stage != OPEN_DECODED || job.confirming) return;
+
+    if (g_DocumentVersion != job.version) {
+        // the job may be cancelled while the question is up, so the answer
+        // only applies if it is still the pending open
+        job.confirming = true;
+        OpenJob *asked = &job;
+        MessageBoxAsync("Open",
+            "The current drawing changed while the image was loading. Discard those changes?",
+            "yesno", "question", 0, [asked](const DialogResult &r) {
+                if (g_OpenJob.get() != asked || !asked->confirming) return;
+                std::unique_ptr<OpenJob> done = std::move(g_OpenJob);
+                if (r.button == 1) CommitOpenJob(*done);
+                ReleaseOpenJob(*done);
+            });
+        return;
+    }
+
+    std::unique_ptr<OpenJob> done = std::move(g_OpenJob);
+    CommitOpenJob(*done);
+    ReleaseOpenJob(*done);
+}
+
+// Preview card in the lower right corner of the canvas.
+static Rectangle OpenCardRect() {
+    float w = kOpenPreviewSide * 0.75f + 20.0f;
+    float h = kOpenPreviewSide * 0.75f + 70.0f;
+    return { g_ScreenWidth - w - 10.0f, g_ScreenHeight - h - 10.0f, w, h };
+}
+
+static bool OpenCardHit(Vector2 mouse) {
+    return g_OpenJob && CheckCollisionPointRec(mouse, OpenCardRect());
+}
+
+static void DrawOpenProgress(Vector2 mouse) {
+    if (!g_OpenJob) return;
+    OpenJob &job = *g_OpenJob;
+    Rectangle card = OpenCardRect();
+    DrawRectangleRec(card, Color{245,245,245,235});
+    DrawRectangleLinesEx(card, 1, BLACK);
+
+    float side = kOpenPreviewSide * 0.75f;
+    Rectangle area = { card.x + 10, card.y + 10, side, side };
+    if (job.preview.id != 0) {
+        float fit = std::min(side / job.preview.width, side / job.preview.height);
+        float pw = job.preview.width * fit, ph = job.preview.height * fit;
+        Rectangle dst = { area.x + (side - pw) * 0.5f, area.y + (side - ph) * 0.5f, pw, ph };
+        DrawTexturePro(job.preview, { 0, 0, (float)job.preview.width, (float)job.preview.height }, dst, { 0, 0 }, 0.0f, WHITE);
+    } else {
+        DrawRectangleRec(area, Color{220,220,220,255});
+    }
+
+    int stage = job.stage.load(std::memory_order_acquire);
+    float p = 0.0f;
+    const char *label = "Loading...";
+    if (stage == OPEN_PREVIEW) {
+        p = 0.5f;
+        label = "Converting...";
+    }
+    if (stage == OPEN_DECODED) {
+        p = 1.0f;
+        label = "Waiting...";
+    }
+
+    int barY = (int)(area.y + side + 8);
+    DrawRectangle((int)area.x, barY, (int)side, 8, WHITE);
+    DrawRectangle((int)area.x, barY, (int)(side * p), 8, SKYBLUE);
+    DrawRectangleLines((int)area.x, barY, (int)side, 8, BLACK);
+    DrawText(label, (int)area.x, barY + 14, 14, BLACK);
+
+    Rectangle cancelBtn = { card.x + card.width - 70, (float)barY + 12, 60, 20 };
+    bool hover = CheckCollisionPointRec(mouse, cancelBtn);
+    DrawRectangleRec(cancelBtn, hover ? GRAY : LIGHTGRAY);
+    DrawRectangleLinesEx(cancelBtn, 1, BLACK);
+    DrawText("Cancel", (int)cancelBtn.x + 8, (int)cancelBtn.y + 3, 14, BLACK);
+    if (hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) CancelOpen();
+}
+
+// Blocks until cancelled workers have returned (used on exit).
+static void FinishOpenJobs() {
+    CancelOpen();
+    for (auto &job : g_CancelledOpens) ReleaseOpenJob(*job);
+    g_CancelledOpens.clear();
+}
+
+static void StartOpenJob(const std::string &file) {
+    CancelOpen();
+    g_OpenJob = std::make_unique<OpenJob>();
+    g_OpenJob->path = file;
+    g_OpenJob->version = g_DocumentVersion;
+    OpenJob *job = g_OpenJob.get();
+    job->task = RunJob("open", [job] { RunOpenJob(job); });
+}
+
+static void PickFileToOpen() {
+    OpenFileDialogAsync("Open PNG", "", {"*.png"}, "PNG images", [](const DialogResult &r) {
+        if (r.ok) StartOpenJob(r.text);
+    });
+}
+
+void File_Open() {
+    if (!g_HasUnsavedChanges) {
+        PickFileToOpen();
+        return;
+    }
+
+    MessageBoxAsync("Unsaved Changes",
+        "Do you want to save the current file before opening another?",
+        "yesno", "question", 1, [](const DialogResult &r) {
+            // dialogs run in order, so a Save As prompted here is answered
+            // before the open dialog appears
+            if (r.button == 1) File_Save();
+            PickFileToOpen();
+        });
+}
+
+void File_SaveAs() {
+    SaveFileDialogAsync("Save As", "image.png", {"*.png"}, "PNG files", [](const DialogResult &r) {
+        if (!r.ok) return;
+        g_CurrentFile = r.text;
+
+        DoExportImage(g_CurrentFile, g_CanvasWidth, g_CanvasHeight);
+    });
 }
 
 void File_Save() {
@@ -262,64 +721,305 @@ void File_Save() {
         return;
     }
 
-    int canvasW = g_RenderTex.texture.width;
-    int canvasH = g_RenderTex.texture.height;
-    DoExportImage(g_CurrentFile, canvasW, canvasH);
+    DoExportImage(g_CurrentFile, g_CanvasWidth, g_CanvasHeight);
+}
 
-    g_HasUnsavedChanges = false;
+// --- Offscreen document rendering ---
+// Shared by saving and the tiled export: each visible layer is drawn into
+// `scratch` and blended into `out` the same way the canvas view does.
+
+static void DrawStrokePoints(const CanvasStroke &stroke, const std::vector<Vector2> &points) {
+    if (stroke.symmetry) {
+        DrawSymmetricStroke(stroke, points);
+        return;
+    }
+    for (size_t i = 1; i < points.size(); ++i) {
+        DrawLineEx(points[i-1], points[i], stroke.size, stroke.color);
+        DrawCircleV(points[i], stroke.size*0.5f, stroke.color);
+    }
 }
 
-// Helper to duplicate current background image pixels into vector
-static void CaptureBackgroundPixels(AppState &s) {
-    s.bgPixels.clear();
-    if (g_BackgroundImage.data != nullptr && g_BackgroundImage.width > 0 && g_BackgroundImage.height > 0) {
-        s.hasBg = true;
-        s.bgW = g_BackgroundImage.width;
-        s.bgH = g_BackgroundImage.height;
-        int bytes = s.bgW * s.bgH * 4;
-        unsigned char *src = (unsigned char*)g_BackgroundImage.data;
-        s.bgPixels.assign(src, src + bytes);
-    } else {
-        s.hasBg = false;
-        s.bgW = s.bgH = 0;
+// Renders `view` (document space) of `doc` through `cam` into `out`.
+// `opaque` composites over white; otherwise only a document without a
+// background image is white and erased background pixels stay transparent.
+// `out` and `scratch` must be the same size; the result is premultiplied.
+// Brush strokes are stamped at this resolution into `brush`, loaded on first
+// use at that size as well (the caller unloads it).
+static void RenderDocumentTile(const DocumentSnapshot &doc, const BackgroundLevels &background,
+                               const Camera2D &cam, Rectangle view, bool opaque,
+                               RenderTexture2D &out, RenderTexture2D &scratch, RenderTexture2D &brush) {
+    BeginTextureMode(out);
+    ClearBackground(opaque ? WHITE : BLANK);
+    if (!background.source) {
+        BeginMode2D(cam);
+        DrawRectangle(0, 0, doc.canvasW, doc.canvasH, WHITE);
+        EndMode2D();
+    }
+    EndTextureMode();
+
+    Rectangle dst = { 0, 0, (float)out.texture.width, (float)out.texture.height };
+    for (size_t l = 0; l < doc.layers.size(); ++l) {
+        const LayerSnapshot &layer = doc.layers[l];
+        if (!layer.visible) continue;
+
+        BeginTextureMode(scratch);
+        ClearBackground(BLANK);
+        BeginMode2D(cam);
+        BeginLayerContent();
+        if (l == 0 && background.source) g_BackgroundPyramid.Draw(background, view, cam.zoom, true);
+        for (const auto &stroke : layer.strokes) {
+            if (stroke->erased || stroke->points.size() < 2) continue;
+            if (!CheckCollisionRecs(stroke->bounds, view)) continue;
+            if (stroke->brush) {
+                // stamped alone, then blended in at the stroke's opacity
+                EndLayerContent();
+                EndMode2D();
+                EndTextureMode();
+                if (brush.texture.id == 0) brush = LoadRenderTexture(scratch.texture.width, scratch.texture.height);
+                g_Brushes.RenderStroke(*stroke, cam, brush);
+                BeginTextureMode(scratch);
+                CompositeLayer(brush, dst, stroke->brush->opacity, LAYER_BLEND_NORMAL);
+                BeginMode2D(cam);
+                BeginLayerContent();
+                continue;
+            }
+            DrawStrokePoints(*stroke, stroke->points);
+        }
+        EndLayerContent();
+        EndMode2D();
+        EndTextureMode();
+
+        BeginTextureMode(out);
+        CompositeLayer(scratch, dst, layer.opacity, layer.blend);
+        EndTextureMode();
     }
 }
 
-static void ApplyBackgroundFromState(const AppState &s) {
-    if (g_BackgroundTexture.id != 0) {
-        UnloadTexture(g_BackgroundTexture);
-        g_BackgroundTexture = {};
+// --- Tiled high-resolution export ---
+// Renders the document at `scale` times its size (optionally supersampled)
+// through one small reusable render texture, a strip of tiles per step, so
+// the output is limited neither by the window nor by the GPU texture size.
+// Each finished strip is flattened, box-filtered and streamed to the PNG
+// writer; memory stays at one strip plus the bands being compressed.
+static const int kExportTileW = 2048;  // render texture size, in render pixels
+static const int kExportTileH = 256;
+static const int kMaxExportSide = 100000;
+
+struct TiledExport {
+    std::string dst;
+    float scale = 1.0f;
+    int supersample = 1;
+    int outW = 0, outH = 0;
+    int tileW = 0, tileH = 0;   // output pixels per tile
+    int nextRow = 0;
+
+    DocumentSnapshotRef doc;    // taken when the export starts
+    int canvasW = 0, canvasH = 0;
+    std::shared_ptr<const BackgroundLevels> background;  // pyramid of doc->background; null until ready
+    JobRef levelsJob;  // builds `background` when the live pyramid moved past the snapshot
+    std::shared_ptr<std::shared_ptr<const BackgroundLevels>> levelsResult;
+    RenderTexture2D target = {};
+    RenderTexture2D layer = {};  // one layer at a time, composited into `target`
+    RenderTexture2D brush = {};  // one brush stroke at a time, composited into `layer`
+
+    std::vector<uint8_t> strip;         // outW * tileH RGB rows
+    PngStreamWriter writer;
+    bool ok = true;
+};
+
+static std::unique_ptr<TiledExport> g_TiledExport;
+
+// Renders output tile (x0, y0) and writes its flattened, downsampled rows into the strip.
+static void RenderExportTile(TiledExport &ex, int x0, int y0) {
+    const int ss = ex.supersample;
+    const int cols = std::min(ex.tileW, ex.outW - x0);
+    const int rows = std::min(ex.tileH, ex.outH - y0);
+    const int rw = ex.tileW * ss;
+    const int rh = ex.tileH * ss;
+
+    Rectangle view = { x0 / ex.scale, y0 / ex.scale, ex.tileW / ex.scale, ex.tileH / ex.scale };
+
+    Camera2D cam = {};
+    cam.zoom = ex.scale * ss;
+    cam.target = { view.x, view.y };
+
+    // composited over white, so the tile comes back opaque
+    RenderDocumentTile(*ex.doc, *ex.background, cam, view, true, ex.target, ex.layer, ex.brush);
+
+    // readback is bottom-up
+    unsigned char *px = (unsigned char *)rlReadTexturePixels(ex.target.texture.id, rw, rh, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    g_BackgroundPyramid.Trim();
+    if (!px) { ex.ok = false; return; }
+
+    const size_t scratchStride = (size_t)cols * ss * 3;
+    ParallelFor("export tile", rows, 16, [&](int r0, int r1) {
+        thread_local std::vector<uint8_t> scratch;
+        scratch.resize(scratchStride * ss);
+        for (int r = r0; r < r1; ++r) {
+            for (int k = 0; k < ss; ++k) {
+                int renderRow = rh - 1 - (r * ss + k);
+                CompositeOverWhiteToRGB(px + (size_t)renderRow * rw * 4, scratch.data() + k * scratchStride, cols * ss);
+            }
+            BoxDownsampleRGB(scratch.data(), scratchStride, ss, cols, ex.strip.data() + ((size_t)r * ex.outW + x0) * 3);
+        }
+    });
+    MemFree(px);
+}
+
+static void FinishTiledExport() {
+    TiledExport &ex = *g_TiledExport;
+    ex.ok = ex.writer.Close() && ex.ok;
+    if (ex.target.texture.id != 0) UnloadRenderTexture(ex.target);
+    if (ex.layer.texture.id != 0) UnloadRenderTexture(ex.layer);
+    if (ex.brush.texture.id != 0) UnloadRenderTexture(ex.brush);
+    if (!ex.ok) MessageBoxAsync("Error", "Failed to export image.", "ok", "error", 1);
+    g_TiledExport.reset();
+}
+
+// Picks up the pyramid the export reads. Downscaled exports need the coarse
+// levels of their snapshot; until those are built the export just waits,
+// without holding up the frame, unless `wait` (on exit).
+static bool ExportLevelsReady(TiledExport &ex, bool wait) {
+    if (ex.background) return true;
+    if (!ex.levelsJob) {
+        auto levels = g_BackgroundPyramid.Levels();
+        if (levels->source == ex.doc->background) {
+            // the pyramid's own build is on the way
+            if (levels->complete) ex.background = levels;
+            else if (wait) ex.background = g_BackgroundPyramid.CompleteLevels();
+            return ex.background != nullptr;
+        }
+        // the document moved on first: build the snapshot's levels for the export alone
+        auto src = ex.doc->background;
+        auto result = std::make_shared<std::shared_ptr<const BackgroundLevels>>();
+        ex.levelsResult = result;
+        ex.levelsJob = RunJob("export pyramid", [src, levels, result] { *result = BuildBackgroundLevels(src, levels.get()); });
     }
-    if (g_BackgroundImage.data != nullptr) {
-        UnloadImage(g_BackgroundImage);
-        g_BackgroundImage = {};
+    if (wait) WaitJob(ex.levelsJob);
+    else if (!IsJobDone(ex.levelsJob)) return false;
+    ex.background = std::move(*ex.levelsResult);
+    ex.levelsJob.reset();
+    ex.levelsResult.reset();
+    return true;
+}
+
+// Called once per frame: renders strips until the frame budget is used up.
+// `wait` blocks for the pyramid instead of returning until it is built.
+static void StepTiledExport(bool wait = false) {
+    if (!g_TiledExport) return;
+    TiledExport &ex = *g_TiledExport;
+    if (!ExportLevelsReady(ex, wait)) return;
+
+    double start = GetTime();
+    while (ex.ok && ex.nextRow < ex.outH && GetTime() - start < 0.010) {
+        int rows = std::min(ex.tileH, ex.outH - ex.nextRow);
+        for (int x0 = 0; x0 < ex.outW && ex.ok; x0 += ex.tileW) RenderExportTile(ex, x0, ex.nextRow);
+        ex.ok = ex.ok && ex.writer.WriteRows(ex.strip.data(), rows);
+        ex.nextRow += rows;
     }
 
-    if (!s.hasBg) {
+    if (!ex.ok || ex.nextRow >= ex.outH) FinishTiledExport();
+}
+
+static void DrawExportProgress(int x, int y, int w, int h) {
+    if (!g_TiledExport) return;
+
+    float p = (float)g_TiledExport->nextRow / (float)std::max(1, g_TiledExport->outH);
+    DrawRectangle(x, y, w, h, Color{245,245,245,255});
+    DrawRectangle(x, y, (int)(w * p), h, LIME);
+    DrawRectangleLines(x, y, w, h, BLACK);
+    const char *label = g_TiledExport->background ? TextFormat("Export %d%%", (int)(p * 100)) : "Export: preparing";
+    DrawText(label, x + 6, y + (h - 14) / 2, 14, BLACK);
+}
+
+static void StartTiledExport(const std::string &dst, float scale, int ss) {
+    int canvasW = g_CanvasWidth;
+    int canvasH = g_CanvasHeight;
+    int outW = (int)(canvasW * scale + 0.5f);
+    int outH = (int)(canvasH * scale + 0.5f);
+    if (outW < 1 || outH < 1 || outW > kMaxExportSide || outH > kMaxExportSide) {
+        MessageBoxAsync("Error", "Export size is out of range.", "ok", "error", 1);
         return;
     }
 
-    int bytes = s.bgW * s.bgH * 4;
-    Image img = {};
-    img.width = s.bgW;
-    img.height = s.bgH;
-    img.mipmaps = 1;
-    img.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
-    img.data = malloc(bytes);
-    if (!img.data) {
+    auto ex = std::make_unique<TiledExport>();
+    ex->dst = dst;
+    ex->scale = scale;
+    ex->supersample = ss;
+    ex->outW = outW;
+    ex->outH = outH;
+    ex->tileW = kExportTileW / ss;
+    ex->tileH = kExportTileH / ss;
+    ex->canvasW = canvasW;
+    ex->canvasH = canvasH;
+
+    ex->doc = CurrentDocument();
+    // level 0 is the snapshot itself; coarser levels are only read when the
+    // export renders below 1:1, and StepTiledExport waits for those
+    auto levels = g_BackgroundPyramid.Levels();
+    if (levels->complete || scale * ss >= 1.0f) ex->background = levels;
+    ex->target = LoadRenderTexture(kExportTileW, kExportTileH);
+    ex->layer = LoadRenderTexture(kExportTileW, kExportTileH);
+    ex->strip.resize((size_t)outW * ex->tileH * 3);
+
+    PngFormat fmt;
+    fmt.width = outW;
+    fmt.height = outH;
+    fmt.colorType = PNG_RGB;
+    g_TiledExport = std::move(ex);
+    if (!g_TiledExport->writer.Open(dst, fmt, g_PngOptions)) {
+        g_TiledExport->ok = false;
+        FinishTiledExport();
+    }
+}
+
+void File_ExportHiRes() {
+    if (g_TiledExport) {
+        MessageBoxAsync("Export", "An export is already running.", "ok", "info", 1);
         return;
     }
-    memcpy(img.data, s.bgPixels.data(), bytes);
 
-    g_BackgroundImage = img;
-    g_BackgroundTexture = LoadTextureFromImage(g_BackgroundImage);
-    RecreateRenderTex(g_BackgroundImage.width, g_BackgroundImage.height);
+    InputBoxAsync("Export Hi-Res",
+        "Scale factor and supersampling (1, 2 or 4), e.g. \"4 2\"", "4 1", [](const DialogResult &r) {
+            if (!r.ok) return;
+
+            float scale = 0.0f;
+            int ss = 1;
+            if (sscanf(r.text.c_str(), "%f %d", &scale, &ss) < 1 || scale <= 0.0f || (ss != 1 && ss != 2 && ss != 4)) {
+                MessageBoxAsync("Error", "Invalid scale or supersampling.", "ok", "error", 1);
+                return;
+            }
+
+            int outW = (int)(g_CanvasWidth * scale + 0.5f);
+            int outH = (int)(g_CanvasHeight * scale + 0.5f);
+            if (outW < 1 || outH < 1 || outW > kMaxExportSide || outH > kMaxExportSide) {
+                MessageBoxAsync("Error", "Export size is out of range.", "ok", "error", 1);
+                return;
+            }
+
+            // the document is snapshotted when the path comes back, not now
+            SaveFileDialogAsync("Export Hi-Res", "export.png", {"*.png"}, "PNG files", [scale, ss](const DialogResult &s) {
+                if (!s.ok) return;
+                if (g_TiledExport) {
+                    MessageBoxAsync("Export", "An export is already running.", "ok", "info", 1);
+                    return;
+                }
+                StartTiledExport(s.text, scale, ss);
+            });
+        });
 }
 
-static void PushState() {
+static void ApplyBackgroundFromState(const AppState &s) {
+    // shares the state's tiles; painting copies them again
+    SetBackground(s.doc->background);
+    if (s.doc->canvasW != g_CanvasWidth || s.doc->canvasH != g_CanvasHeight) g_Selection = SelectionMask();
+    g_CanvasWidth = s.doc->canvasW;
+    g_CanvasHeight = s.doc->canvasH;
+}
+
+static void PushState(DocumentSnapshotRef doc) {
     AppState s;
-    s.strokes = g_CanvasStrokes;
-    CaptureBackgroundPixels(s);
+    s.doc = std::move(doc);
 
     g_UndoStack.push_back(std::move(s));
     // cap size
@@ -327,17 +1027,36 @@ static void PushState() {
     g_RedoStack.clear();
 }
 
+static void PushState() {
+    PushState(CurrentDocument());
+}
+
+// A press on the canvas is one undo step, but only once its tool edited
+// something: the document from before the press is pushed then. Picks,
+// selections and samples leave the undo stack alone.
+static DocumentSnapshotRef g_PressDocument;
+
 static void ApplyState(const AppState &s) {
-    g_CanvasStrokes = s.strokes;
+    g_CurrentStroke = nullptr;
+    g_Layers.clear();
+    for (const auto &snap : s.doc->layers) {
+        Layer layer;
+        static_cast<LayerProps &>(layer) = snap;
+        layer.strokes.reserve(snap.strokes.size());
+        for (const auto &stroke : snap.strokes) layer.strokes.push_back(*stroke);
+        g_Layers.push_back(std::move(layer));
+    }
+    g_ActiveLayer = std::clamp(g_ActiveLayer, 0, (int)g_Layers.size() - 1);
     ApplyBackgroundFromState(s);
-    g_HasUnsavedChanges = true;
+
+    // every layer is re-rendered; the cheap way to catch the ones that differ
+    MarkAllLayersChanged();
 }
 
 static void DoUndo() {
     if (g_UndoStack.empty()) return;
     AppState current;
-    current.strokes = g_CanvasStrokes;
-    CaptureBackgroundPixels(current);
+    current.doc = CurrentDocument();
     g_RedoStack.push_back(std::move(current));
     AppState last = std::move(g_UndoStack.back());
     g_UndoStack.pop_back();
@@ -347,8 +1066,7 @@ static void DoUndo() {
 static void DoRedo() {
     if (g_RedoStack.empty()) return;
     AppState current;
-    current.strokes = g_CanvasStrokes;
-    CaptureBackgroundPixels(current);
+    current.doc = CurrentDocument();
     g_UndoStack.push_back(std::move(current));
 
     AppState next = std::move(g_RedoStack.back());
@@ -357,84 +1075,1331 @@ static void DoRedo() {
 }
 
 
+// Renders the document through an offscreen target one tile at a time and
+// reads it back, so the canvas may be larger than a GPU texture. The image
+// is bottom-up (OpenGL row order) and still has its alpha.
+static const int kCanvasRenderTile = 2048;
+
+// Kept between calls (saves, bucket fills) and only reloaded when the tile
+// size changes; released on exit.
+struct CanvasRenderTargets {
+    RenderTexture2D target = {};
+    RenderTexture2D layer = {};
+    RenderTexture2D brush = {};  // loaded by RenderDocumentTile on first use
+};
+static CanvasRenderTargets g_CanvasRender;
+
+static void FitRenderTexture(RenderTexture2D &rt, int w, int h) {
+    if (rt.texture.id != 0 && rt.texture.width == w && rt.texture.height == h) return;
+    if (rt.texture.id != 0) UnloadRenderTexture(rt);
+    rt = LoadRenderTexture(w, h);
+}
+
+static void ReleaseCanvasRenderTargets() {
+    for (RenderTexture2D *rt : { &g_CanvasRender.target, &g_CanvasRender.layer, &g_CanvasRender.brush })
+        if (rt->texture.id != 0) UnloadRenderTexture(*rt);
+    g_CanvasRender = {};
+}
+
+// Sizes the targets for blocks of a `canvasW` x `canvasH` canvas.
+static void FitCanvasRenderTargets(int canvasW, int canvasH) {
+    int tw = std::min(kCanvasRenderTile, canvasW);
+    int th = std::min(kCanvasRenderTile, canvasH);
+    FitRenderTexture(g_CanvasRender.target, tw, th);
+    FitRenderTexture(g_CanvasRender.layer, tw, th);
+    if (g_CanvasRender.brush.texture.id != 0) FitRenderTexture(g_CanvasRender.brush, tw, th);
+}
+
+// Renders the `cols` x `rows` block at (x0, y0) of `doc` at document scale
+// (at most the targets' size) and reads it back with its alpha, not
+// premultiplied; block row r goes to `dst + r * stride`.
+static void ReadCanvasBlock(const DocumentSnapshot &doc, const BackgroundLevels &background,
+                            int x0, int y0, int cols, int rows, unsigned char *dst, ptrdiff_t stride) {
+    RenderTexture2D &target = g_CanvasRender.target;
+    const int tw = target.texture.width, th = target.texture.height;
+    Rectangle view = { (float)x0, (float)y0, (float)cols, (float)rows };
+    Camera2D cam = {};
+    cam.zoom = 1.0f;
+    cam.target = { view.x, view.y };
+    RenderDocumentTile(doc, background, cam, view, false, target, g_CanvasRender.layer, g_CanvasRender.brush);
+
+    // the readback is bottom-up
+    unsigned char *px = (unsigned char *)rlReadTexturePixels(target.texture.id, tw, th, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    g_BackgroundPyramid.Trim();
+    if (!px) return;
+    for (int r = 0; r < rows; ++r) {
+        unsigned char *row = dst + r * stride;
+        memcpy(row, px + (size_t)(th - 1 - r) * tw * 4, (size_t)cols * 4);
+        UnpremultiplyRGBA(row, cols);
+    }
+    MemFree(px);
+}
+
 Image RenderCanvasImage(int canvasW, int canvasH) {
-    RenderTexture2D temp = LoadRenderTexture(canvasW, canvasH);
+    Image img = {};
+    img.data = malloc((size_t)canvasW * canvasH * 4);
+    if (!img.data) return {};
+    img.width = canvasW;
+    img.height = canvasH;
+    img.mipmaps = 1;
+    img.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+
+    DocumentSnapshotRef doc = CurrentDocument();
+    std::shared_ptr<const BackgroundLevels> background = g_BackgroundPyramid.Levels();
+    FitCanvasRenderTargets(canvasW, canvasH);
+    const int tw = g_CanvasRender.target.texture.width, th = g_CanvasRender.target.texture.height;
+
+    // the result is bottom-up as well
+    const ptrdiff_t stride = -(ptrdiff_t)canvasW * 4;
+    for (int y0 = 0; y0 < canvasH; y0 += th) {
+        for (int x0 = 0; x0 < canvasW; x0 += tw) {
+            unsigned char *dst = (unsigned char *)img.data + ((size_t)(canvasH - 1 - y0) * canvasW + x0) * 4;
+            ReadCanvasBlock(*doc, *background, x0, y0, std::min(tw, canvasW - x0), std::min(th, canvasH - y0), dst, stride);
+        }
+    }
+    return img;
+}
 
-    BeginTextureMode(temp);
-    ClearBackground({ 0,0,0,0 });
+// Fills the region around `docPos`, found on the composited canvas, with
+// `color`. The canvas is rendered and read back block by block, only where
+// the region reaches. The fill goes into the background image (the bottom
+// layer's pixels), under all line work, so stroke edges stay anti-aliased
+// over it; a document without a background image gets a white one first.
+// Only the background tiles inside the region's bounds are copied, so the
+// undo state holds just that part. Pixels outside the selection are left
+// alone. Returns how many canvas blocks were rendered.
+int FillCanvasAt(const Vector2 &docPos, Color color, int tolerance, bool expandEdges) {
+    int sx = (int)floorf(docPos.x);
+    int sy = (int)floorf(docPos.y);
+    if (sx < 0 || sy < 0 || sx >= g_CanvasWidth || sy >= g_CanvasHeight) return 0;
+
+    DocumentSnapshotRef doc = CurrentDocument();
+    std::shared_ptr<const BackgroundLevels> background = g_BackgroundPyramid.Levels();
+    FitCanvasRenderTargets(g_CanvasWidth, g_CanvasHeight);
+
+    FloodFillRegion region;
+    int blocks = 0;
+    FloodFillTiled([&](int x0, int y0, int w, int h, uint8_t *rgba) {
+        ReadCanvasBlock(*doc, *background, x0, y0, w, h, rgba, (ptrdiff_t)w * 4);
+    }, std::min(g_CanvasRender.target.texture.width, g_CanvasRender.target.texture.height),
+       g_CanvasWidth, g_CanvasHeight, sx, sy, tolerance, expandEdges, region, &blocks);
+    if (region.Empty()) return blocks;
+
+    if (!HasBackground()) {
+        Image white = GenImageColor(g_CanvasWidth, g_CanvasHeight, WHITE);
+        SetBackground(TileBackground(white));
+        UnloadImage(white);
+    }
 
-    if (g_BackgroundTexture.id != 0) {
-        DrawTexture(g_BackgroundTexture, 0, 0, WHITE);
-    } else {
-        DrawRectangle(0, 0, canvasW, canvasH, WHITE);
+    uint32_t fill;
+    memcpy(&fill, &color, 4);
+    EditBackgroundWithin(ActiveSelection(), region.x0, region.y0, region.x1, region.y1, [&](const BackgroundTileEdit &t) {
+        int x0 = std::max(t.x0, region.x0), x1 = std::min(t.x0 + t.width, region.x1);
+        int y0 = std::max(t.y0, region.y0), y1 = std::min(t.y0 + t.height, region.y1);
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t *m = region.mask.data() + (size_t)(y - region.y0) * region.Width() + (x0 - region.x0);
+            uint8_t *px = t.rgba + ((size_t)(y - t.y0) * t.width + (x0 - t.x0)) * 4;
+            for (int x = 0; x < x1 - x0; ++x)
+                if (m[x]) memcpy(px + (size_t)x * 4, &fill, 4);
+        }
+    });
+    MarkBackgroundChanged();
+    return blocks;
+}
+
+// `ratart --bench fill-click` (in a hidden window): `img` becomes the whole
+// document, as if opened, and the GPU resources go again afterwards.
+void OpenBenchmarkDocument(const Image &img) {
+    ResetLayers();
+    g_CanvasWidth = img.width;
+    g_CanvasHeight = img.height;
+    SetBackground(TileBackground(img));
+    MarkAllLayersChanged();
+}
+
+void CloseBenchmarkDocument() {
+    ReleaseCanvasRenderTargets();
+    g_BackgroundPyramid.Release();
+}
+
+// Paints a gradient over the whole background (or the selection), tile by
+// tile in parallel; tiles shared with undo snapshots are copied first.
+void GradientCanvas(const GradientParams &g) {
+    if (!HasBackground()) {
+        Image white = GenImageColor(g_CanvasWidth, g_CanvasHeight, WHITE);
+        SetBackground(TileBackground(white));
+        UnloadImage(white);
     }
 
-    for (const auto &stroke : g_CanvasStrokes) {
-        if (stroke.erased) continue;
-        if (stroke.points.size() < 2) continue;
+    EditBackgroundWithin(ActiveSelection(), 0, 0, BackgroundWidth(), BackgroundHeight(), [&](const BackgroundTileEdit &t) {
+        for (int y = 0; y < t.height; ++y)
+            GradientRow(g, t.y0 + y, t.x0, t.width, t.rgba + (size_t)y * t.width * 4);
+    });
+    MarkBackgroundChanged();
+}
 
-        for (size_t i = 1; i < stroke.points.size(); ++i) {
-            Vector2 p1 = { stroke.points[i - 1].x - toolbarWidth, stroke.points[i - 1].y - menuBarHeight };
-            Vector2 p2 = { stroke.points[i].x - toolbarWidth, stroke.points[i].y - menuBarHeight };
-            DrawLineEx(p1, p2, stroke.size, stroke.color);
-            DrawCircleV(p2, stroke.size * 0.5f, stroke.color);
+void EraseBackgroundAt(const Vector2 &docPos, float radius) {
+    // the background image belongs to the bottom layer
+    if (!HasBackground() || g_ActiveLayer != 0) return;
+
+    int ix = (int)docPos.x;
+    int iy = (int)docPos.y;
+    int r = (int)radius;
+    int r2 = (int)(radius*radius);
+
+    // tiles under the dab are erased in parallel, each copied first if an
+    // undo state still holds it; unselected tiles are skipped
+    EditBackgroundWithin(ActiveSelection(), ix - r, iy - r, ix + r + 1, iy + r + 1, [&](const BackgroundTileEdit &t) {
+        int x0 = std::max(t.x0, ix - r), x1 = std::min(t.x0 + t.width - 1, ix + r);
+        int y0 = std::max(t.y0, iy - r), y1 = std::min(t.y0 + t.height - 1, iy + r);
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                int dx = x - ix;
+                int dy = y - iy;
+                if (dx*dx + dy*dy <= r2) {
+                    t.rgba[((size_t)(y - t.y0) * t.width + (x - t.x0)) * 4 + 3] = 0;
+                }
+            }
         }
+    });
+    MarkBackgroundChanged();
+}
+
+// Raster pencil: paints the segment `from` -> `to` (a dot when they are the
+// same) and its symmetric copies straight into the background. Only the
+// tiles under it are copied and written, so an undo state holds just the
+// tiles its stroke changed, and the cost does not grow with what was painted
+// before. False when the active layer has no pixels (only the bottom one does).
+bool PaintBackgroundSegment(Vector2 from, Vector2 to, float size, Color color) {
+    if (g_ActiveLayer != 0) return false;
+    if (!HasBackground()) {
+        Image white = GenImageColor(g_CanvasWidth, g_CanvasHeight, WHITE);
+        SetBackground(TileBackground(white));
+        UnloadImage(white);
     }
 
-    EndTextureMode();
+    std::vector<std::vector<Vector2>> lines = { { from, to } };
+    if (auto sym = CurrentSymmetry())
+        for (const Matrix &m : sym->copies) lines.push_back({ Vector2Transform(from, m), Vector2Transform(to, m) });
+    const float reach = size * 0.5f + 1.0f;
+    for (const auto &line : lines) {
+        int x0 = (int)floorf(std::min(line[0].x, line[1].x) - reach);
+        int y0 = (int)floorf(std::min(line[0].y, line[1].y) - reach);
+        int x1 = (int)ceilf(std::max(line[0].x, line[1].x) + reach);
+        int y1 = (int)ceilf(std::max(line[0].y, line[1].y) + reach);
+        EditBackgroundWithin(ActiveSelection(), x0, y0, x1, y1, [&](const BackgroundTileEdit &t) {
+            PaintLineOnTile(t, line, size, color);
+        });
+    }
+    // only pixels changed: the layer's strokes, their bounds and index stay
+    MarkBackgroundChanged();
+    return true;
+}
 
-    Image img = LoadImageFromTexture(temp.texture);
-    UnloadRenderTexture(temp);
-    return img;
+// --- Canvas operations ---
+// Whole-document edits: the background is rebuilt tile by tile on the job
+// pool and every stroke is replaced by a transformed copy. Each is one undo
+// step.
+static const int kMaxCanvasSide = 32768;
+
+// Symmetries of transformed strokes, by the one they had before; each is
+// transformed once and stays shared between its strokes.
+using SymmetryRemap = std::unordered_map<const StrokeSymmetry *, std::shared_ptr<const StrokeSymmetry>>;
+
+static void AddSymmetryRemap(const CanvasStroke &stroke, const Matrix &m, SymmetryRemap &remap) {
+    if (stroke.symmetry && !remap.count(stroke.symmetry.get()))
+        remap[stroke.symmetry.get()] = TransformedSymmetry(*stroke.symmetry, m);
+}
+
+// The canvas maps are all affine, so three points give their matrix.
+static Matrix AffineFromMap(const std::function<Vector2(Vector2)> &map) {
+    Vector2 o = map({ 0, 0 }), x = map({ 1, 0 }), y = map({ 0, 1 });
+    Matrix m = MatrixIdentity();
+    m.m0 = x.x - o.x; m.m1 = x.y - o.y;
+    m.m4 = y.x - o.x; m.m5 = y.y - o.y;
+    m.m12 = o.x; m.m13 = o.y;
+    return m;
 }
 
-void EraseBackgroundAt(const Vector2 &screenPos, float radius) {
-    if (g_BackgroundImage.data == nullptr) return;
+// A copy of `stroke` whose points went through `map`. The copy gets a new
+// id, since snapshots and LODs key on it.
+static CanvasStroke TransformedStroke(const CanvasStroke &stroke, const std::function<Vector2(Vector2)> &map,
+                                      float sizeScale, const SymmetryRemap &remap) {
+    CanvasStroke moved;
+    moved.points.resize(stroke.points.size());
+    std::transform(stroke.points.begin(), stroke.points.end(), moved.points.begin(), map);
+    moved.size = stroke.size * sizeScale;
+    moved.color = stroke.color;
+    moved.erased = stroke.erased;
+    moved.brush = stroke.brush;
+    if (stroke.symmetry) moved.symmetry = remap.at(stroke.symmetry.get());
+    return moved;
+}
+
+// Replaces every stroke with a transformed copy.
+static void TransformStrokes(const std::function<Vector2(Vector2)> &map, float sizeScale) {
+    g_CurrentStroke = nullptr;
+    const Matrix m = AffineFromMap(map);
+    SymmetryRemap remap;
+    for (const auto &layer : g_Layers)
+        for (const auto &stroke : layer.strokes) AddSymmetryRemap(stroke, m, remap);
+    for (auto &layer : g_Layers) {
+        ParallelFor("transform strokes", (int)layer.strokes.size(), 64, [&](int i0, int i1) {
+            for (int i = i0; i < i1; ++i) layer.strokes[i] = TransformedStroke(layer.strokes[i], map, sizeScale, remap);
+        });
+    }
+}
 
-    int ix = (int)(screenPos.x - toolbarWidth);
-    int iy = (int)(screenPos.y - menuBarHeight);
+// Move tool: bakes the matrix the strokes at `indices` of the active layer
+// were drawn with during a drag into their points. This is the drag's edit,
+// so the undo state from before the press is pushed now; only these strokes
+// are new in the next snapshot.
+void TransformActiveStrokes(const std::vector<size_t> &indices, const Matrix &m, float sizeScale) {
+    std::vector<CanvasStroke> &strokes = ActiveStrokes();
+    auto map = [&m](Vector2 p) { return Vector2Transform(p, m); };
+    SymmetryRemap remap;
+    for (size_t i : indices) AddSymmetryRemap(strokes[i], m, remap);
+    ParallelFor("transform strokes", (int)indices.size(), 64, [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            CanvasStroke &stroke = strokes[indices[i]];
+            stroke = TransformedStroke(stroke, map, sizeScale, remap);
+            UpdateStrokeBounds(stroke);
+        }
+    });
+    MarkDocumentChanged();
+}
 
-    if (ix < - (int)radius || iy < - (int)radius) return;
-    if (ix >= (int)g_BackgroundImage.width + (int)radius || iy >= (int)g_BackgroundImage.height + (int)radius) return;
+static void SetCanvasSize(int w, int h) {
+    g_CanvasWidth = w;
+    g_CanvasHeight = h;
+    g_Selection = SelectionMask();
+    FitCanvasInView();
+    MarkAllLayersChanged();
+}
 
-    int x0 = std::max(0, ix - (int)radius);
-    int x1 = std::min((int)g_BackgroundImage.width - 1, ix + (int)radius);
-    int y0 = std::max(0, iy - (int)radius);
-    int y1 = std::min((int)g_BackgroundImage.height - 1, iy + (int)radius);
+// Crops or extends the canvas to w x h. (ax, ay) in [0, 1] is the anchor:
+// 0 keeps the left/top edge, 1 the right/bottom one. New area is white.
+static void CropCanvas(int w, int h, float ax, float ay) {
+    int dx = (int)roundf((w - g_CanvasWidth) * ax);
+    int dy = (int)roundf((h - g_CanvasHeight) * ay);
+    PushState();
 
-    int imgW = g_BackgroundImage.width;
-    unsigned char *pixels = (unsigned char *)g_BackgroundImage.data;
+    DocumentSnapshotRef doc = CurrentDocument();
+    if (doc->background) {
+        const BackgroundSnapshot &old = *doc->background;
+        SetBackground(BuildBackground(w, h, [&](const BackgroundTileEdit &t) {
+            std::fill(t.rgba, t.rgba + (size_t)t.width * t.height * 4, 0xFF);
+            // the part of this tile the old image covers
+            int x0 = std::max(t.x0, dx), x1 = std::min(t.x0 + t.width, dx + old.width);
+            int y0 = std::max(t.y0, dy), y1 = std::min(t.y0 + t.height, dy + old.height);
+            for (int y = y0; y < y1 && x0 < x1; ++y)
+                old.ReadRow(y - dy, x0 - dx, x1 - x0, t.rgba + ((size_t)(y - t.y0) * t.width + (x0 - t.x0)) * 4);
+        }));
+    }
 
-    for (int y = y0; y <= y1; ++y) {
-        for (int x = x0; x <= x1; ++x) {
-            int dx = x - ix;
-            int dy = y - iy;
-            if (dx*dx + dy*dy <= (int)(radius*radius)) {
-                int idx = (y * imgW + x) * 4;
-                pixels[idx + 3] = 0;
+    TransformStrokes([dx, dy](Vector2 p) { return Vector2{ p.x + dx, p.y + dy }; }, 1.0f);
+    SetCanvasSize(w, h);
+}
+
+// Scales the canvas, background and strokes to w x h.
+static void ScaleCanvas(int w, int h, ResampleFilter filter) {
+    float sx = (float)w / (float)g_CanvasWidth;
+    float sy = (float)h / (float)g_CanvasHeight;
+    PushState();
+
+    DocumentSnapshotRef doc = CurrentDocument();
+    if (doc->background) SetBackground(ResampleBackground(*doc->background, w, h, filter));
+
+    TransformStrokes([sx, sy](Vector2 p) { return Vector2{ p.x * sx, p.y * sy }; }, sqrtf(sx * sy));
+    SetCanvasSize(w, h);
+}
+
+// Rotates or mirrors the background and strokes.
+static void OrientCanvas(CanvasOrientation op) {
+    int w = g_CanvasWidth, h = g_CanvasHeight;
+    PushState();
+
+    DocumentSnapshotRef doc = CurrentDocument();
+    if (doc->background) SetBackground(OrientBackground(*doc->background, op));
+
+    TransformStrokes([op, w, h](Vector2 p) { return OrientPoint(op, p, w, h); }, 1.0f);
+    if (SwapsCanvasSides(op)) SetCanvasSize(h, w);
+    else SetCanvasSize(w, h);
+}
+
+static bool ParseAnchor(const char *name, float &ax, float &ay) {
+    static const struct { const char *name; float x, y; } kAnchors[] = {
+        { "top-left", 0, 0 },    { "top", 0.5f, 0 },       { "top-right", 1, 0 },
+        { "left", 0, 0.5f },     { "center", 0.5f, 0.5f }, { "right", 1, 0.5f },
+        { "bottom-left", 0, 1 }, { "bottom", 0.5f, 1 },    { "bottom-right", 1, 1 },
+    };
+    for (const auto &a : kAnchors) {
+        if (strcmp(name, a.name) == 0) {
+            ax = a.x;
+            ay = a.y;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Edit_ChangeCanvasSize() {
+    InputBoxAsync("Change Canvas Size",
+        "Width, height and mode: \"scale bilinear|lanczos\" or \"crop <anchor>\" (center, top-left, bottom, ...)",
+        TextFormat("%d %d scale lanczos", g_CanvasWidth, g_CanvasHeight), [](const DialogResult &r) {
+            if (!r.ok) return;
+
+            int w = 0, h = 0;
+            char mode[16] = "", option[16] = "";
+            if (sscanf(r.text.c_str(), "%d %d %15s %15s", &w, &h, mode, option) < 2 ||
+                w < 1 || h < 1 || w > kMaxCanvasSide || h > kMaxCanvasSide) {
+                MessageBoxAsync("Error", "Invalid canvas size.", "ok", "error", 1);
+                return;
+            }
+
+            if (mode[0] == '\0' || strcmp(mode, "scale") == 0) {
+                if (option[0] == '\0' || strcmp(option, "lanczos") == 0) ScaleCanvas(w, h, RESAMPLE_LANCZOS3);
+                else if (strcmp(option, "bilinear") == 0) ScaleCanvas(w, h, RESAMPLE_BILINEAR);
+                else MessageBoxAsync("Error", "Unknown filter; use bilinear or lanczos.", "ok", "error", 1);
+            } else if (strcmp(mode, "crop") == 0) {
+                float ax = 0.5f, ay = 0.5f;
+                if (option[0] == '\0' || ParseAnchor(option, ax, ay)) CropCanvas(w, h, ax, ay);
+                else MessageBoxAsync("Error", "Unknown anchor.", "ok", "error", 1);
+            } else {
+                MessageBoxAsync("Error", "Unknown mode; use scale or crop.", "ok", "error", 1);
+            }
+        });
+}
+
+// --- Symmetry ---
+// While a mode is on, pencil, square and circle strokes get copies around
+// the canvas centre (see Symmetry.hpp).
+
+static SymmetrySettings g_Symmetry;
+
+struct SymmetryPreset {
+    const char *name;
+    SymmetryMode mode;
+    int folds;
+};
+
+static const SymmetryPreset kSymmetryPresets[] = {
+    { "Off", SYMMETRY_OFF, 0 },
+    { "Mirror Left/Right", SYMMETRY_MIRROR_X, 0 },
+    { "Mirror Top/Bottom", SYMMETRY_MIRROR_Y, 0 },
+    { "Mirror Four Ways", SYMMETRY_MIRROR_XY, 0 },
+    { "Radial 6", SYMMETRY_RADIAL, 6 },
+    { "Radial 8", SYMMETRY_RADIAL, 8 },
+    { "Radial 12", SYMMETRY_RADIAL, 12 },
+    { "Mandala 12", SYMMETRY_MANDALA, 12 },
+};
+
+static SymmetrySettings ActiveSymmetry() {
+    SymmetrySettings s = g_Symmetry;
+    s.center = { g_CanvasWidth * 0.5f, g_CanvasHeight * 0.5f };
+    return s;
+}
+
+// Copies for the stroke a tool is starting; null with symmetry off.
+std::shared_ptr<const StrokeSymmetry> CurrentSymmetry() {
+    return MakeSymmetry(ActiveSymmetry());
+}
+
+static void Symmetry_Set(const std::string &name) {
+    for (const SymmetryPreset &p : kSymmetryPresets) {
+        if (name != p.name) continue;
+        g_Symmetry.mode = p.mode;
+        g_Symmetry.folds = p.folds;
+    }
+}
+
+// --- Selection ---
+// The select tool builds a mask for each drag and combines it into
+// g_Selection. An emptied selection becomes no selection, as after Deselect.
+
+void ClearSelection() {
+    g_Selection = SelectionMask();
+}
+
+void CombineSelection(const SelectionMask &shape, SelectionOp op) {
+    if (g_Selection.IsNull()) {
+        // nothing selected yet: adding is starting over, the rest leave nothing
+        if (op != SELECTION_REPLACE && op != SELECTION_ADD) return;
+        g_Selection = SelectionMask(g_CanvasWidth, g_CanvasHeight);
+        op = SELECTION_REPLACE;
+    }
+    g_Selection.Combine(shape, op);
+    if (g_Selection.Empty()) ClearSelection();
+}
+
+static void Select_All() {
+    g_Selection = RectangleSelection(g_CanvasWidth, g_CanvasHeight,
+                                     { 0, 0, (float)g_CanvasWidth, (float)g_CanvasHeight });
+}
+
+static void Select_Invert() {
+    if (g_Selection.IsNull()) return;
+    g_Selection.Invert();
+    if (g_Selection.Empty()) ClearSelection();
+}
+
+// Marching ants along the cached outline, in document coordinates (inside
+// BeginMode2D): black dashes over a white line, so the outline shows on any
+// image. Edges outside the view are skipped.
+static void DrawSelectionOutline() {
+    if (g_Selection.IsNull()) return;
+    Rectangle view = VisibleDocumentRect();
+    const float dash = 4.0f / g_Camera.zoom;
+    const float phase = fmodf((float)GetTime() * 4.0f, 2.0f) * dash;
+
+    rlBegin(RL_LINES);
+    for (const SelectionEdge &e : g_Selection.Edges()) {
+        if (e.b.x < view.x || e.a.x > view.x + view.width || e.b.y < view.y || e.a.y > view.y + view.height) continue;
+        rlColor4ub(255, 255, 255, 255);
+        rlVertex2f(e.a.x, e.a.y);
+        rlVertex2f(e.b.x, e.b.y);
+
+        // dashes keep to a document-wide pattern so they join up at corners
+        const bool horizontal = e.a.y == e.b.y;
+        const float from = horizontal ? std::max(e.a.x, view.x) : std::max(e.a.y, view.y);
+        const float to = horizontal ? std::min(e.b.x, view.x + view.width) : std::min(e.b.y, view.y + view.height);
+        rlColor4ub(0, 0, 0, 255);
+        for (float d = floorf((from - phase) / (2 * dash)) * 2 * dash + phase; d < to; d += 2 * dash) {
+            float d0 = std::max(d, from), d1 = std::min(d + dash, to);
+            if (d0 >= d1) continue;
+            if (horizontal) {
+                rlVertex2f(d0, e.a.y);
+                rlVertex2f(d1, e.a.y);
+            } else {
+                rlVertex2f(e.a.x, d0);
+                rlVertex2f(e.a.x, d1);
             }
         }
     }
+    rlEnd();
+}
 
-    if (g_BackgroundTexture.id != 0) UnloadTexture(g_BackgroundTexture);
-    g_BackgroundTexture = LoadTextureFromImage(g_BackgroundImage);
-    g_HasUnsavedChanges = true;
+// --- Background preview ---
+// Image adjustments show their result live on a copy of the background
+// scaled to at most kPreviewSide, processed on the job pool. While a preview
+// is up it is drawn in place of the background; a new request made while
+// one is running waits for it and then runs with the latest settings. The
+// selection is scaled along with the image, so the preview is limited to it
+// too.
+static const int kPreviewSide = 1024;
+
+using PreviewProcess = std::function<std::shared_ptr<const BackgroundSnapshot>(const BackgroundSnapshot &, float)>;
+
+struct PreviewResult {
+    std::shared_ptr<const BackgroundSnapshot> source;
+    std::shared_ptr<const BackgroundSnapshot> image;
+};
+
+struct BackgroundPreview {
+    bool active = false;
+    std::shared_ptr<const BackgroundSnapshot> full;     // the background being previewed
+    std::shared_ptr<const BackgroundSnapshot> source;   // `full` scaled down, once made
+    std::shared_ptr<const SelectionMask> selection;     // g_Selection at the size of `source`; null for none
+    PreviewProcess process;                             // (source, source pixels per document pixel)
+    bool pending = false;                               // `process` changed since the task started
+    JobRef task;
+    std::shared_ptr<PreviewResult> result;              // written by `task`
+    Texture2D texture = {};
+    uint64_t generation = 0;                            // bumped whenever what is drawn changes
+};
+
+static BackgroundPreview g_Preview;
+
+static float PreviewScale(const BackgroundSnapshot &full) {
+    return std::min(1.0f, (float)kPreviewSide / (float)std::max(full.width, full.height));
 }
 
+static void PreviewSize(const BackgroundSnapshot &full, int &w, int &h) {
+    float scale = PreviewScale(full);
+    w = std::max(1, (int)roundf(full.width * scale));
+    h = std::max(1, (int)roundf(full.height * scale));
+}
+
+static void StartPreviewTask() {
+    auto full = g_Preview.full;
+    auto source = g_Preview.source;
+    auto process = g_Preview.process;
+    auto result = std::make_shared<PreviewResult>();
+    g_Preview.result = result;
+    g_Preview.pending = false;
+    g_Preview.task = RunJob("preview", [full, source, process, result] {
+        result->source = source;
+        if (!result->source) {
+            int w, h;
+            PreviewSize(*full, w, h);
+            result->source = (PreviewScale(*full) < 1.0f) ? ResampleBackground(*full, w, h, RESAMPLE_BILINEAR) : full;
+        }
+        result->image = process(*result->source, (float)result->source->width / (float)full->width);
+    });
+}
+
+// Starts previewing the current background; false if there is none.
+static bool BeginBackgroundPreview() {
+    DocumentSnapshotRef doc = CurrentDocument();
+    if (!doc->background) return false;
+    g_Preview.active = true;
+    g_Preview.full = doc->background;
+    g_Preview.source = nullptr;
+    g_Preview.selection = nullptr;
+    if (!g_Selection.IsNull()) {
+        int w, h;
+        PreviewSize(*doc->background, w, h);
+        g_Preview.selection = std::make_shared<const SelectionMask>(g_Selection.Resized(w, h));
+    }
+    return true;
+}
+
+// Shows `process` applied to the preview copy, as soon as it is ready.
+static void RequestPreview(PreviewProcess process) {
+    if (!g_Preview.active) return;
+    g_Preview.process = std::move(process);
+    if (g_Preview.task) g_Preview.pending = true;
+    else StartPreviewTask();
+}
+
+// Picks up a finished preview; once per frame.
+static void PollPreview() {
+    if (!g_Preview.task || !IsJobDone(g_Preview.task)) return;
+    g_Preview.task = nullptr;
+    std::shared_ptr<PreviewResult> result = std::move(g_Preview.result);
+    g_Preview.source = result->source;
+
+    if (result->image) {
+        Image img = BackgroundToImage(*result->image);
+        if (g_Preview.texture.id != 0) UnloadTexture(g_Preview.texture);
+        g_Preview.texture = LoadTextureFromImage(img);
+        SetTextureFilter(g_Preview.texture, TEXTURE_FILTER_BILINEAR);
+        UnloadImage(img);
+        ++g_Preview.generation;
+    }
+    if (g_Preview.pending) StartPreviewTask();
+}
+
+static void EndBackgroundPreview() {
+    if (g_Preview.task) WaitJob(g_Preview.task);
+    if (g_Preview.texture.id != 0) UnloadTexture(g_Preview.texture);
+    uint64_t generation = g_Preview.generation + 1;
+    g_Preview = BackgroundPreview();
+    g_Preview.generation = generation;
+}
+
+// Draws the preview over the background's area, if there is one to show.
+static bool DrawBackgroundPreview() {
+    if (!g_Preview.active || g_Preview.texture.id == 0) return false;
+    const Texture2D &tex = g_Preview.texture;
+    Rectangle dst = { 0, 0, (float)g_Preview.full->width, (float)g_Preview.full->height };
+    DrawTexturePro(tex, { 0, 0, (float)tex.width, (float)tex.height }, dst, { 0, 0 }, 0.0f, WHITE);
+    return true;
+}
+
+// One labelled slider row of a settings card, snapped to `step`; true when
+// the value changed. `dragging` is the card's dragged slider id.
+static bool CardSlider(int id, int &dragging, const char *label, float &value, float lo, float hi, float step,
+                       float x, float y, float w, Vector2 mouse) {
+    DrawText(label, (int)x, (int)y, 14, BLACK);
+    Rectangle bar = { x, y + 18, w, 10 };
+    DrawRectangleRec(bar, LIGHTGRAY);
+    DrawRectangle((int)(x + (value - lo) / (hi - lo) * w) - 3, (int)bar.y - 2, 6, 14, BLACK);
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mouse, bar)) dragging = id;
+    if (dragging != id) return false;
+
+    float v = lo + std::clamp((mouse.x - x) / w, 0.0f, 1.0f) * (hi - lo);
+    v = roundf(v / step) * step;
+    if (v == value) return false;
+    value = v;
+    return true;
+}
+
+static bool CardButton(Rectangle r, const char *label, Vector2 mouse) {
+    bool hover = CheckCollisionPointRec(mouse, r);
+    DrawRectangleRec(r, hover ? GRAY : LIGHTGRAY);
+    DrawRectangleLinesEx(r, 1, BLACK);
+    DrawText(label, (int)(r.x + (r.width - MeasureText(label, 14)) / 2), (int)r.y + 3, 14, BLACK);
+    return hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+}
+
+// --- Filters ---
+// Filter menu items open a card over the top right of the canvas with the
+// filter's settings, previewed live. Apply filters the background, or its
+// selected part, as one undo step.
+struct FilterCard {
+    bool open = false;
+    FilterParams params;
+    int dragging = -1;  // slider being dragged
+};
+
+static FilterCard g_FilterCard;
+
+static Rectangle FilterCardRect() {
+    return { g_ScreenWidth - 230.0f, menuBarHeight + 10.0f, 220.0f, 130.0f };
+}
+
+static bool FilterCardHit(Vector2 mouse) {
+    return g_FilterCard.open && CheckCollisionPointRec(mouse, FilterCardRect());
+}
+
+static void PreviewFilter() {
+    FilterParams params = g_FilterCard.params;
+    auto selection = g_Preview.selection;
+    RequestPreview([params, selection](const BackgroundSnapshot &src, float scale) {
+        FilterParams scaled = params;
+        scaled.radius *= scale;
+        return FilterBackground(src, scaled, selection.get());
+    });
+}
+
+static void CloseFilterCard() {
+    if (!g_FilterCard.open) return;
+    EndBackgroundPreview();
+    g_FilterCard = FilterCard();
+}
+
+static void Filter_Open(FilterKind kind) {
+    CloseFilterCard();
+    if (!BeginBackgroundPreview()) {
+        MessageBoxAsync("Filter", "There is no background image to filter.", "ok", "info", 1);
+        return;
+    }
+    g_FilterCard.open = true;
+    g_FilterCard.params.kind = kind;
+    if (kind == FILTER_UNSHARP_MASK) g_FilterCard.params.radius = 2.0f;
+    PreviewFilter();
+}
+
+static void ApplyFilter() {
+    FilterParams params = g_FilterCard.params;
+    CloseFilterCard();
+
+    DocumentSnapshotRef doc = CurrentDocument();
+    if (!doc->background) return;
+    PushState();
+    SetBackground(FilterBackground(*doc->background, params, ActiveSelection()));
+    MarkBackgroundChanged();
+}
+
+static void DrawFilterCard(Vector2 mouse) {
+    if (!g_FilterCard.open) return;
+    // the document was replaced under the preview (open, new, undo)
+    if (CurrentDocument()->background != g_Preview.full) {
+        CloseFilterCard();
+        return;
+    }
+
+    FilterParams &params = g_FilterCard.params;
+    Rectangle card = FilterCardRect();
+    DrawRectangleRec(card, Color{245,245,245,235});
+    DrawRectangleLinesEx(card, 1, BLACK);
+    DrawText(FilterName(params.kind), (int)card.x + 10, (int)card.y + 8, 16, BLACK);
+    if (g_Preview.task) DrawText("...", (int)(card.x + card.width - 30), (int)card.y + 8, 16, DARKGRAY);
+
+    if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) g_FilterCard.dragging = -1;
+    float x = card.x + 10, y = card.y + 32, w = card.width - 20;
+    bool changed = false;
+    if (params.kind != FILTER_FIND_EDGES) {
+        changed |= CardSlider(0, g_FilterCard.dragging, TextFormat("Radius %.2f px", params.radius), params.radius,
+                              0.0f, 64.0f, 0.25f, x, y, w, mouse);
+        y += 36;
+    }
+    if (params.kind == FILTER_UNSHARP_MASK || params.kind == FILTER_FIND_EDGES) {
+        changed |= CardSlider(1, g_FilterCard.dragging, TextFormat("Amount %.2f", params.amount), params.amount,
+                              0.0f, 4.0f, 0.05f, x, y, w, mouse);
+    }
+    if (changed) PreviewFilter();
+
+    float by = card.y + card.height - 30;
+    if (CardButton({ card.x + card.width - 140, by, 60, 20 }, "Apply", mouse)) ApplyFilter();
+    else if (CardButton({ card.x + card.width - 70, by, 60, 20 }, "Cancel", mouse)) CloseFilterCard();
+}
+
+// --- Adjustments ---
+// Adjust menu items add a step to a stack of colour adjustments shown in a
+// card like the filter one; a row is selected to edit its settings. The
+// whole stack is compiled into lookup tables for the preview and for Apply,
+// which adjusts the full background in one pass as one undo step.
+static const int kMaxAdjustments = 8;
+
+struct AdjustCard {
+    bool open = false;
+    std::vector<Adjustment> stack;
+    int selected = 0;
+    int dragging = -1;  // slider being dragged
+};
+
+static AdjustCard g_AdjustCard;
+
+struct AdjustSlider {
+    const char *label;
+    float Adjustment::*value;
+    float lo, hi, step;
+};
+
+static std::vector<AdjustSlider> AdjustSliders(AdjustmentKind kind) {
+    switch (kind) {
+        case ADJUST_BRIGHTNESS_CONTRAST:
+            return { { "Brightness", &Adjustment::brightness, -1, 1, 0.01f },
+                     { "Contrast", &Adjustment::contrast, -1, 1, 0.01f } };
+        case ADJUST_LEVELS:
+            return { { "Input black", &Adjustment::inBlack, 0, 255, 1 },
+                     { "Input white", &Adjustment::inWhite, 0, 255, 1 },
+                     { "Gamma", &Adjustment::gamma, 0.1f, 4, 0.01f },
+                     { "Output black", &Adjustment::outBlack, 0, 255, 1 },
+                     { "Output white", &Adjustment::outWhite, 0, 255, 1 } };
+        case ADJUST_CURVES:
+            return { { "Shadows", &Adjustment::shadows, 0, 255, 1 },
+                     { "Midtones", &Adjustment::midtones, 0, 255, 1 },
+                     { "Highlights", &Adjustment::highlights, 0, 255, 1 } };
+        case ADJUST_HUE_SATURATION:
+            return { { "Hue", &Adjustment::hue, -180, 180, 1 },
+                     { "Saturation", &Adjustment::saturation, -1, 1, 0.01f },
+                     { "Lightness", &Adjustment::lightness, -1, 1, 0.01f } };
+        default:
+            return {};
+    }
+}
+
+static Rectangle AdjustCardRect() {
+    const AdjustCard &c = g_AdjustCard;
+    size_t sliders = c.stack.empty() ? 0 : AdjustSliders(c.stack[c.selected].kind).size();
+    float h = 32.0f + c.stack.size() * 20.0f + 8.0f + sliders * 36.0f + 34.0f;
+    return { g_ScreenWidth - 230.0f, menuBarHeight + 10.0f, 220.0f, h };
+}
+
+static bool AdjustCardHit(Vector2 mouse) {
+    return g_AdjustCard.open && CheckCollisionPointRec(mouse, AdjustCardRect());
+}
+
+static void PreviewAdjustments() {
+    auto lut = std::make_shared<AdjustmentLut>(CompileAdjustments(g_AdjustCard.stack));
+    auto selection = g_Preview.selection;
+    RequestPreview([lut, selection](const BackgroundSnapshot &src, float) {
+        return AdjustBackground(src, *lut, selection.get());
+    });
+}
+
+static void Adjust_Open(AdjustmentKind kind) {
+    if (!g_AdjustCard.open) {
+        if (!BeginBackgroundPreview()) {
+            MessageBoxAsync("Adjust", "There is no background image to adjust.", "ok", "info", 1);
+            return;
+        }
+        g_AdjustCard.open = true;
+    }
+    if ((int)g_AdjustCard.stack.size() >= kMaxAdjustments) return;
+    Adjustment a;
+    a.kind = kind;
+    g_AdjustCard.stack.push_back(a);
+    g_AdjustCard.selected = (int)g_AdjustCard.stack.size() - 1;
+    PreviewAdjustments();
+}
+
+static void CloseAdjustCard() {
+    if (!g_AdjustCard.open) return;
+    EndBackgroundPreview();
+    g_AdjustCard = AdjustCard();
+}
+
+static void ApplyAdjustments() {
+    AdjustmentLut lut = CompileAdjustments(g_AdjustCard.stack);
+    CloseAdjustCard();
+
+    DocumentSnapshotRef doc = CurrentDocument();
+    if (!doc->background) return;
+    PushState();
+    SetBackground(AdjustBackground(*doc->background, lut, ActiveSelection()));
+    MarkBackgroundChanged();
+}
+
+static void DrawAdjustCard(Vector2 mouse) {
+    AdjustCard &c = g_AdjustCard;
+    if (!c.open) return;
+    if (CurrentDocument()->background != g_Preview.full) {
+        CloseAdjustCard();
+        return;
+    }
+
+    Rectangle card = AdjustCardRect();
+    DrawRectangleRec(card, Color{245,245,245,235});
+    DrawRectangleLinesEx(card, 1, BLACK);
+    DrawText("Adjustments", (int)card.x + 10, (int)card.y + 8, 16, BLACK);
+    if (g_Preview.task) DrawText("...", (int)(card.x + card.width - 30), (int)card.y + 8, 16, DARKGRAY);
+
+    // the stack, first step on top; x removes a step
+    bool pressed = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+    float x = card.x + 10, y = card.y + 32, w = card.width - 20;
+    int removed = -1;
+    for (int i = 0; i < (int)c.stack.size(); ++i, y += 20) {
+        Rectangle row = { x, y, w, 18 };
+        Rectangle close = { x + w - 18, y, 18, 18 };
+        DrawRectangleRec(row, i == c.selected ? Color{200,220,240,255} : Color{230,230,230,255});
+        DrawText(AdjustmentName(c.stack[i].kind), (int)x + 4, (int)y + 2, 14, BLACK);
+        DrawText("x", (int)close.x + 5, (int)y + 1, 14, CheckCollisionPointRec(mouse, close) ? RED : DARKGRAY);
+        if (pressed && CheckCollisionPointRec(mouse, close)) removed = i;
+        else if (pressed && CheckCollisionPointRec(mouse, row)) c.selected = i;
+    }
+    if (removed >= 0) {
+        c.stack.erase(c.stack.begin() + removed);
+        c.selected = std::clamp(c.selected - (removed < c.selected ? 1 : 0), 0, std::max(0, (int)c.stack.size() - 1));
+        c.dragging = -1;
+        PreviewAdjustments();
+        return;
+    }
+    y += 8;
+
+    if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) c.dragging = -1;
+    bool changed = false;
+    if (!c.stack.empty()) {
+        Adjustment &a = c.stack[c.selected];
+        std::vector<AdjustSlider> sliders = AdjustSliders(a.kind);
+        for (int i = 0; i < (int)sliders.size(); ++i, y += 36) {
+            const AdjustSlider &sl = sliders[i];
+            float &value = a.*sl.value;
+            changed |= CardSlider(i, c.dragging, TextFormat(sl.step < 1 ? "%s %.2f" : "%s %.0f", sl.label, value), value,
+                                  sl.lo, sl.hi, sl.step, x, y, w, mouse);
+        }
+    }
+    if (changed) PreviewAdjustments();
+
+    float by = card.y + card.height - 30;
+    if (CardButton({ card.x + card.width - 140, by, 60, 20 }, "Apply", mouse)) ApplyAdjustments();
+    else if (CardButton({ card.x + card.width - 70, by, 60, 20 }, "Cancel", mouse)) CloseAdjustCard();
+}
+
+// --- Stroke upkeep ---
+// Bounds, LOD builds and the culling index of each layer's strokes. A layer
+// is gone over only when its strokes changed since the last look, not for
+// edits of the background image alone. While a
+// stroke is being drawn on it only that stroke is: everything else was
+// brought up to date before the stroke began, and the index lists the
+// strokes from before it.
+struct LayerStrokes {
+    uint64_t version = 0;   // layer strokesVersion the index was built at
+    size_t indexed = 0;     // strokes [0, indexed) are in `index`
+    StrokeIndex index;
+    bool lodsQueued = true; // every stroke that needs levels has them or a build
+};
+
+static std::unordered_map<uint64_t, LayerStrokes> g_LayerStrokes;  // by layer id
+
+static LayerStrokes &SyncLayerStrokes(Layer &layer) {
+    LayerStrokes &state = g_LayerStrokes[layer.id];
+    const bool drawing = g_CurrentStroke && g_CurrentStroke >= layer.strokes.data() &&
+                         g_CurrentStroke < layer.strokes.data() + layer.strokes.size();
+    if (state.version != layer.strokesVersion && !drawing) {
+        for (auto &stroke : layer.strokes) UpdateStrokeBounds(stroke);
+        state.index.Build(layer.strokes);
+        state.indexed = layer.strokes.size();
+        state.version = layer.strokesVersion;
+        state.lodsQueued = false;
+    }
+    return state;
+}
+
+// Before and after the tools run each frame, so a stroke never starts on a
+// layer with edits not looked at yet, and its bounds are current when the
+// document is published.
+static void UpdateLayerStrokes() {
+    const FinishedStrokeLods finished = TakeFinishedStrokeLods();
+    if (g_CurrentStroke) UpdateStrokeBounds(*g_CurrentStroke);
+
+    for (auto &layer : g_Layers) {
+        AttachStrokeLods(layer.strokes, finished);
+        LayerStrokes &state = SyncLayerStrokes(layer);
+        if (!state.lodsQueued) state.lodsQueued = QueueStrokeLods(layer.strokes, g_CurrentStroke);
+    }
+
+    if (g_LayerStrokes.size() > g_Layers.size()) {
+        for (auto it = g_LayerStrokes.begin(); it != g_LayerStrokes.end();) {
+            bool live = std::any_of(g_Layers.begin(), g_Layers.end(), [&](const Layer &l) { return l.id == it->first; });
+            it = live ? std::next(it) : g_LayerStrokes.erase(it);
+        }
+    }
+}
+
+// Indices of the strokes of `layer` that are drawn inside `view`, ascending.
+// `moving` is the move tool while it transforms strokes of this layer; its
+// picked strokes are tested where the drag puts them.
+static void VisibleStrokes(Layer &layer, Rectangle view, const MoveTool *moving, std::vector<size_t> &out) {
+    // edits after this frame's upkeep (undo, flattening) are indexed now
+    const LayerStrokes &state = SyncLayerStrokes(layer);
+    const auto &strokes = layer.strokes;
+    size_t indexed = std::min(state.indexed, strokes.size());
+    state.index.Query(view, out);
+    // strokes from after the index (the one being drawn)
+    for (size_t i = indexed; i < strokes.size(); ++i) out.push_back(i);
+    if (moving) {
+        out.insert(out.end(), moving->PickedIndices().begin(), moving->PickedIndices().end());
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    out.erase(std::remove_if(out.begin(), out.end(), [&](size_t i) {
+        if (i >= strokes.size()) return true;
+        const CanvasStroke &stroke = strokes[i];
+        if (stroke.erased || stroke.points.size() < 2) return true;
+        if (moving && moving->IsPicked(i)) return !CheckCollisionRecs(TransformedBounds(stroke.bounds, moving->DragMatrix()), view);
+        return !CheckCollisionRecs(stroke.bounds, view);
+    }), out.end());
+}
+
+// Move tool: the strokes of the active layer whose bounds overlap `r`,
+// ascending, from the same index the view culls with.
+void QueryActiveStrokes(Rectangle r, std::vector<size_t> &out) {
+    Layer &layer = g_Layers[g_ActiveLayer];
+    const LayerStrokes &state = SyncLayerStrokes(layer);
+    state.index.Query(r, out);
+    for (size_t i = std::min(state.indexed, layer.strokes.size()); i < layer.strokes.size(); ++i)
+        if (CheckCollisionRecs(layer.strokes[i].bounds, r)) out.push_back(i);
+}
+
+// --- Auto-flatten ---
+// Keeps long sessions inside a stroke budget (--max-live-points N,
+// --max-live-strokes N; 0 turns a limit off). Only the bottom layer paints
+// into the background, so only its strokes count. Once they are over the
+// budget, the oldest are painted into the background on the job pool (see
+// StrokeFlatten.hpp) and dropped from the layer, down to three quarters of
+// the budget. Only strokes the oldest undo state already holds are taken, so
+// every state an undo can return to keeps its strokes; the memory those
+// states share is freed as they fall off the undo stack.
+static StrokeBudget g_StrokeBudget;
+static const size_t kFlattenBatch = 4096;   // strokes per flatten job at most
+static const size_t kFlattenKeptLimit = 64; // kept strokes to check overlaps against
+
+struct FlattenJob {
+    std::shared_ptr<const BackgroundSnapshot> base;  // what the result paints over
+    uint64_t layerId = 0;
+    int canvasW = 0;
+    int canvasH = 0;
+    std::vector<std::shared_ptr<const CanvasStroke>> strokes;
+    std::shared_ptr<const BackgroundSnapshot> result;  // written by `task`
+    JobRef task;
+};
+
+struct FlattenStats {
+    size_t events = 0;
+    size_t strokes = 0;
+    size_t points = 0;
+    size_t tiles = 0;
+    size_t bytes = 0;
+};
+
+// What the last look at the bottom layer saw. Until one of these changes
+// there is nothing new to flatten, so edits on other layers cost nothing.
+struct FlattenCheck {
+    uint64_t layerId = 0;
+    uint64_t layerVersion = 0;
+    bool visible = false;
+    uint64_t horizon = 0;  // version of the oldest undo state
+    bool operator==(const FlattenCheck &o) const {
+        return layerId == o.layerId && layerVersion == o.layerVersion && visible == o.visible && horizon == o.horizon;
+    }
+};
+
+static std::unique_ptr<FlattenJob> g_FlattenJob;
+static FlattenCheck g_FlattenChecked;
+static bool g_FlattenStuck = false;  // over budget with nothing to take; logged once
+static FlattenStats g_FlattenStats;
+
+static void StartAutoFlatten(const DocumentSnapshot &doc) {
+    if (doc.layers.empty()) return;
+    const LayerSnapshot &bottom = doc.layers[0];
+    size_t points = 0, strokes = bottom.strokes.size();
+    for (const auto &s : bottom.strokes) points += s->points.size();
+    const StrokeBudget &budget = g_StrokeBudget;
+    bool overPoints = budget.maxPoints > 0 && points > budget.maxPoints;
+    bool overStrokes = budget.maxStrokes > 0 && strokes > budget.maxStrokes;
+    if (!overPoints && !overStrokes) {
+        g_FlattenStuck = false;
+        return;
+    }
+
+    // a hidden bottom layer would take a new white background out of view
+    if (!doc.background && !bottom.visible) return;
+    if (doc.background && (doc.background->width != doc.canvasW || doc.background->height != doc.canvasH)) return;
+
+    // the undo horizon: strokes (id and point count) of the oldest undo state
+    std::unordered_map<uint64_t, size_t> held;
+    const bool horizon = !g_UndoStack.empty();
+    if (horizon) {
+        for (const auto &layer : g_UndoStack.front().doc->layers) {
+            if (layer.id != bottom.id) continue;
+            for (const auto &s : layer.strokes) held[s->id] = s->points.size();
+        }
+    }
+
+    // a stroke is painted under the ones that stay, so it may not overlap
+    // an older stroke that stays
+    size_t pointGoal = overPoints ? points - budget.maxPoints * 3 / 4 : 0;
+    size_t strokeGoal = overStrokes ? strokes - budget.maxStrokes * 3 / 4 : 0;
+    size_t pointsTaken = 0;
+    std::vector<Rectangle> kept;
+    auto job = std::make_unique<FlattenJob>();
+    for (const auto &s : bottom.strokes) {
+        if (job->strokes.size() >= kFlattenBatch || kept.size() > kFlattenKeptLimit) break;
+        if (pointsTaken >= pointGoal && job->strokes.size() >= strokeGoal) break;
+        auto it = held.find(s->id);
+        bool old = !horizon || (it != held.end() && it->second == s->points.size());
+        bool paints = !s->erased && s->points.size() >= 2;
+        bool covered = paints && std::any_of(kept.begin(), kept.end(), [&](const Rectangle &r) {
+            return CheckCollisionRecs(r, s->bounds);
+        });
+        if (!old || covered) {
+            if (paints) kept.push_back(s->bounds);
+            continue;
+        }
+        job->strokes.push_back(s);
+        pointsTaken += s->points.size();
+    }
+    if (job->strokes.empty()) {
+        // newer strokes become old as the undo horizon moves, and the next
+        // edit of the bottom layer looks again
+        if (!g_FlattenStuck)
+            TraceLog(LOG_INFO, "FLATTEN: %zu strokes (%zu points) on the bottom layer, over budget, none can be flattened yet",
+                     strokes, points);
+        g_FlattenStuck = true;
+        return;
+    }
+    g_FlattenStuck = false;
+
+    job->base = doc.background;
+    job->layerId = bottom.id;
+    job->canvasW = doc.canvasW;
+    job->canvasH = doc.canvasH;
+    FlattenJob *j = job.get();
+    job->task = RunJob("flatten strokes", [j] {
+        j->result = FlattenStrokes(j->base, j->canvasW, j->canvasH, j->strokes);
+    });
+    g_FlattenJob = std::move(job);
+}
+
+// Swaps the flattened strokes for the painted background, if the document
+// still is what the job started from. Not an undo step and not an unsaved
+// change: the canvas looks the same.
+static bool ApplyAutoFlatten(const FlattenJob &job) {
+    if (!job.result || CurrentDocument()->background != job.base) return false;
+    if (g_CanvasWidth != job.canvasW || g_CanvasHeight != job.canvasH) return false;
+    if (g_Layers.empty() || g_Layers[0].id != job.layerId) return false;
+
+    // the flattened strokes, in order, unchanged
+    std::vector<CanvasStroke> &strokes = g_Layers[0].strokes;
+    std::vector<uint8_t> drop(strokes.size(), 0);
+    size_t next = 0;
+    for (size_t i = 0; i < strokes.size() && next < job.strokes.size(); ++i) {
+        const CanvasStroke &s = *job.strokes[next];
+        if (strokes[i].id == s.id && strokes[i].points.size() == s.points.size()) {
+            drop[i] = 1;
+            ++next;
+        }
+    }
+    if (next != job.strokes.size()) return false;
+
+    FlattenStats event;
+    event.events = 1;
+    for (size_t i = 0; i < strokes.size(); ++i) {
+        if (!drop[i]) continue;
+        ++event.strokes;
+        event.points += strokes[i].points.size();
+        event.bytes += StrokeBytes(strokes[i]);
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < strokes.size(); ++i)
+        if (!drop[i]) strokes[out++] = std::move(strokes[i]);
+    strokes.resize(out);
+    strokes.shrink_to_fit();
+
+    for (size_t t = 0; t < job.result->tiles.size(); ++t)
+        if (!job.base || job.base->tiles[t] != job.result->tiles[t]) ++event.tiles;
+    SetBackground(job.result);
+    ++g_DocumentVersion;
+    g_Layers[0].version = g_Layers[0].strokesVersion = g_DocumentVersion;
+
+    TraceLog(LOG_INFO, "FLATTEN: %zu strokes (%zu points) painted into %zu tiles, %.1f KB of live strokes freed",
+             event.strokes, event.points, event.tiles, event.bytes / 1024.0);
+    g_FlattenStats.events += event.events;
+    g_FlattenStats.strokes += event.strokes;
+    g_FlattenStats.points += event.points;
+    g_FlattenStats.tiles += event.tiles;
+    g_FlattenStats.bytes += event.bytes;
+    return true;
+}
+
+// Once per frame, between strokes.
+static void StepAutoFlatten() {
+    if (g_CurrentStroke || IsMouseButtonDown(MOUSE_LEFT_BUTTON) || g_Preview.active) return;
+    if (g_FlattenJob) {
+        if (!IsJobDone(g_FlattenJob->task)) return;
+        std::unique_ptr<FlattenJob> job = std::move(g_FlattenJob);
+        // applied or not, look at the document again
+        ApplyAutoFlatten(*job);
+        g_FlattenChecked = FlattenCheck();
+        return;
+    }
+    if (g_Layers.empty()) return;
+    FlattenCheck check;
+    check.layerId = g_Layers[0].id;
+    check.layerVersion = g_Layers[0].version;
+    check.visible = g_Layers[0].visible;
+    check.horizon = g_UndoStack.empty() ? 0 : g_UndoStack.front().doc->version;
+    if (check == g_FlattenChecked) return;
+    g_FlattenChecked = check;
+    StartAutoFlatten(*CurrentDocument());
+}
 
 // -------------------- Main --------------------
-int main() {
+// --- Layers panel ---
+// Sits at the bottom of the toolbar: one row per layer (top layer first)
+// with a visibility box, then opacity, blend mode and the layer buttons.
+// Every change is an undo step; an opacity drag is one step.
+static const int kMaxLayers = 8;
+static bool g_DraggingOpacity = false;
+
+static void AddLayer() {
+    if ((int)g_Layers.size() >= kMaxLayers) return;
+    PushState();
+    Layer layer;
+    layer.id = NewLayerId();
+    layer.name = TextFormat("Layer %d", (int)layer.id);
+    g_Layers.insert(g_Layers.begin() + g_ActiveLayer + 1, std::move(layer));
+    ++g_ActiveLayer;
+    MarkLayersChanged();
+}
+
+static void DeleteLayer() {
+    // the bottom layer holds the background and always stays
+    if (g_ActiveLayer == 0) return;
+    PushState();
+    g_Layers.erase(g_Layers.begin() + g_ActiveLayer);
+    --g_ActiveLayer;
+    MarkLayersChanged();
+}
+
+static void MoveLayer(int dir) {
+    int to = g_ActiveLayer + dir;
+    if (g_ActiveLayer == 0 || to < 1 || to >= (int)g_Layers.size()) return;
+    PushState();
+    std::swap(g_Layers[g_ActiveLayer], g_Layers[to]);
+    g_ActiveLayer = to;
+    MarkLayersChanged();
+}
+
+static bool PanelButton(Rectangle r, const char *label, Vector2 mouse) {
+    bool hover = CheckCollisionPointRec(mouse, r);
+    DrawRectangleRec(r, hover ? ColorFromHSV(0,0,45) : ColorFromHSV(0,0,35));
+    DrawRectangleLinesEx(r, 1, ColorFromHSV(0,0,10));
+    DrawText(label, (int)(r.x + (r.width - MeasureText(label, 14)) / 2), (int)(r.y + (r.height - 14) / 2), 14, RAYWHITE);
+    return hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+}
+
+static void DrawLayersPanel(Vector2 mouse) {
+    const int rowH = 20;
+    const int x = 8;
+    const int w = toolbarWidth - 16;
+    const int n = (int)g_Layers.size();
+    int y = g_ScreenHeight - 8 - rowH * 3 - 14 - n * rowH - 22;
+    bool pressed = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+
+    DrawText("Layers", x, y, 18, BLACK);
+    y += 22;
+
+    for (int i = n - 1; i >= 0; --i, y += rowH) {
+        Layer &layer = g_Layers[i];
+        Rectangle row = { (float)x, (float)y, (float)w, (float)rowH };
+        Rectangle eye = { (float)x + 4, (float)y + 4, 12, 12 };
+        DrawRectangleRec(row, i == g_ActiveLayer ? ColorFromHSV(210,0.5f,0.6f) : ColorFromHSV(0,0,30));
+        DrawRectangleLinesEx(eye, 1, RAYWHITE);
+        if (layer.visible) DrawRectangle((int)eye.x + 3, (int)eye.y + 3, 6, 6, RAYWHITE);
+        DrawText(layer.name.c_str(), x + 22, y + 3, 14, layer.visible ? RAYWHITE : GRAY);
+
+        if (pressed && CheckCollisionPointRec(mouse, eye)) {
+            PushState();
+            layer.visible = !layer.visible;
+            MarkLayersChanged();
+        } else if (pressed && CheckCollisionPointRec(mouse, row)) {
+            g_ActiveLayer = i;
+        }
+    }
+
+    Layer &active = g_Layers[g_ActiveLayer];
+
+    // opacity
+    DrawText(TextFormat("Opacity %d%%", (int)(active.opacity * 100.0f + 0.5f)), x, y + 2, 14, BLACK);
+    y += 16;
+    Rectangle slider = { (float)x, (float)y, (float)w, 10 };
+    DrawRectangleRec(slider, LIGHTGRAY);
+    DrawRectangle(x + (int)(active.opacity * w) - 3, y - 2, 6, 14, BLACK);
+    if (pressed && CheckCollisionPointRec(mouse, slider)) {
+        PushState();
+        g_DraggingOpacity = true;
+    }
+    if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) g_DraggingOpacity = false;
+    if (g_DraggingOpacity) {
+        float opacity = std::clamp((mouse.x - x) / (float)w, 0.0f, 1.0f);
+        if (opacity != active.opacity) {
+            active.opacity = opacity;
+            MarkLayersChanged();
+        }
+    }
+    y += rowH - 4;
+
+    // blend mode, cycled by clicking
+    if (PanelButton({ (float)x, (float)y, (float)w, (float)rowH - 2 }, LayerBlendName(active.blend), mouse)) {
+        PushState();
+        active.blend = (LayerBlend)((active.blend + 1) % LAYER_BLEND_COUNT);
+        MarkLayersChanged();
+    }
+    y += rowH;
+
+    float bw = (w - 6) / 4.0f;
+    bool add = PanelButton({ (float)x, (float)y, bw, (float)rowH }, "+", mouse);
+    bool del = PanelButton({ x + (bw + 2), (float)y, bw, (float)rowH }, "-", mouse);
+    bool up = PanelButton({ x + (bw + 2) * 2, (float)y, bw, (float)rowH }, "Up", mouse);
+    bool down = PanelButton({ x + (bw + 2) * 3, (float)y, bw, (float)rowH }, "Dn", mouse);
+    if (add) AddLayer();
+    if (del) DeleteLayer();
+    if (up) MoveLayer(1);
+    if (down) MoveLayer(-1);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return RunBenchmarks(argc, argv);
+    for (int i = 1; i < argc; ++i) {
+        const char *next = (i + 1 < argc) ? argv[i + 1] : "";
+        if (strcmp(argv[i], "--png-level") == 0) g_PngOptions.level = std::clamp(atoi(next), 0, 9);
+        if (strcmp(argv[i], "--png-dither") == 0) g_PaletteOptions.dither = true;
+        if (strcmp(argv[i], "--job-stats") == 0) g_PrintJobStats = true;
+        if (strcmp(argv[i], "--max-live-points") == 0) g_StrokeBudget.maxPoints = (size_t)std::max(0LL, atoll(next));
+        if (strcmp(argv[i], "--max-live-strokes") == 0) g_StrokeBudget.maxStrokes = (size_t)std::max(0LL, atoll(next));
+        if (strcmp(argv[i], "--png-palette") == 0) {
+            if (strcmp(next, "off") == 0) g_PaletteOptions.mode = PALETTE_OFF;
+            else if (strcmp(next, "exact") == 0) g_PaletteOptions.mode = PALETTE_EXACT;
+            else if (strcmp(next, "quantize") == 0) g_PaletteOptions.mode = PALETTE_QUANTIZE;
+        }
+    }
+
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(g_ScreenWidth, g_ScreenHeight, "ratart - Simple Drawing App");
     SetTargetFPS(60);
 
-    RecreateRenderTex(g_ScreenWidth - toolbarWidth, g_ScreenHeight - menuBarHeight);
+    g_CanvasWidth = g_ScreenWidth - toolbarWidth;
+    g_CanvasHeight = g_ScreenHeight - menuBarHeight;
+    FitCanvasInView();
+    ResetLayers();
     PushState();
 
     std::unique_ptr<PencilTool> pencilTool = std::make_unique<PencilTool>();
     std::unique_ptr<EraserTool> eraserTool = std::make_unique<EraserTool>();
     std::unique_ptr<DropperTool> dropperTool = std::make_unique<DropperTool>();
+    std::unique_ptr<BucketTool> bucketTool = std::make_unique<BucketTool>();
     std::unique_ptr<SquareTool> squareTool = std::make_unique<SquareTool>();
     std::unique_ptr<CircleTool> circleTool = std::make_unique<CircleTool>();
+    std::unique_ptr<GradientTool> gradientTool = std::make_unique<GradientTool>();
+    std::unique_ptr<SelectTool> selectTool = std::make_unique<SelectTool>();
+    std::unique_ptr<MoveTool> moveTool = std::make_unique<MoveTool>();
+    std::unique_ptr<BrushTool> brushTool = std::make_unique<BrushTool>();
     Tool* currentTool = pencilTool.get();
 
     std::vector<std::string> iconPaths = {
@@ -443,7 +2408,11 @@ int main() {
         "icons/dropper.png",
         "icons/bucket.png",
         "icons/square.png",
-        "icons/circle.png"
+        "icons/circle.png",
+        "icons/gradient.png",
+        "icons/select.png",
+        "icons/move.png",
+        "icons/brush.png"
     };
 
     struct ToolButton { std::string name, iconPath; Rectangle rect; KeyboardKey shortcut; int id; Texture2D icon; };
@@ -453,7 +2422,11 @@ int main() {
         { "Dropper", iconPaths[2], {}, KEY_I, 2, {} },
         { "Bucket",  iconPaths[3], {}, KEY_K, 3, {} },
         { "Square",  iconPaths[4], {}, KEY_S, 4, {} },
-        { "Circle",  iconPaths[5], {}, KEY_C, 5, {} }
+        { "Circle",  iconPaths[5], {}, KEY_C, 5, {} },
+        { "Gradient", iconPaths[6], {}, KEY_G, 6, {} },
+        { "Select",  iconPaths[7], {}, KEY_M, 7, {} },
+        { "Move",    iconPaths[8], {}, KEY_V, 8, {} },
+        { "Brush",   iconPaths[9], {}, KEY_N, 9, {} }
     };
 
     for (auto &b : toolButtons) {
@@ -462,8 +2435,14 @@ int main() {
     }
 
     std::vector<std::pair<std::string, std::vector<std::string>>> menu = {
-        {"File", {"New", "Open", "Save", "Save As"}},
-        {"Edit", {"Change Canvas Size", "Change Canvas BG"}}
+        {"File", {"New", "Open", "Save", "Save As", "Export Hi-Res"}},
+        {"Edit", {"Change Canvas Size", "Change Canvas BG", "Rotate 90 CW", "Rotate 180", "Rotate 90 CCW",
+                  "Flip Horizontal", "Flip Vertical"}},
+        {"Filter", {"Gaussian Blur", "Box Blur", "Unsharp Mask", "Find Edges"}},
+        {"Adjust", {"Brightness/Contrast", "Levels", "Curves", "Hue/Saturation", "Invert"}},
+        {"Select", {"Select All", "Deselect", "Invert Selection"}},
+        {"Symmetry", {"Off", "Mirror Left/Right", "Mirror Top/Bottom", "Mirror Four Ways",
+                      "Radial 6", "Radial 8", "Radial 12", "Mandala 12"}}
     };
 
     struct MenuTab { std::string label; Rectangle rect; std::vector<std::string> items; bool open; };
@@ -472,18 +2451,28 @@ int main() {
     for (auto &m : menu) {
         MenuTab t;
         t.label = m.first;
-        t.rect = { tabX, 0.0f, (float)menuBarHeight*2.0f, (float)menuBarHeight };
+        float tabW = std::max(menuBarHeight * 2.0f, MeasureText(t.label.c_str(), (int)(menuBarHeight*0.8f)) + menuBarHeight * 0.6f);
+        t.rect = { tabX, 0.0f, tabW, (float)menuBarHeight };
         t.items = m.second;
         t.open = false;
         menuTabs.push_back(t);
-        tabX += menuBarHeight * 2.0f;
+        tabX += tabW;
     }
 
-    Rectangle undoBtn = { menuBarHeight * 4.0f, 0, menuBarHeight*2.5f, menuBarHeight };
-    Rectangle redoBtn = { menuBarHeight * 6.5f, 0, menuBarHeight*2.5f, menuBarHeight };
+    Rectangle undoBtn = { tabX, 0, menuBarHeight*2.5f, menuBarHeight };
+    Rectangle redoBtn = { tabX + menuBarHeight * 2.5f, 0, menuBarHeight*2.5f, menuBarHeight };
 
     while (!WindowShouldClose()) {
         Vector2 mouse = GetMousePosition();
+        g_ScreenWidth = GetScreenWidth();
+        g_ScreenHeight = GetScreenHeight();
+
+        PollDialogs();
+        RunMainThreadPosts();
+        PollOpenJob();
+        StepTiledExport();
+        g_BackgroundPyramid.Update();
+        PollPreview();
 
         int wheelRadius = toolbarWidth / 3;
         int wheelCx = toolbarWidth / 2;
@@ -514,61 +2503,130 @@ int main() {
         bool insideCanvas = (mouse.x >= toolbarWidth &&
                              mouse.y >= menuBarHeight &&
                              mouse.x < g_ScreenWidth &&
-                             mouse.y < g_ScreenHeight);
-
-        if (insideCanvas) {
+                             mouse.y < g_ScreenHeight &&
+                             !OpenCardHit(mouse) &&
+                             !FilterCardHit(mouse) &&
+                             !AdjustCardHit(mouse));
+
+        UpdateCanvasCamera(mouse, insideCanvas);
+        Vector2 docMouse = ScreenToDocument(mouse);
+
+        // tools work in document coordinates and mark what they edit
+        UpdateLayerStrokes();
+        if (insideCanvas && !g_Panning && !IsKeyDown(KEY_SPACE)) {
+            const uint64_t before = g_DocumentVersion;
             if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                PushState();
-                currentTool->OnMouseDown(mouse);
-                g_HasUnsavedChanges = true;
-            }
-            if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
-                currentTool->OnMouseHold(mouse);
-                g_HasUnsavedChanges = true;
-            }
-            if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                currentTool->OnMouseUp(mouse);
-                g_HasUnsavedChanges = true;
+                g_PressDocument = CurrentDocument();
+                currentTool->OnMouseDown(docMouse);
             }
+            if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) currentTool->OnMouseHold(docMouse);
+            if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) currentTool->OnMouseUp(docMouse);
+            if (g_PressDocument && g_DocumentVersion != before) PushState(std::move(g_PressDocument));
         }
+        if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) g_PressDocument = nullptr;
+        UpdateLayerStrokes();
 
         // shortkey tool switching
         if (IsKeyPressed(KEY_B)) currentTool = pencilTool.get();
         if (IsKeyPressed(KEY_E)) currentTool = eraserTool.get();
         if (IsKeyPressed(KEY_I)) currentTool = dropperTool.get();
+        if (IsKeyPressed(KEY_K)) currentTool = bucketTool.get();
         if (IsKeyPressed(KEY_S)) currentTool = squareTool.get();
         if (IsKeyPressed(KEY_C)) currentTool = circleTool.get();
-        
-        // keyboard shortcuts for undo/redo
+        if (IsKeyPressed(KEY_G)) currentTool = gradientTool.get();
+        if (IsKeyPressed(KEY_M)) currentTool = selectTool.get();
+        if (IsKeyPressed(KEY_V)) currentTool = moveTool.get();
+        if (IsKeyPressed(KEY_N)) currentTool = brushTool.get();
+
+        // keyboard shortcuts for undo/redo and the selection
         if (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) {
             if (IsKeyPressed(KEY_Z)) DoUndo();
             if (IsKeyPressed(KEY_Y)) DoRedo();
+            if (IsKeyPressed(KEY_A)) Select_All();
+            if (IsKeyPressed(KEY_D)) ClearSelection();
+        }
+
+        // publish this frame's edits for background readers
+        CurrentDocument();
+        StepAutoFlatten();
+
+        // re-render the layers that changed (or all of them after a pan or
+        // zoom); only the background tiles this view needs are on the GPU,
+        // and zoomed-out strokes use their simplified points
+        Rectangle view = VisibleDocumentRect();
+        Rectangle canvasArea = { (float)toolbarWidth, (float)menuBarHeight,
+                                 (float)(g_ScreenWidth - toolbarWidth), (float)(g_ScreenHeight - menuBarHeight) };
+        uint64_t backgroundGeneration = g_BackgroundPyramid.Generation() + g_Preview.generation;
+        // the strokes each re-rendered layer draws, culled once for the brush
+        // rasters and the redraw
+        static std::vector<std::vector<size_t>> visible;
+        static std::vector<const CanvasStroke *> brushStrokes;
+        visible.resize(g_Layers.size());
+        brushStrokes.clear();
+        auto movingLayer = [&](size_t index) {
+            return index == (size_t)g_ActiveLayer && currentTool == moveTool.get() && moveTool->Transforming();
+        };
+        // a move drag draws its strokes through a new matrix every frame;
+        // their points, and so the layer version, only change on release
+        if (movingLayer(g_ActiveLayer)) g_LayerCache.Invalidate(g_Layers[g_ActiveLayer].id);
+        for (size_t l = 0; l < g_Layers.size(); ++l) {
+            visible[l].clear();
+            if (!g_LayerCache.Stale(g_Layers, l, g_Camera, canvasArea, backgroundGeneration)) continue;
+            VisibleStrokes(g_Layers[l], view, movingLayer(l) ? moveTool.get() : nullptr, visible[l]);
+            for (size_t i : visible[l])
+                if (g_Layers[l].strokes[i].brush) brushStrokes.push_back(&g_Layers[l].strokes[i]);
         }
+        // brush strokes are rastered first; the layer targets only blend them in
+        g_Brushes.Update(brushStrokes, g_Camera.zoom, g_CurrentStroke);
+        g_LayerCache.Update(g_Layers, g_Camera, canvasArea, backgroundGeneration, [&](size_t index) {
+            if (index == 0 && !DrawBackgroundPreview())
+                g_BackgroundPyramid.Draw(*g_BackgroundPyramid.Levels(), view, g_Camera.zoom, false);
+            const bool moving = movingLayer(index);
+            const auto &strokes = g_Layers[index].strokes;
+            for (size_t i : visible[index]) {
+                const CanvasStroke &stroke = strokes[i];
+                if (moving && moveTool->IsPicked(i)) {
+                    // drawn through the drag's matrix; the points are only
+                    // rewritten on release
+                    const Matrix &m = moveTool->DragMatrix();
+                    rlPushMatrix();
+                    rlMultMatrixf(MatrixToFloatV(m).v);
+                    if (stroke.brush) g_Brushes.Draw(stroke);
+                    else DrawStrokePoints(stroke, StrokePointsForZoom(stroke, g_Camera.zoom * moveTool->DragScale()));
+                    rlPopMatrix();
+                    continue;
+                }
+                if (stroke.brush) g_Brushes.Draw(stroke);
+                else DrawStrokePoints(stroke, StrokePointsForZoom(stroke, g_Camera.zoom));
+            }
+        });
 
         BeginDrawing();
-        ClearBackground(WHITE);
+        ClearBackground(Color{200,200,200,255});
 
         // draw background canvas area
-        int canvasW = g_RenderTex.texture.width;
-        int canvasH = g_RenderTex.texture.height;
+        int canvasW = g_CanvasWidth;
+        int canvasH = g_CanvasHeight;
 
-        if (g_BackgroundTexture.id != 0) {
-            DrawTexture(g_BackgroundTexture, toolbarWidth, menuBarHeight, WHITE);
-        } else {
-            DrawRectangle(toolbarWidth, menuBarHeight, canvasW, canvasH, WHITE);
-        }
-
-        // draw strokes on top
-        for (const auto &stroke : g_CanvasStrokes) {
-            if (stroke.erased) continue;
-            if (stroke.points.size() < 2) continue;
-            for (size_t i = 1; i < stroke.points.size(); ++i) {
-                DrawLineEx(stroke.points[i-1], stroke.points[i], stroke.size, stroke.color);
-                DrawCircleV(stroke.points[i], stroke.size*0.5f, stroke.color);
-            }
-        }
+        // clip to the part of the canvas that is on screen
+        Vector2 clipA = GetWorldToScreen2D({ std::max(0.0f, view.x), std::max(0.0f, view.y) }, g_Camera);
+        Vector2 clipB = GetWorldToScreen2D({ std::min((float)canvasW, view.x + view.width), std::min((float)canvasH, view.y + view.height) }, g_Camera);
+        BeginScissorMode((int)clipA.x, (int)clipA.y, std::max(0, (int)ceilf(clipB.x - clipA.x)), std::max(0, (int)ceilf(clipB.y - clipA.y)));
+        BeginMode2D(g_Camera);
 
-        currentTool->DrawPreview(mouse);
+        DrawRectangle(0, 0, canvasW, canvasH, WHITE);
+        EndMode2D();
+        g_LayerCache.Draw(g_Layers, canvasArea);
+        EndScissorMode();
+
+        BeginMode2D(g_Camera);
+        DrawSelectionOutline();
+        DrawSymmetryGuides(ActiveSymmetry(), (float)canvasW, (float)canvasH, g_Camera.zoom);
+        currentTool->DrawPreview(docMouse);
+        EndMode2D();
+        DrawOpenProgress(mouse);
+        DrawFilterCard(mouse);
+        DrawAdjustCard(mouse);
 
         // Tool bar / UI elements (color wheel etc.)
         DrawRectangle(0, menuBarHeight, toolbarWidth, g_ScreenHeight - menuBarHeight, ColorFromHSV(0,0,25));
@@ -609,13 +2667,21 @@ int main() {
                 if (i == 0) currentTool = pencilTool.get();
                 else if (i == 1) currentTool = eraserTool.get();
                 else if (i == 2) currentTool = dropperTool.get();
+                else if (i == 3) currentTool = bucketTool.get();
                 else if (i == 4) currentTool = squareTool.get();
                 else if (i == 5) currentTool = circleTool.get();
+                else if (i == 6) currentTool = gradientTool.get();
+                else if (i == 7) currentTool = selectTool.get();
+                else if (i == 8) currentTool = moveTool.get();
+                else if (i == 9) currentTool = brushTool.get();
             }
         }
 
         // Draw UI for active tool (slider for size)
-        currentTool->DrawUI((toolbarWidth - 100) * 0.5f, startY + iconSize*2 + 20);
+        int iconRows = ((int)toolButtons.size() + cols - 1) / cols;
+        currentTool->DrawUI((toolbarWidth - 100) * 0.5f, startY + (iconSize + spacing) * iconRows + 8);
+
+        DrawLayersPanel(mouse);
 
         // ------ MENU BAR -------
         DrawRectangle(0,0, g_ScreenWidth, menuBarHeight, LIGHTGRAY);
@@ -641,11 +2707,34 @@ int main() {
                     DrawRectangleLinesEx(itrect, 1, BLACK);
                     DrawText(tab.items[i].c_str(), (int)itrect.x+6, (int)itrect.y+4, 16, BLACK);
                     if (CheckCollisionPointRec(mouse, itrect) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                        if (tab.label == "File") {
+                        // one file action at a time; its dialogs are still pending
+                        if (tab.label == "File" && !DialogsBusy()) {
                             if (tab.items[i] == "New") File_New();
                             else if (tab.items[i] == "Open") File_Open();
                             else if (tab.items[i] == "Save") File_Save();
                             else if (tab.items[i] == "Save As") File_SaveAs();
+                            else if (tab.items[i] == "Export Hi-Res") File_ExportHiRes();
+                        } else if (tab.label == "Edit" && !DialogsBusy()) {
+                            if (tab.items[i] == "Change Canvas Size") Edit_ChangeCanvasSize();
+                            else if (tab.items[i] == "Rotate 90 CW") OrientCanvas(CANVAS_ROTATE_CW);
+                            else if (tab.items[i] == "Rotate 180") OrientCanvas(CANVAS_ROTATE_180);
+                            else if (tab.items[i] == "Rotate 90 CCW") OrientCanvas(CANVAS_ROTATE_CCW);
+                            else if (tab.items[i] == "Flip Horizontal") OrientCanvas(CANVAS_FLIP_HORIZONTAL);
+                            else if (tab.items[i] == "Flip Vertical") OrientCanvas(CANVAS_FLIP_VERTICAL);
+                        } else if (tab.label == "Filter" && !DialogsBusy()) {
+                            CloseAdjustCard();
+                            for (int k = 0; k < FILTER_COUNT; ++k)
+                                if (tab.items[i] == FilterName((FilterKind)k)) Filter_Open((FilterKind)k);
+                        } else if (tab.label == "Adjust" && !DialogsBusy()) {
+                            CloseFilterCard();
+                            for (int k = 0; k < ADJUST_COUNT; ++k)
+                                if (tab.items[i] == AdjustmentName((AdjustmentKind)k)) Adjust_Open((AdjustmentKind)k);
+                        } else if (tab.label == "Select") {
+                            if (tab.items[i] == "Select All") Select_All();
+                            else if (tab.items[i] == "Deselect") ClearSelection();
+                            else if (tab.items[i] == "Invert Selection") Select_Invert();
+                        } else if (tab.label == "Symmetry") {
+                            Symmetry_Set(tab.items[i]);
                         }
                         tab.open = false;
                     }
@@ -679,14 +2768,41 @@ int main() {
             if (CheckCollisionPointRec(mouse, redoBtn)) { DoRedo(); }
         }
 
+        // current zoom, next to the undo/redo buttons
+        DrawText(TextFormat("%d%%", (int)(g_Camera.zoom * 100.0f + 0.5f)), (int)(redoBtn.x + redoBtn.width + menuBarHeight * 0.5f), (int)(menuBarHeight*0.2f), (int)(menuBarHeight*0.7f), DARKGRAY);
+
+        // Save progress (right side of the menu bar)
+        DrawSaveProgress(g_ScreenWidth - 170, 3, 160, menuBarHeight - 6);
+        DrawExportProgress(g_ScreenWidth - 340, 3, 160, menuBarHeight - 6);
+
         EndDrawing();
     }
 
-    // cleanup
+    // cleanup; saves and exports finish first, so a failure among them is
+    // still reported before the dialog thread goes
+    FinishSaveJobs();
+    FinishOpenJobs();
+    while (g_TiledExport) StepTiledExport(true);
+    ShutdownDialogs();
+    if (g_FlattenJob) WaitJob(g_FlattenJob->task);
     for (auto &b : toolButtons) if (b.icon.id != 0) UnloadTexture(b.icon);
-    if (g_BackgroundTexture.id != 0) UnloadTexture(g_BackgroundTexture);
-    if (g_BackgroundImage.data != nullptr) UnloadImage(g_BackgroundImage);
-    if (g_RenderTex.texture.id != 0) UnloadRenderTexture(g_RenderTex);
+    EndBackgroundPreview();
+    g_LayerCache.Release();
+    ReleaseCanvasRenderTargets();
+    g_Brushes.Release();
+    g_BackgroundPyramid.Release();
     CloseWindow();
+
+    JobsShutdown();
+    if (g_PrintJobStats) {
+        printf("%-20s %8s %12s %10s\n", "job", "runs", "total ms", "max ms");
+        for (const auto &t : GetJobTimings())
+            printf("%-20s %8llu %12.1f %10.2f\n", t.name.c_str(), t.runs, t.totalMs, t.maxMs);
+    }
+    if (g_FlattenStats.events > 0) {
+        printf("auto-flatten: %zu events, %zu strokes (%zu points) in %zu tiles, %.1f MB of live strokes freed\n",
+               g_FlattenStats.events, g_FlattenStats.strokes, g_FlattenStats.points, g_FlattenStats.tiles,
+               g_FlattenStats.bytes / (1024.0 * 1024.0));
+    }
     return 0;
 }
@@ -0,0 +1,71 @@
+#include "BrushTool.hpp"
+#include "../BrushEngine.hpp"
+#include <algorithm>
+
+extern std::vector<CanvasStroke> &ActiveStrokes();
+extern CanvasStroke* g_CurrentStroke;
+extern void MarkDocumentChanged();
+
+void BrushTool::OnMouseDown(Vector2 pos) {
+    ActiveStrokes().push_back(CanvasStroke());
+    g_CurrentStroke = &ActiveStrokes().back();
+    g_CurrentStroke->color = color;
+    g_CurrentStroke->size = size;
+    // the jitter follows the stroke id, so every stroke scatters differently
+    auto settings = std::make_shared<StrokeBrush>(brush);
+    settings->seed = (uint32_t)g_CurrentStroke->id;
+    g_CurrentStroke->brush = settings;
+    g_CurrentStroke->points.push_back(pos);
+    MarkDocumentChanged();
+}
+
+void BrushTool::OnMouseHold(Vector2 pos) {
+    if (g_CurrentStroke) {
+        g_CurrentStroke->points.push_back(pos);
+        MarkDocumentChanged();
+    }
+}
+
+void BrushTool::OnMouseUp(Vector2 /*pos*/) {
+    g_CurrentStroke = nullptr;
+}
+
+void BrushTool::DrawPreview(Vector2 mouse) {
+    DrawCircleLinesV(mouse, size / 2.0f, GRAY);
+}
+
+// Label with the value above a 100 px bar; dragging on the bar sets the value.
+static void Slider(int x, int y, const char *label, float &value, float lo, float hi) {
+    DrawText(label, x, y, 16, BLACK);
+    const int sliderW = 100;
+    const int sliderH = 10;
+    DrawRectangle(x, y + 18, sliderW, sliderH, LIGHTGRAY);
+    float t = (value - lo) / (hi - lo);
+    DrawRectangle(x + (int)(t * sliderW) - 3, y + 18, 6, sliderH, BLACK);
+
+    Vector2 m = GetMousePosition();
+    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) &&
+        m.y >= y + 18 && m.y <= y + 18 + sliderH &&
+        m.x >= x && m.x <= x + sliderW)
+        value = lo + std::clamp((m.x - x) / (float)sliderW, 0.0f, 1.0f) * (hi - lo);
+}
+
+void BrushTool::DrawUI(int x, int y) {
+    Vector2 m = GetMousePosition();
+
+    // tip, switched by clicking
+    Rectangle tipBtn = { (float)x, (float)y, 100, 18 };
+    DrawRectangleRec(tipBtn, CheckCollisionPointRec(m, tipBtn) ? GRAY : LIGHTGRAY);
+    DrawText(BrushTipName(brush.tip), x + 6, y + 1, 16, BLACK);
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(m, tipBtn))
+        brush.tip = (BrushTip)((brush.tip + 1) % BRUSH_TIP_COUNT);
+
+    Slider(x, y + 24, TextFormat("Size: %dpx", (int)size), size, 1, 200);
+    Slider(x, y + 56, TextFormat("Spacing: %d%%", (int)(brush.spacing * 100 + 0.5f)), brush.spacing, 0.02f, 1.0f);
+    Slider(x, y + 88, TextFormat("Jitter: %d%%", (int)(brush.jitter * 100 + 0.5f)), brush.jitter, 0.0f, 1.0f);
+    Slider(x, y + 120, TextFormat("Flow: %d%%", (int)(brush.flow * 100 + 0.5f)), brush.flow, 0.01f, 1.0f);
+    Slider(x, y + 152, TextFormat("Opacity: %d%%", (int)(brush.opacity * 100 + 0.5f)), brush.opacity, 0.01f, 1.0f);
+
+    if (IsKeyDown(KEY_LEFT_BRACKET) && size > 1) size -= 0.25f;
+    if (IsKeyDown(KEY_RIGHT_BRACKET) && size < 200) size += 0.25f;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Tool.hpp"
+#include "CanvasStroke.hpp"
+
+// Paints brush strokes: dabs of a soft, hard or grainy tip stamped along
+// the path (see BrushEngine.hpp). Each stroke keeps a copy of the settings
+// it was drawn with.
+class BrushTool : public Tool {
+public:
+    Color color = BLACK;
+    float size = 24.0f;
+    StrokeBrush brush;
+
+    void OnMouseDown(Vector2 pos) override;
+    void OnMouseHold(Vector2 pos) override;
+    void OnMouseUp(Vector2 /*pos*/) override;
+
+    void Draw() override {}
+    void DrawUI(int x, int y) override;
+    void DrawPreview(Vector2 mouse) override;
+
+    void SetColor(const Color& c) override { color = c; }
+};
@@ -0,0 +1,41 @@
+#include "BucketTool.hpp"
+
+extern int FillCanvasAt(const Vector2 &docPos, Color color, int tolerance, bool expandEdges);
+
+void BucketTool::OnMouseDown(Vector2 pos) {
+    FillCanvasAt(pos, color, (int)tolerance, expandEdges);
+}
+
+void BucketTool::DrawPreview(Vector2 mouse) {
+    DrawLineV({ mouse.x - 4, mouse.y }, { mouse.x + 4, mouse.y }, GRAY);
+    DrawLineV({ mouse.x, mouse.y - 4 }, { mouse.x, mouse.y + 4 }, GRAY);
+}
+
+void BucketTool::DrawUI(int x, int y) {
+    DrawText(TextFormat("Tolerance: %d", (int)tolerance), x, y, 16, BLACK);
+
+    int w = 100, h = 15;
+    DrawRectangle(x, y + 20, w, h, LIGHTGRAY);
+
+    float t = tolerance / 255.0f;
+    int hx = x + (int)(t * w);
+    DrawRectangle(hx - 3, y + 20, 6, h, BLACK);
+
+    Vector2 m = GetMousePosition();
+    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) &&
+        m.x >= x && m.x <= x + w &&
+        m.y >= y + 20 && m.y <= y + 20 + h)
+    {
+        tolerance = ((m.x - x) / w) * 255.0f;
+    }
+
+    // smooth edges toggle
+    Rectangle box = { (float)x, (float)(y + 42), 14, 14 };
+    DrawRectangleLinesEx(box, 1, BLACK);
+    if (expandEdges) DrawRectangle(x + 3, y + 45, 8, 8, BLACK);
+    DrawText("Smooth edges", x + 20, y + 41, 16, BLACK);
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(m, box)) expandEdges = !expandEdges;
+
+    if (IsKeyDown(KEY_LEFT_BRACKET) && tolerance > 0) tolerance -= 0.5f;
+    if (IsKeyDown(KEY_RIGHT_BRACKET) && tolerance < 255) tolerance += 0.5f;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Tool.hpp"
+
+class BucketTool : public Tool {
+public:
+    Color color = BLACK;
+    float tolerance = 32.0f;   // per channel, 0-255
+    bool expandEdges = true;   // grow the fill under anti-aliased edges
+
+    void OnMouseDown(Vector2 pos) override;
+    void OnMouseHold(Vector2 /*pos*/) override {}
+    void OnMouseUp(Vector2 /*pos*/) override {}
+
+    void Draw() override {}
+    void DrawUI(int x, int y) override;
+    void DrawPreview(Vector2 mouse) override;
+
+    void SetColor(const Color& c) override { color = c; }
+};
@@ -0,0 +1,109 @@
+// CanvasStroke.hpp
+#pragma once
+#include <raylib-cpp.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+uint64_t NewStrokeId();
+struct StrokeLod;
+
+enum BrushTip {
+    BRUSH_TIP_SOFT = 0,
+    BRUSH_TIP_HARD,
+    BRUSH_TIP_GRAIN,
+    BRUSH_TIP_COUNT
+};
+
+// How a brush stroke is stamped along its points (see BrushEngine.hpp).
+struct StrokeBrush {
+    BrushTip tip = BRUSH_TIP_SOFT;
+    float spacing = 0.1f;   // distance between dabs, fraction of the size
+    float jitter = 0.0f;    // largest random dab offset, fraction of the size
+    float flow = 0.25f;     // alpha of each dab
+    float opacity = 1.0f;   // alpha ceiling of the whole stroke
+    uint32_t seed = 0;      // of the jitter, so the stroke always looks the same
+};
+
+// Further places a stroke is drawn at, for symmetric drawing (see
+// Symmetry.hpp). Shared by every stroke drawn with the same settings.
+struct StrokeSymmetry {
+    std::vector<Matrix> copies;    // document space; the stroke itself is not listed
+    std::vector<Matrix> inverses;  // of `copies`, for hit tests
+};
+
+// A drawn stroke, in document coordinates (0,0 = top-left of the canvas).
+// Strokes only grow while they are being drawn; any other edit (erasing,
+// splitting) creates new strokes, so a stroke's id plus its point count
+// identify its content.
+struct CanvasStroke {
+    std::vector<Vector2> points;
+    float size;
+    Color color;
+    bool erased = false;
+    uint64_t id = NewStrokeId();
+    // stamped dabs instead of a solid line; null for pencil and shape strokes
+    std::shared_ptr<const StrokeBrush> brush;
+    // mirrored / rotated copies; null when the stroke is drawn once
+    std::shared_ptr<const StrokeSymmetry> symmetry;
+
+    // document-space box around the points, brush radius included, and
+    // around its symmetric copies; covers the first `boundsPoints` points
+    // (see UpdateStrokeBounds). `sourceBounds` leaves out the copies.
+    Rectangle bounds = { 0, 0, 0, 0 };
+    Rectangle sourceBounds = { 0, 0, 0, 0 };
+    size_t boundsPoints = 0;
+
+    // simplified copies for zoomed-out drawing, attached once built
+    // (see StrokeLod.hpp); stale once the point count moves on
+    std::shared_ptr<const StrokeLod> lod;
+};
+
+// How far the stroke's paint reaches from its points.
+inline float StrokeReach(const CanvasStroke &stroke) {
+    float r = stroke.size * 0.5f;
+    return stroke.brush ? r + stroke.size * stroke.brush->jitter : r;
+}
+
+// Extends `bounds` over the points added since the last call. Main thread,
+// once per frame, so snapshots and the renderer can cull by bounds.
+inline void UpdateStrokeBounds(CanvasStroke &stroke) {
+    if (stroke.boundsPoints == stroke.points.size()) return;
+    if (stroke.points.size() < stroke.boundsPoints) stroke.boundsPoints = 0;
+
+    float r = StrokeReach(stroke);
+    float minX, minY, maxX, maxY;
+    if (stroke.boundsPoints == 0) {
+        minX = maxX = stroke.points[0].x;
+        minY = maxY = stroke.points[0].y;
+    } else {
+        minX = stroke.sourceBounds.x + r;
+        minY = stroke.sourceBounds.y + r;
+        maxX = stroke.sourceBounds.x + stroke.sourceBounds.width - r;
+        maxY = stroke.sourceBounds.y + stroke.sourceBounds.height - r;
+    }
+    for (size_t i = stroke.boundsPoints; i < stroke.points.size(); ++i) {
+        const Vector2 &p = stroke.points[i];
+        minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+    }
+    stroke.sourceBounds = { minX - r, minY - r, maxX - minX + 2*r, maxY - minY + 2*r };
+    stroke.boundsPoints = stroke.points.size();
+
+    // each copy's box is the transformed corners of the source box
+    const Rectangle &b = stroke.sourceBounds;
+    minX = b.x; minY = b.y; maxX = b.x + b.width; maxY = b.y + b.height;
+    if (stroke.symmetry) {
+        for (const Matrix &m : stroke.symmetry->copies) {
+            for (int c = 0; c < 4; ++c) {
+                float x = (c & 1) ? b.x + b.width : b.x;
+                float y = (c & 2) ? b.y + b.height : b.y;
+                float tx = m.m0 * x + m.m4 * y + m.m12, ty = m.m1 * x + m.m5 * y + m.m13;
+                minX = std::min(minX, tx); maxX = std::max(maxX, tx);
+                minY = std::min(minY, ty); maxY = std::max(maxY, ty);
+            }
+        }
+    }
+    stroke.bounds = { minX, minY, maxX - minX, maxY - minY };
+}
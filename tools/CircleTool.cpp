@@ -1,15 +1,11 @@
 #include "CircleTool.hpp"
+#include "CanvasStroke.hpp"
 #include <cmath>
 
-extern std::vector<struct CanvasStroke> g_CanvasStrokes;
-extern struct CanvasStroke* g_CurrentStroke;
-
-struct CanvasStroke {
-    std::vector<Vector2> points;
-    float size;
-    Color color;
-    bool erased = false;
-};
+extern std::vector<CanvasStroke> &ActiveStrokes();
+extern CanvasStroke* g_CurrentStroke;
+extern void MarkDocumentChanged();
+extern std::shared_ptr<const StrokeSymmetry> CurrentSymmetry();
 
 static constexpr int CIRCLE_SEGMENTS = 64;
 
@@ -36,6 +32,7 @@ void CircleTool::OnMouseUp(Vector2 pos) {
     stroke.color = color;
     stroke.size = thickness;
     stroke.erased = false;
+    stroke.symmetry = CurrentSymmetry();
 
     for (int i = 0; i <= CIRCLE_SEGMENTS; ++i) {
         float a = (2 * PI * i) / CIRCLE_SEGMENTS;
@@ -45,7 +42,8 @@ void CircleTool::OnMouseUp(Vector2 pos) {
         });
     }
 
-    g_CanvasStrokes.push_back(stroke);
+    ActiveStrokes().push_back(stroke);
+    MarkDocumentChanged();
 }
 
 void CircleTool::DrawPreview(Vector2 /*mouse*/) {
@@ -55,7 +53,7 @@ void CircleTool::DrawPreview(Vector2 /*mouse*/) {
     float dy = edge.y - center.y;
     float radius = sqrtf(dx*dx + dy*dy);
 
-    DrawCircleLines(center.x, center.y, radius, Fade(color, 0.7f));
+    DrawCircleLinesV(center, radius, Fade(color, 0.7f));
 }
 
 void CircleTool::DrawUI(int x, int y) {
@@ -1,4 +1,7 @@
 #include "DropperTool.hpp"
+#include "CanvasStroke.hpp"
+#include "../Document.hpp"
+#include "../Symmetry.hpp"
 #include <algorithm>
 #include <cmath>
 
@@ -12,15 +15,7 @@ extern float g_SelectedHue;
 extern float g_SelectedSat;
 extern float g_ColorValue;
 
-extern Image g_BackgroundImage;
-extern std::vector<struct CanvasStroke> g_CanvasStrokes;
-
-struct CanvasStroke {
-    std::vector<Vector2> points;
-    float size;
-    Color color;
-    bool erased;
-};
+extern std::vector<Layer> g_Layers;
 
 static float DistPointSegment(Vector2 p, Vector2 a, Vector2 b) {
     Vector2 ab = { b.x - a.x, b.y - a.y };
@@ -34,17 +29,28 @@ static float DistPointSegment(Vector2 p, Vector2 a, Vector2 b) {
     return std::sqrt(dx*dx + dy*dy);
 }
 
-static Color SampleFromStrokes(Vector2 screenPos, bool &hit) {
+// Topmost stroke under `pos`, searching visible layers from the top.
+// Symmetric copies are found by looking up `pos` on the source line.
+static Color SampleFromStrokes(Vector2 pos, bool &hit) {
     hit = false;
-
-    for (auto it = g_CanvasStrokes.rbegin(); it != g_CanvasStrokes.rend(); ++it) {
-        const auto &s = *it;
-        if (s.points.size() < 2 || s.erased) continue;
-
-        for (size_t i = 1; i < s.points.size(); ++i) {
-            if (DistPointSegment(screenPos, s.points[i-1], s.points[i]) <= s.size * 0.5f) {
-                hit = true;
-                return s.color;
+    std::vector<Vector2> probes;
+
+    for (auto layer = g_Layers.rbegin(); layer != g_Layers.rend(); ++layer) {
+        if (!layer->visible) continue;
+        for (auto it = layer->strokes.rbegin(); it != layer->strokes.rend(); ++it) {
+            const auto &s = *it;
+            if (s.points.size() < 2 || s.erased) continue;
+            if (!CheckCollisionPointRec(pos, s.bounds)) continue;
+
+            probes.clear();
+            SymmetryQueryPoints(s, pos, probes);
+            for (const Vector2 &q : probes) {
+                for (size_t i = 1; i < s.points.size(); ++i) {
+                    if (DistPointSegment(q, s.points[i-1], s.points[i]) <= s.size * 0.5f) {
+                        hit = true;
+                        return s.color;
+                    }
+                }
             }
         }
     }
@@ -52,28 +58,20 @@ static Color SampleFromStrokes(Vector2 screenPos, bool &hit) {
     return WHITE;
 }
 
-static Color SampleFromBackground(Vector2 screenPos, bool &hit) {
+static Color SampleFromBackground(Vector2 pos, bool &hit) {
     hit = false;
-    if (!g_BackgroundImage.data) return WHITE;
+    if (!HasBackground() || !g_Layers[0].visible) return WHITE;
 
-    int x = (int)(screenPos.x - toolbarWidth);
-    int y = (int)(screenPos.y - menuBarHeight);
+    int x = (int)pos.x;
+    int y = (int)pos.y;
 
     if (x < 0 || y < 0 ||
-        x >= g_BackgroundImage.width ||
-        y >= g_BackgroundImage.height)
+        x >= BackgroundWidth() ||
+        y >= BackgroundHeight())
         return WHITE;
 
-    unsigned char* px = (unsigned char*)g_BackgroundImage.data;
-    int idx = (y * g_BackgroundImage.width + x) * 4;
-
     hit = true;
-    return {
-        px[idx],
-        px[idx + 1],
-        px[idx + 2],
-        px[idx + 3]
-    };
+    return GetBackgroundPixel(x, y);
 }
 
 static void UpdateHSVFromColor(Color c) {
@@ -101,5 +99,5 @@ void DropperTool::OnMouseDown(Vector2 pos) {
 }
 
 void DropperTool::DrawPreview(Vector2 mouse) {
-    DrawCircleLines(mouse.x, mouse.y, 3, GRAY);
+    DrawCircleLinesV(mouse, 3, GRAY);
 }
@@ -1,27 +1,47 @@
 // EraserTool.cpp
 #include "EraserTool.hpp"
+#include "CanvasStroke.hpp"
+#include "../Symmetry.hpp"
 #include <raylib-cpp.hpp>
 
-extern void EraseBackgroundAt(const Vector2 &screenPos, float radius);
-extern std::vector<struct CanvasStroke> g_CanvasStrokes;
-
-struct CanvasStroke {
-    std::vector<Vector2> points;
-    float size;
-    Color color;
-    bool erased = false;
-};
+extern void EraseBackgroundAt(const Vector2 &docPos, float radius);
+extern std::vector<CanvasStroke> &ActiveStrokes();
+extern void MarkDocumentChanged();
 
 void EraserTool::OnMouseDown(Vector2 pos) { OnMouseHold(pos); }
 void EraserTool::OnMouseUp(Vector2 /*pos*/) {}
 
 void EraserTool::OnMouseHold(Vector2 pos) {
     std::vector<CanvasStroke> newStrokeList;
+    std::vector<Vector2> probes;
+    bool changed = false;
+
+    for (auto &stroke : ActiveStrokes()) {
+        // erasing a symmetric copy erases that part of the source, so the
+        // stroke stays symmetric
+        probes.clear();
+        SymmetryQueryPoints(stroke, pos, probes);
+        auto erases = [&](const Vector2 &p) {
+            for (const Vector2 &q : probes)
+                if (CheckCollisionPointCircle(q, p, size)) return true;
+            return false;
+        };
+
+        bool touched = false;
+        for (auto &p : stroke.points) {
+            if (erases(p)) { touched = true; break; }
+        }
+        // strokes the eraser misses are kept as they are (same id)
+        if (!touched) {
+            if (stroke.points.size() > 1) newStrokeList.push_back(std::move(stroke));
+            else changed = true;
+            continue;
+        }
+        changed = true;
 
-    for (auto &stroke : g_CanvasStrokes) {
         std::vector<Vector2> buffer;
         for (auto &p : stroke.points) {
-            bool hit = CheckCollisionPointCircle(pos, p, size);
+            bool hit = erases(p);
             if (!hit) {
                 buffer.push_back(p);
             } else {
@@ -29,6 +49,8 @@ void EraserTool::OnMouseHold(Vector2 pos) {
                     CanvasStroke split;
                     split.color = stroke.color;
                     split.size = stroke.size;
+                    split.brush = stroke.brush;
+                    split.symmetry = stroke.symmetry;
                     split.points = buffer;
                     newStrokeList.push_back(split);
                 }
@@ -39,12 +61,16 @@ void EraserTool::OnMouseHold(Vector2 pos) {
             CanvasStroke split;
             split.color = stroke.color;
             split.size = stroke.size;
+            split.brush = stroke.brush;
+            split.symmetry = stroke.symmetry;
             split.points = buffer;
             newStrokeList.push_back(split);
         }
     }
 
-    g_CanvasStrokes = newStrokeList;
+    ActiveStrokes() = std::move(newStrokeList);
+    // a dab that missed every stroke is no edit
+    if (changed) MarkDocumentChanged();
 
     EraseBackgroundAt(pos, size);
 }
@@ -52,7 +78,7 @@ void EraserTool::OnMouseHold(Vector2 pos) {
 void EraserTool::Draw() {}
 
 void EraserTool::DrawPreview(Vector2 mouse) {
-    DrawCircleLines(mouse.x, mouse.y, size, GRAY);
+    DrawCircleLinesV(mouse, size, GRAY);
 }
 
 void EraserTool::DrawUI(int x, int y) {
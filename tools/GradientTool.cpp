@@ -0,0 +1,152 @@
+#include "GradientTool.hpp"
+#include "rlgl.h"
+#include <cmath>
+
+extern void GradientCanvas(const GradientParams &g);
+extern Camera2D g_Camera;
+extern int g_CanvasWidth;
+extern int g_CanvasHeight;
+
+static bool IsSnapKeyDown() {
+    return IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+}
+
+static Color LerpColor(Color a, Color b, float t) {
+    return {
+        (unsigned char)(a.r + (b.r - a.r) * t + 0.5f),
+        (unsigned char)(a.g + (b.g - a.g) * t + 0.5f),
+        (unsigned char)(a.b + (b.b - a.b) * t + 0.5f),
+        (unsigned char)(a.a + (b.a - a.a) * t + 0.5f)
+    };
+}
+
+static void Vertex(Vector2 v, Color c) {
+    rlColor4ub(c.r, c.g, c.b, c.a);
+    rlVertex2f(v.x, v.y);
+}
+
+static void Quad(Vector2 a, Vector2 b, Vector2 c, Vector2 d, Color ca, Color cb, Color cc, Color cd) {
+    Vertex(a, ca); Vertex(b, cb); Vertex(c, cc);
+    Vertex(a, ca); Vertex(c, cc); Vertex(d, cd);
+}
+
+GradientParams GradientTool::Params() const {
+    GradientParams g;
+    g.shape = shape;
+    g.start = start;
+    g.end = end;
+    g.from = color;
+    g.to = endColor;
+    g.dither = dither;
+
+    // shift snaps the direction to 45 degree steps
+    if (IsSnapKeyDown()) {
+        float dx = end.x - start.x, dy = end.y - start.y;
+        float len = sqrtf(dx * dx + dy * dy);
+        float angle = roundf(atan2f(dy, dx) / (PI / 4)) * (PI / 4);
+        g.end = { start.x + cosf(angle) * len, start.y + sinf(angle) * len };
+    }
+    return g;
+}
+
+void GradientTool::OnMouseDown(Vector2 pos) {
+    dragging = true;
+    start = end = pos;
+}
+
+void GradientTool::OnMouseHold(Vector2 pos) {
+    if (dragging)
+        end = pos;
+}
+
+void GradientTool::OnMouseUp(Vector2 pos) {
+    if (!dragging) return;
+    dragging = false;
+    end = pos;
+
+    GradientParams g = Params();
+    float dx = g.end.x - g.start.x, dy = g.end.y - g.start.y;
+    if (dx * dx + dy * dy < 1.0f) return;
+    GradientCanvas(g);
+}
+
+// The drag preview is plain geometry with interpolated vertex colours,
+// clipped to the canvas; the image is only rasterized on release.
+void GradientTool::DrawPreview(Vector2 /*mouse*/) {
+    if (!dragging) return;
+
+    GradientParams g = Params();
+    float dx = g.end.x - g.start.x, dy = g.end.y - g.start.y;
+    float len = sqrtf(dx * dx + dy * dy);
+    if (len < 1.0f) return;
+
+    Vector2 a = GetWorldToScreen2D({ 0, 0 }, g_Camera);
+    Vector2 b = GetWorldToScreen2D({ (float)g_CanvasWidth, (float)g_CanvasHeight }, g_Camera);
+    BeginScissorMode((int)a.x, (int)a.y, (int)ceilf(b.x - a.x), (int)ceilf(b.y - a.y));
+    rlDisableBackfaceCulling();
+
+    if (g.shape == GRADIENT_LINEAR) {
+        // three bands across the direction: solid start colour, the ramp, solid end colour
+        Vector2 u = { dx / len, dy / len };
+        Vector2 p = { -u.y, u.x };
+        float far = (float)(g_CanvasWidth + g_CanvasHeight) + fabsf(g.start.x) + fabsf(g.start.y) + len;
+        auto at = [&](float along, float across) {
+            return Vector2{ g.start.x + u.x * along + p.x * across, g.start.y + u.y * along + p.y * across };
+        };
+        rlBegin(RL_TRIANGLES);
+        Quad(at(-far, -far), at(0, -far), at(0, far), at(-far, far), g.from, g.from, g.from, g.from);
+        Quad(at(0, -far), at(len, -far), at(len, far), at(0, far), g.from, g.to, g.to, g.from);
+        Quad(at(len, -far), at(far, -far), at(far, far), at(len, far), g.to, g.to, g.to, g.to);
+        rlEnd();
+    } else {
+        // the end colour everywhere, then rings of the ramp around the centre
+        DrawRectangle(0, 0, g_CanvasWidth, g_CanvasHeight, g.to);
+        const int rings = 48, segments = 72;
+        rlBegin(RL_TRIANGLES);
+        for (int r = 0; r < rings; ++r) {
+            float t0 = (float)r / rings, t1 = (float)(r + 1) / rings;
+            Color c0 = LerpColor(g.from, g.to, t0), c1 = LerpColor(g.from, g.to, t1);
+            for (int s = 0; s < segments; ++s) {
+                float a0 = 2 * PI * s / segments, a1 = 2 * PI * (s + 1) / segments;
+                Vector2 d0 = { cosf(a0) * len, sinf(a0) * len }, d1 = { cosf(a1) * len, sinf(a1) * len };
+                Quad({ g.start.x + d0.x * t0, g.start.y + d0.y * t0 }, { g.start.x + d0.x * t1, g.start.y + d0.y * t1 },
+                     { g.start.x + d1.x * t1, g.start.y + d1.y * t1 }, { g.start.x + d1.x * t0, g.start.y + d1.y * t0 },
+                     c0, c1, c1, c0);
+            }
+        }
+        rlEnd();
+    }
+
+    rlEnableBackfaceCulling();
+    EndScissorMode();
+
+    DrawLineV(g.start, g.end, Fade(BLACK, 0.7f));
+    DrawCircleLinesV(g.start, 4.0f / g_Camera.zoom, BLACK);
+    DrawCircleLinesV(g.end, 4.0f / g_Camera.zoom, BLACK);
+}
+
+void GradientTool::DrawUI(int x, int y) {
+    Vector2 m = GetMousePosition();
+    bool pressed = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+
+    // shape, switched by clicking
+    Rectangle shapeBtn = { (float)x, (float)y, 100, 18 };
+    DrawRectangleRec(shapeBtn, CheckCollisionPointRec(m, shapeBtn) ? GRAY : LIGHTGRAY);
+    DrawText(shape == GRADIENT_LINEAR ? "Linear" : "Radial", x + 6, y + 1, 16, BLACK);
+    if (pressed && CheckCollisionPointRec(m, shapeBtn))
+        shape = (shape == GRADIENT_LINEAR) ? GRADIENT_RADIAL : GRADIENT_LINEAR;
+
+    // end colour: click the swatch to take the current colour
+    Rectangle swatch = { (float)x, (float)(y + 24), 14, 14 };
+    DrawRectangleRec(swatch, endColor);
+    DrawRectangleLinesEx(swatch, 1, BLACK);
+    DrawText("End colour", x + 20, y + 23, 16, BLACK);
+    if (pressed && CheckCollisionPointRec(m, swatch)) endColor = color;
+
+    // dither toggle
+    Rectangle box = { (float)x, (float)(y + 44), 14, 14 };
+    DrawRectangleLinesEx(box, 1, BLACK);
+    if (dither) DrawRectangle(x + 3, y + 47, 8, 8, BLACK);
+    DrawText("Dither", x + 20, y + 43, 16, BLACK);
+    if (pressed && CheckCollisionPointRec(m, box)) dither = !dither;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Tool.hpp"
+#include "../Gradient.hpp"
+
+class GradientTool : public Tool {
+public:
+    Color color = BLACK;                      // start colour, from the colour wheel
+    Color endColor = WHITE;
+    GradientShape shape = GRADIENT_LINEAR;
+    bool dither = true;
+
+    bool dragging = false;
+    Vector2 start{};
+    Vector2 end{};
+
+    void OnMouseDown(Vector2 pos) override;
+    void OnMouseHold(Vector2 pos) override;
+    void OnMouseUp(Vector2 pos) override;
+
+    void Draw() override {}
+    void DrawUI(int x, int y) override;
+    void DrawPreview(Vector2 mouse) override;
+
+    void SetColor(const Color& c) override { color = c; }
+
+private:
+    GradientParams Params() const;
+};
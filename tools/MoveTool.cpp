@@ -0,0 +1,215 @@
+#include "MoveTool.hpp"
+#include "../Document.hpp"
+#include "../StrokeIndex.hpp"
+#include "raymath.h"
+#include <algorithm>
+#include <cmath>
+
+extern void TransformActiveStrokes(const std::vector<size_t> &indices, const Matrix &m, float sizeScale);
+extern void QueryActiveStrokes(Rectangle r, std::vector<size_t> &out);
+extern std::vector<Layer> g_Layers;
+extern int g_ActiveLayer;
+extern Camera2D g_Camera;
+
+static bool IsShiftDown() {
+    return IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+}
+
+// Drops the picked strokes once anything else changed them (erasing,
+// undo, another layer).
+void MoveTool::Sync() {
+    const Layer &layer = g_Layers[g_ActiveLayer];
+    if (layer.id != layerId) {
+        ClearPicked();
+        layerId = layer.id;
+        return;
+    }
+    for (size_t k = 0; k < pickedIndices.size(); ++k) {
+        size_t i = pickedIndices[k];
+        if (i >= layer.strokes.size() || layer.strokes[i].id != pickedIds[k]) {
+            ClearPicked();
+            return;
+        }
+    }
+
+    box = {};
+    for (size_t k = 0; k < pickedIndices.size(); ++k) {
+        const Rectangle &b = layer.strokes[pickedIndices[k]].bounds;
+        if (k == 0) {
+            box = b;
+            continue;
+        }
+        float x0 = std::min(box.x, b.x), y0 = std::min(box.y, b.y);
+        float x1 = std::max(box.x + box.width, b.x + b.width), y1 = std::max(box.y + box.height, b.y + b.height);
+        box = { x0, y0, x1 - x0, y1 - y0 };
+    }
+}
+
+void MoveTool::ClearPicked() {
+    pickedIndices.clear();
+    pickedIds.clear();
+    box = {};
+}
+
+// Adds `hits` to the picked strokes, or replaces them with `hits`.
+void MoveTool::Pick(const std::vector<size_t> &hits, bool add) {
+    if (!add) ClearPicked();
+    const auto &strokes = g_Layers[g_ActiveLayer].strokes;
+    for (size_t i : hits) {
+        if (std::find(pickedIndices.begin(), pickedIndices.end(), i) != pickedIndices.end()) continue;
+        pickedIndices.push_back(i);
+        pickedIds.push_back(strokes[i].id);
+    }
+    Sync();
+}
+
+void MoveTool::UpdateMatrix() {
+    Vector2 offset = { 0, 0 };
+    float angle = 0.0f;
+    scale = 1.0f;
+    if (drag == MOVE_DRAG_MOVE) {
+        offset = Vector2Subtract(end, start);
+    } else if (drag == MOVE_DRAG_SCALE) {
+        // uniform, along the diagonal through the grabbed corner
+        Vector2 d = Vector2Subtract(start, pivot);
+        float len2 = Vector2DotProduct(d, d);
+        if (len2 > 0.0f) scale = std::max(0.01f, Vector2DotProduct(Vector2Subtract(end, pivot), d) / len2);
+    } else if (drag == MOVE_DRAG_ROTATE) {
+        angle = atan2f(end.y - pivot.y, end.x - pivot.x) - atan2f(start.y - pivot.y, start.x - pivot.x);
+        if (IsShiftDown()) angle = roundf(angle / (PI / 12)) * (PI / 12);
+    }
+    matrix = MatrixMultiply(MatrixMultiply(MatrixMultiply(MatrixTranslate(-pivot.x, -pivot.y, 0.0f),
+                                                          MatrixScale(scale, scale, 1.0f)),
+                                           MatrixRotateZ(angle)),
+                            MatrixTranslate(pivot.x + offset.x, pivot.y + offset.y, 0.0f));
+}
+
+// Corner `k` of the box, clockwise from the top-left, as currently drawn.
+Vector2 MoveTool::Handle(int k) const {
+    Vector2 c = { (k == 1 || k == 2) ? box.x + box.width : box.x, (k >= 2) ? box.y + box.height : box.y };
+    return Transforming() ? Vector2Transform(c, matrix) : c;
+}
+
+Vector2 MoveTool::RotateHandle() const {
+    Vector2 c = { box.x + box.width * 0.5f, box.y - 24.0f / (g_Camera.zoom * scale) };
+    return Transforming() ? Vector2Transform(c, matrix) : c;
+}
+
+void MoveTool::OnMouseDown(Vector2 pos) {
+    Sync();
+    additive = IsShiftDown();
+    start = end = pivot = pos;
+    matrix = MatrixIdentity();
+    scale = 1.0f;
+    drag = MOVE_DRAG_NONE;
+
+    const float grab = 6.0f / g_Camera.zoom;
+    if (!pickedIndices.empty()) {
+        if (Vector2Distance(pos, RotateHandle()) <= grab) {
+            drag = MOVE_DRAG_ROTATE;
+            pivot = { box.x + box.width * 0.5f, box.y + box.height * 0.5f };
+        }
+        for (int k = 0; k < 4 && drag == MOVE_DRAG_NONE; ++k) {
+            if (Vector2Distance(pos, Handle(k)) <= grab) {
+                drag = MOVE_DRAG_SCALE;
+                pivot = Handle((k + 2) % 4);
+            }
+        }
+        if (drag == MOVE_DRAG_NONE && !additive && CheckCollisionPointRec(pos, box)) drag = MOVE_DRAG_MOVE;
+    }
+
+    if (drag == MOVE_DRAG_NONE) {
+        // the topmost stroke under the cursor; shift toggles it
+        std::vector<size_t> hits;
+        QueryActiveStrokes({ pos.x - grab, pos.y - grab, 2 * grab, 2 * grab }, hits);
+        const Layer &layer = g_Layers[g_ActiveLayer];
+        auto hit = std::find_if(hits.rbegin(), hits.rend(), [&](size_t i) {
+            const CanvasStroke &s = layer.strokes[i];
+            return !s.erased && StrokeContainsPoint(s, pos, grab * 0.5f);
+        });
+        if (hit == hits.rend()) {
+            drag = MOVE_DRAG_MARQUEE;
+            return;
+        }
+        auto at = std::find(pickedIndices.begin(), pickedIndices.end(), *hit);
+        if (additive && at != pickedIndices.end()) {
+            pickedIds.erase(pickedIds.begin() + (at - pickedIndices.begin()));
+            pickedIndices.erase(at);
+            Sync();
+            return;
+        }
+        Pick({ *hit }, additive);
+        if (additive) return;
+        drag = MOVE_DRAG_MOVE;
+    }
+
+    picked.assign(g_Layers[g_ActiveLayer].strokes.size(), 0);
+    for (size_t i : pickedIndices) picked[i] = 1;
+    UpdateMatrix();
+}
+
+void MoveTool::OnMouseHold(Vector2 pos) {
+    end = pos;
+    if (Transforming()) UpdateMatrix();
+}
+
+void MoveTool::OnMouseUp(Vector2 pos) {
+    end = pos;
+    if (drag == MOVE_DRAG_MARQUEE) {
+        Rectangle r = { std::min(start.x, end.x), std::min(start.y, end.y), fabsf(end.x - start.x), fabsf(end.y - start.y) };
+        if (std::max(r.width, r.height) * g_Camera.zoom < 2.0f) {
+            if (!additive) ClearPicked();
+        } else {
+            const Layer &layer = g_Layers[g_ActiveLayer];
+            std::vector<size_t> hits;
+            QueryActiveStrokes(r, hits);
+            hits.erase(std::remove_if(hits.begin(), hits.end(), [&](size_t i) {
+                return layer.strokes[i].erased || !StrokeTouchesRect(layer.strokes[i], r);
+            }), hits.end());
+            Pick(hits, additive);
+        }
+    } else if (Transforming()) {
+        UpdateMatrix();
+        if (end.x != start.x || end.y != start.y) {
+            TransformActiveStrokes(pickedIndices, matrix, scale);
+            // the baked strokes are new ones
+            const auto &strokes = g_Layers[g_ActiveLayer].strokes;
+            for (size_t k = 0; k < pickedIndices.size(); ++k) pickedIds[k] = strokes[pickedIndices[k]].id;
+        }
+    }
+
+    drag = MOVE_DRAG_NONE;
+    picked.clear();
+    matrix = MatrixIdentity();
+    scale = 1.0f;
+    Sync();
+}
+
+void MoveTool::DrawPreview(Vector2 /*mouse*/) {
+    if (!Transforming()) Sync();
+    const float px = 1.0f / g_Camera.zoom;
+
+    if (drag == MOVE_DRAG_MARQUEE) {
+        Rectangle r = { std::min(start.x, end.x), std::min(start.y, end.y), fabsf(end.x - start.x), fabsf(end.y - start.y) };
+        DrawRectangleRec(r, Fade(SKYBLUE, 0.2f));
+        DrawRectangleLinesEx(r, px, BLUE);
+    }
+    if (pickedIndices.empty()) return;
+
+    for (int k = 0; k < 4; ++k) DrawLineV(Handle(k), Handle((k + 1) % 4), BLUE);
+    Vector2 top = Vector2Lerp(Handle(0), Handle(1), 0.5f);
+    DrawLineV(top, RotateHandle(), BLUE);
+    DrawCircleV(RotateHandle(), 4 * px, WHITE);
+    DrawCircleLinesV(RotateHandle(), 4 * px, BLUE);
+    for (int k = 0; k < 4; ++k) {
+        Vector2 h = Handle(k);
+        Rectangle r = { h.x - 3 * px, h.y - 3 * px, 6 * px, 6 * px };
+        DrawRectangleRec(r, WHITE);
+        DrawRectangleLinesEx(r, px, BLUE);
+    }
+}
+
+void MoveTool::DrawUI(int x, int y) {
+    DrawText(TextFormat("Picked: %d", (int)pickedIndices.size()), x, y, 16, BLACK);
+    DrawText("Shift: add", x, y + 20, 16, BLACK);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include "Tool.hpp"
+
+enum MoveDrag {
+    MOVE_DRAG_NONE = 0,
+    MOVE_DRAG_MARQUEE,
+    MOVE_DRAG_MOVE,
+    MOVE_DRAG_SCALE,
+    MOVE_DRAG_ROTATE
+};
+
+// Picks strokes of the active layer by click or marquee (Shift adds) and
+// moves them, scales them from a corner handle or rotates them with the
+// handle above the box. While dragging, the picked strokes are drawn
+// through one matrix; their points are rewritten once, on release.
+class MoveTool : public Tool {
+public:
+    void OnMouseDown(Vector2 pos) override;
+    void OnMouseHold(Vector2 pos) override;
+    void OnMouseUp(Vector2 pos) override;
+
+    void Draw() override {}
+    void DrawUI(int x, int y) override;
+    void DrawPreview(Vector2 mouse) override;
+
+    // While a move, scale or rotate drag is under way: whether stroke `i` of
+    // the active layer is being transformed, and the matrix and size scale
+    // to draw it with.
+    bool Transforming() const { return drag >= MOVE_DRAG_MOVE; }
+    bool IsPicked(size_t i) const { return i < picked.size() && picked[i]; }
+    const std::vector<size_t> &PickedIndices() const { return pickedIndices; }
+    const Matrix &DragMatrix() const { return matrix; }
+    float DragScale() const { return scale; }
+
+private:
+    uint64_t layerId = 0;
+    std::vector<size_t> pickedIndices;    // into the active layer's strokes
+    std::vector<uint64_t> pickedIds;      // their ids, to notice other edits
+    std::vector<uint8_t> picked;          // per stroke, while transforming
+    Rectangle box{};                      // around the picked strokes
+
+    MoveDrag drag = MOVE_DRAG_NONE;
+    bool additive = false;
+    Vector2 start{};
+    Vector2 end{};
+    Vector2 pivot{};
+    float scale = 1.0f;
+    Matrix matrix = {};
+
+    void Sync();
+    void Pick(const std::vector<size_t> &hits, bool add);
+    void ClearPicked();
+    void UpdateMatrix();
+    Vector2 Handle(int k) const;
+    Vector2 RotateHandle() const;
+};
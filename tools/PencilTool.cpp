@@ -1,40 +1,71 @@
 // PencilTool.cpp
 #include "PencilTool.hpp"
+#include "CanvasStroke.hpp"
 
-extern std::vector<struct CanvasStroke> g_CanvasStrokes;
-extern struct CanvasStroke* g_CurrentStroke;
-
-struct CanvasStroke {
-    std::vector<Vector2> points;
-    float size;
-    Color color;
-    bool erased = false;
-};
+extern std::vector<CanvasStroke> &ActiveStrokes();
+extern CanvasStroke* g_CurrentStroke;
+extern void MarkDocumentChanged();
+extern std::shared_ptr<const StrokeSymmetry> CurrentSymmetry();
+extern bool PaintBackgroundSegment(Vector2 from, Vector2 to, float size, Color color);
+extern int g_ActiveLayer;
 
 void PencilTool::OnMouseDown(Vector2 pos) {
-    g_CanvasStrokes.push_back(CanvasStroke());
-    g_CurrentStroke = &g_CanvasStrokes.back();
+    painting = raster && PaintBackgroundSegment(pos, pos, size, color);
+    last = pos;
+    if (painting) return;
+
+    ActiveStrokes().push_back(CanvasStroke());
+    g_CurrentStroke = &ActiveStrokes().back();
     g_CurrentStroke->color = color;
     g_CurrentStroke->size = size;
+    g_CurrentStroke->symmetry = CurrentSymmetry();
     g_CurrentStroke->points.push_back(pos);
+    MarkDocumentChanged();
 }
 
 void PencilTool::OnMouseHold(Vector2 pos) {
-    if (g_CurrentStroke)
+    if (painting) {
+        // only the new segment; a mouse at rest paints nothing
+        if (pos.x != last.x || pos.y != last.y) PaintBackgroundSegment(last, pos, size, color);
+        last = pos;
+        return;
+    }
+    if (g_CurrentStroke) {
         g_CurrentStroke->points.push_back(pos);
+        MarkDocumentChanged();
+    }
 }
 
 void PencilTool::OnMouseUp(Vector2 /*pos*/) {
+    painting = false;
     g_CurrentStroke = nullptr;
 }
 
 void PencilTool::Draw() {}
 
 void PencilTool::DrawPreview(Vector2 mouse) {
-    DrawCircleLines(mouse.x, mouse.y, size / 2.0f, GRAY);
+    DrawCircleLinesV(mouse, size / 2.0f, GRAY);
 }
 
 void PencilTool::DrawUI(int x, int y) {
+    // vector strokes or raster painting, switched by clicking; only the
+    // bottom layer has pixels to paint into, so elsewhere it is greyed out
+    Vector2 mouse = GetMousePosition();
+    Rectangle modeBtn = { (float)x, (float)y, 100, 18 };
+    const bool canRaster = g_ActiveLayer == 0;
+    if (canRaster) {
+        DrawRectangleRec(modeBtn, CheckCollisionPointRec(mouse, modeBtn) ? GRAY : LIGHTGRAY);
+        DrawText(raster ? "Raster" : "Vector", x + 6, y + 1, 16, BLACK);
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mouse, modeBtn) && !painting)
+            raster = !raster;
+    } else {
+        DrawRectangleRec(modeBtn, Color{235, 235, 235, 255});
+        DrawText("Vector", x + 6, y + 1, 16, GRAY);
+        DrawText("raster: bottom layer only", x, y + 20, 10, GRAY);
+        y += 12;
+    }
+    y += 24;
+
     DrawText(TextFormat("Size: %dpx", (int)size), x, y, 16, BLACK);
     int sliderW = 100;
     int sliderH = 15;
@@ -13,6 +13,10 @@ class PencilTool : public Tool {
 public:
     Color color = BLACK;
     float size = 5.0f;
+    // paint into the background pixels instead of recording a stroke; on
+    // layers other than the bottom one the pencil still draws strokes and
+    // the toggle is greyed out
+    bool raster = false;
 
     std::vector<Stroke> strokes;
     Stroke* currentStroke = nullptr;
@@ -26,4 +30,8 @@ public:
     void DrawPreview(Vector2 mouse) override;
 
     void SetColor(const Color& c) override { color = c; }
+
+private:
+    bool painting = false;  // a raster stroke is under way
+    Vector2 last{};         // where it was painted to
 };
@@ -0,0 +1,101 @@
+#include "SelectTool.hpp"
+#include <cmath>
+
+extern void CombineSelection(const SelectionMask &shape, SelectionOp op);
+extern void ClearSelection();
+extern Camera2D g_Camera;
+extern int g_CanvasWidth;
+extern int g_CanvasHeight;
+
+static SelectionOp OpFromModifiers() {
+    bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    bool alt = IsKeyDown(KEY_LEFT_ALT) || IsKeyDown(KEY_RIGHT_ALT);
+    if (shift && alt) return SELECTION_INTERSECT;
+    if (shift) return SELECTION_ADD;
+    if (alt) return SELECTION_SUBTRACT;
+    return SELECTION_REPLACE;
+}
+
+// The dragged box, corners on pixel edges.
+Rectangle SelectTool::Box() const {
+    float x0 = roundf(fminf(start.x, end.x)), x1 = roundf(fmaxf(start.x, end.x));
+    float y0 = roundf(fminf(start.y, end.y)), y1 = roundf(fmaxf(start.y, end.y));
+    return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+void SelectTool::OnMouseDown(Vector2 pos) {
+    dragging = true;
+    op = OpFromModifiers();
+    start = end = pos;
+    lasso.assign(1, pos);
+}
+
+void SelectTool::OnMouseHold(Vector2 pos) {
+    if (!dragging) return;
+    end = pos;
+    // lasso points about two screen pixels apart
+    Vector2 last = lasso.back();
+    float step = 2.0f / g_Camera.zoom;
+    if ((pos.x - last.x) * (pos.x - last.x) + (pos.y - last.y) * (pos.y - last.y) >= step * step)
+        lasso.push_back(pos);
+}
+
+void SelectTool::OnMouseUp(Vector2 pos) {
+    if (!dragging) return;
+    dragging = false;
+    end = pos;
+
+    SelectionMask mask;
+    if (shape == SELECT_LASSO) {
+        if (lasso.size() >= 3) mask = PolygonSelection(g_CanvasWidth, g_CanvasHeight, lasso);
+    } else {
+        Rectangle box = Box();
+        if (box.width >= 1.0f && box.height >= 1.0f) {
+            mask = (shape == SELECT_RECTANGLE) ? RectangleSelection(g_CanvasWidth, g_CanvasHeight, box)
+                                               : EllipseSelection(g_CanvasWidth, g_CanvasHeight, box);
+        }
+    }
+    lasso.clear();
+
+    if (mask.IsNull()) {
+        if (op == SELECTION_REPLACE) ClearSelection();
+        return;
+    }
+    CombineSelection(mask, op);
+}
+
+void SelectTool::DrawPreview(Vector2 mouse) {
+    if (!dragging) {
+        DrawLineV({ mouse.x - 4 / g_Camera.zoom, mouse.y }, { mouse.x + 4 / g_Camera.zoom, mouse.y }, GRAY);
+        DrawLineV({ mouse.x, mouse.y - 4 / g_Camera.zoom }, { mouse.x, mouse.y + 4 / g_Camera.zoom }, GRAY);
+        return;
+    }
+
+    if (shape == SELECT_LASSO) {
+        DrawLineStrip(lasso.data(), (int)lasso.size(), BLACK);
+        DrawLineV(lasso.back(), lasso.front(), GRAY);
+        return;
+    }
+    Rectangle box = Box();
+    if (shape == SELECT_RECTANGLE) {
+        DrawRectangleLinesEx(box, 1.0f / g_Camera.zoom, BLACK);
+    } else {
+        float rx = box.width * 0.5f, ry = box.height * 0.5f;
+        DrawEllipseLines((int)(box.x + rx), (int)(box.y + ry), rx, ry, BLACK);
+    }
+}
+
+void SelectTool::DrawUI(int x, int y) {
+    Vector2 m = GetMousePosition();
+
+    // shape, switched by clicking
+    static const char *kNames[] = { "Rectangle", "Ellipse", "Lasso" };
+    Rectangle shapeBtn = { (float)x, (float)y, 100, 18 };
+    DrawRectangleRec(shapeBtn, CheckCollisionPointRec(m, shapeBtn) ? GRAY : LIGHTGRAY);
+    DrawText(kNames[shape], x + 6, y + 1, 16, BLACK);
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(m, shapeBtn))
+        shape = (SelectShape)((shape + 1) % 3);
+
+    DrawText("Shift: add", x, y + 24, 16, BLACK);
+    DrawText("Alt: subtract", x, y + 42, 16, BLACK);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "Tool.hpp"
+#include "../Selection.hpp"
+
+enum SelectShape {
+    SELECT_RECTANGLE = 0,
+    SELECT_ELLIPSE,
+    SELECT_LASSO
+};
+
+// Drag out a rectangle or ellipse, or draw a freehand lasso. Shift adds to
+// the selection, Alt subtracts from it, both intersect with it; a click
+// without a drag deselects. Like Select All and Deselect, it never marks
+// the document changed, so a drag is no undo step and no unsaved change.
+class SelectTool : public Tool {
+public:
+    SelectShape shape = SELECT_RECTANGLE;
+
+    bool dragging = false;
+    SelectionOp op = SELECTION_REPLACE;   // picked from the modifiers when the drag starts
+    Vector2 start{};
+    Vector2 end{};
+    std::vector<Vector2> lasso;
+
+    void OnMouseDown(Vector2 pos) override;
+    void OnMouseHold(Vector2 pos) override;
+    void OnMouseUp(Vector2 pos) override;
+
+    void Draw() override {}
+    void DrawUI(int x, int y) override;
+    void DrawPreview(Vector2 mouse) override;
+
+private:
+    Rectangle Box() const;
+};
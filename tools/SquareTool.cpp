@@ -1,16 +1,12 @@
 #include "SquareTool.hpp"
+#include "CanvasStroke.hpp"
 #include <algorithm>
 #include <cmath>
 
-extern std::vector<struct CanvasStroke> g_CanvasStrokes;
-extern struct CanvasStroke* g_CurrentStroke;
-
-struct CanvasStroke {
-    std::vector<Vector2> points;
-    float size;
-    Color color;
-    bool erased = false;
-};
+extern std::vector<CanvasStroke> &ActiveStrokes();
+extern CanvasStroke* g_CurrentStroke;
+extern void MarkDocumentChanged();
+extern std::shared_ptr<const StrokeSymmetry> CurrentSymmetry();
 
 static bool IsPerfectKeyDown() {
     return IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
@@ -65,6 +61,7 @@ void SquareTool::OnMouseUp(Vector2 pos) {
     stroke.color = color;
     stroke.size = thickness;
     stroke.erased = false;
+    stroke.symmetry = CurrentSymmetry();
 
     stroke.points = {
         {x1, y1},
@@ -74,7 +71,8 @@ void SquareTool::OnMouseUp(Vector2 pos) {
         {x1, y1}
     };
 
-    g_CanvasStrokes.push_back(stroke);
+    ActiveStrokes().push_back(stroke);
+    MarkDocumentChanged();
 }
 
 void SquareTool::DrawPreview(Vector2 /*mouse*/) {